@@ -1,6 +1,7 @@
 import QtQuick 2.15
 import QtQuick.Controls 2.15
 import QtQuick.Effects
+import QtQuick.Dialogs
 
 Rectangle {
     id: chatListPanel
@@ -137,7 +138,7 @@ Rectangle {
                                 Text {
                                     id: chatCountText
                                     anchors.centerIn: parent
-                                    text: chatManager.chatList.length + " chats"
+                                    text: chatManager.chatListModel.count + " chats"
                                     color: "#ffffff"
                                     font.pixelSize: 10
                                     font.bold: true
@@ -267,32 +268,125 @@ Rectangle {
             opacity: 0.4
         }
 
+        // Search across all chats
+        TextField {
+            id: searchField
+            width: parent.width
+            height: 34
+            placeholderText: "Search all chats"
+            color: "#ffffff"
+            placeholderTextColor: "#6c7293"
+            font.pixelSize: 13
+            leftPadding: 12
+            selectByMouse: true
+            background: Rectangle {
+                radius: 10
+                color: "#1a2332"
+                border.color: searchField.activeFocus ? "#4facfe" : "#2d3748"
+                border.width: 1
+            }
+
+            onTextChanged: searchDebounce.restart()
+            Keys.onEscapePressed: text = ""
+        }
+
         // Chat list area
         Item {
             width: parent.width
-            height: parent.height - 115 // Adjusting for the header height
+            height: parent.height - 159 // Adjusting for the header and search field
+
+            ListView {
+                id: searchResultsView
+                anchors.fill: parent
+                anchors.rightMargin: 15
+                visible: searchField.text.trim() !== ""
+                model: searchResults.hits
+                spacing: 6
+                clip: true
+
+                // Next page when scrolled to the end
+                onAtYEndChanged: {
+                    if (atYEnd && searchResults.hasMore && !searchResults.loading) {
+                        searchResults.loading = true
+                        chatManager.search(searchResults.query, searchResults.hits.length, searchResults.pageSize)
+                    }
+                }
+
+                delegate: Rectangle {
+                    width: searchResultsView.width
+                    height: hitColumn.implicitHeight + 16
+                    radius: 10
+                    color: hitMouseArea.containsMouse ? "#2d3748" : "#1a2332"
+
+                    Column {
+                        id: hitColumn
+                        anchors.left: parent.left
+                        anchors.right: parent.right
+                        anchors.top: parent.top
+                        anchors.margins: 8
+                        spacing: 3
+
+                        Text {
+                            width: parent.width
+                            text: (modelData.isUser ? "You · " : "AI · ") + (modelData.chatTitle || "Untitled")
+                                  + (modelData.archived ? " · archived" : "")
+                            color: "#4facfe"
+                            font.pixelSize: 11
+                            elide: Text.ElideRight
+                        }
+
+                        Text {
+                            width: parent.width
+                            text: modelData.snippet
+                            textFormat: Text.StyledText
+                            color: "#d0d0e0"
+                            font.pixelSize: 12
+                            wrapMode: Text.Wrap
+                            maximumLineCount: 3
+                            elide: Text.ElideRight
+                        }
+                    }
+
+                    MouseArea {
+                        id: hitMouseArea
+                        anchors.fill: parent
+                        hoverEnabled: true
+                        cursorShape: Qt.PointingHandCursor
+                        onClicked: chatManager.openSearchResult(modelData.chatId, modelData.messageId)
+                    }
+                }
+
+                Text {
+                    anchors.centerIn: parent
+                    visible: searchResultsView.count === 0 && !searchResults.loading
+                    text: "No matches"
+                    color: "#6c7293"
+                    font.pixelSize: 12
+                }
+            }
 
             ListView {
                 id: chatListView
                 anchors.fill: parent
                 anchors.rightMargin: 15 // Space for the scrollbar
-                model: chatManager.chatList
+                visible: !searchResultsView.visible
+                model: chatManager.chatListModel
                 spacing: 8
                 clip: true
 
                 delegate: Rectangle {
                     width: chatListView.width
                     height: 55
-                    color: modelData.isCurrent ? "#2d3748" : "transparent"
+                    color: model.isCurrent ? "#2d3748" : "transparent"
                     radius: 10
-                    border.color: modelData.isCurrent ? "#4facfe" : "transparent"
-                    border.width: modelData.isCurrent ? 2 : 0
+                    border.color: model.isCurrent ? "#4facfe" : "transparent"
+                    border.width: model.isCurrent ? 2 : 0
 
                     // Background highlight on hover
                     Rectangle {
                         anchors.fill: parent
                         color: "#4facfe"
-                        opacity: chatMouseArea.containsMouse && !modelData.isCurrent ? 0.08 : 0.0
+                        opacity: chatMouseArea.containsMouse && !model.isCurrent ? 0.08 : 0.0
                         radius: parent.radius
 
                         Behavior on opacity {
@@ -311,8 +405,8 @@ Rectangle {
                             height: 32
                             radius: 8
                             anchors.verticalCenter: parent.verticalCenter
-                            color: modelData.isCurrent ? "#4facfe" : "#1e2749"
-                            border.color: modelData.isCurrent ? "transparent" : "#4facfe"
+                            color: model.isCurrent ? "#4facfe" : "#1e2749"
+                            border.color: model.isCurrent ? "transparent" : "#4facfe"
                             border.width: 1
 
                             // Icon would be placed here (e.g., Image or Text)
@@ -325,17 +419,17 @@ Rectangle {
                             spacing: 6
 
                             Text {
-                                text: modelData.title
+                                text: model.title
                                 color: "#ffffff"
                                 font.pixelSize: 13
-                                font.weight: modelData.isCurrent ? Font.DemiBold : Font.Normal
+                                font.weight: model.isCurrent ? Font.DemiBold : Font.Normal
                                 elide: Text.ElideRight
                                 width: parent.width
                             }
 
                             Text {
-                                text: formatTime(modelData.lastTimestamp)
-                                color: modelData.isCurrent ? "#4facfe" : "#7a7a8c"
+                                text: formatTime(model.lastTimestamp)
+                                color: model.isCurrent ? "#4facfe" : "#7a7a8c"
                                 font.pixelSize: 10
                                 font.weight: Font.Medium
                             }
@@ -349,7 +443,7 @@ Rectangle {
                             radius: 8
                             color: deleteBtnMouseArea.containsMouse ? "#e74c3c" : "#2d3748"
                             opacity: (chatMouseArea.containsMouse || deleteBtnMouseArea.containsMouse) ? 1.0 : 0.0
-                            visible: !modelData.isCurrent || chatManager.chatList.length > 1 // Hide delete for the single current chat
+                            visible: !model.isCurrent || chatManager.chatListModel.count > 1 // Hide delete for the single current chat
                             anchors.verticalCenter: parent.verticalCenter
 
                             Behavior on opacity {
@@ -374,7 +468,7 @@ Rectangle {
                                 cursorShape: Qt.PointingHandCursor
 
                                 onClicked: {
-                                    chatListPanel.showDeleteDialog(modelData.id, modelData.title)
+                                    chatListPanel.showDeleteDialog(model.chatId, model.title)
                                     mouse.accepted = true // Prevent propagation to chatMouseArea
                                 }
                             }
@@ -389,8 +483,8 @@ Rectangle {
                         cursorShape: Qt.PointingHandCursor
 
                         onClicked: {
-                            if (!modelData.isCurrent) {
-                                chatManager.switchToChat(modelData.id)
+                            if (!model.isCurrent) {
+                                chatManager.switchToChat(model.chatId)
                             }
                         }
                     }
@@ -415,6 +509,112 @@ Rectangle {
         }
     }
 
+    // Search state; pages are appended as the results list scrolls
+    QtObject {
+        id: searchResults
+        property string query: ""
+        property var hits: []
+        property bool hasMore: false
+        property bool loading: false
+        readonly property int pageSize: 30
+    }
+
+    Timer {
+        id: searchDebounce
+        interval: 150
+        onTriggered: {
+            searchResults.query = searchField.text.trim()
+            searchResults.hits = []
+            searchResults.hasMore = false
+            if (searchResults.query !== "") {
+                searchResults.loading = true
+                chatManager.search(searchResults.query, 0, searchResults.pageSize)
+            }
+        }
+    }
+
+    Connections {
+        target: chatManager
+
+        function onSearchResultsReady(query, offset, hits) {
+            // Answers to an older query are dropped
+            if (query !== searchResults.query || offset !== searchResults.hits.length) return
+            searchResults.hits = searchResults.hits.concat(hits)
+            searchResults.hasMore = hits.length === searchResults.pageSize
+            searchResults.loading = false
+        }
+    }
+
+    // Background parse of old messages; only shown while it has work left
+    Text {
+        anchors.bottom: parent.bottom
+        anchors.horizontalCenter: parent.horizontalCenter
+        anchors.bottomMargin: 6
+        visible: isOpen && !chatManager.archiveActive
+                 && chatManager.migrationActive && chatManager.migrationProgress < 1.0
+        text: "Upgrading history… " + Math.round(chatManager.migrationProgress * 100) + "%"
+        color: "#a0a0b0"
+        font.pixelSize: 10
+    }
+
+    // JSONL export/import; runs in the background, click the progress to cancel
+    Row {
+        anchors.bottom: parent.bottom
+        anchors.right: parent.right
+        anchors.bottomMargin: 6
+        anchors.rightMargin: 12
+        spacing: 12
+        visible: isOpen
+
+        Text {
+            visible: chatManager.archiveActive
+            text: "Working… " + Math.round(chatManager.archiveProgress * 100) + "%  ✕"
+            color: "#a0a0b0"
+            font.pixelSize: 10
+
+            MouseArea {
+                anchors.fill: parent
+                cursorShape: Qt.PointingHandCursor
+                onClicked: chatManager.cancelArchive()
+            }
+        }
+
+        Repeater {
+            model: chatManager.archiveActive ? [] : ["Export", "Import"]
+
+            Text {
+                text: modelData
+                color: archiveButtonArea.containsMouse ? "#4facfe" : "#7a7a8c"
+                font.pixelSize: 10
+
+                MouseArea {
+                    id: archiveButtonArea
+                    anchors.fill: parent
+                    hoverEnabled: true
+                    cursorShape: Qt.PointingHandCursor
+                    onClicked: modelData === "Export" ? exportDialog.open() : importDialog.open()
+                }
+            }
+        }
+    }
+
+    FileDialog {
+        id: exportDialog
+        title: "Export all chats"
+        fileMode: FileDialog.SaveFile
+        defaultSuffix: "jsonl"
+        nameFilters: ["Chat archives (*.jsonl)", "All files (*)"]
+        onAccepted: chatManager.exportChats(selectedFile.toString())
+    }
+
+    FileDialog {
+        id: importDialog
+        title: "Import chats"
+        fileMode: FileDialog.OpenFile
+        nameFilters: ["Chat archives (*.jsonl)", "All files (*)"]
+        onAccepted: chatManager.importChats(selectedFile.toString())
+    }
+
     // Custom Scrollbar
     Item {
         id: chatListScrollBar
@@ -537,15 +537,33 @@ ApplicationWindow {
             ScrollBar.horizontal: null
 
             property bool shouldAutoScroll: true
+            // Set by a search hit; applied once the chat's messages are in
+            property int pendingJump: -1
+            property bool holdPosition: false
 
             onCountChanged: {
-                if (shouldAutoScroll && count > 0) {
+                if (pendingJump >= 0 && count > pendingJump) {
+                    var target = pendingJump
+                    pendingJump = -1
+                    shouldAutoScroll = false
+                    Qt.callLater(function() {
+                        positionViewAtIndex(target, ListView.Center)
+                    })
+                } else if (shouldAutoScroll && count > 0) {
                     Qt.callLater(function() {
                         positionViewAtEnd()
                     })
                 }
             }
 
+            // The model holds a window of pages: older ones are requested
+            // near the top, newer ones through fetchMore at the bottom
+            onContentYChanged: {
+                if (!shouldAutoScroll && model.hasMoreMessages && contentY - originY < height) {
+                    model.loadOlderMessages()
+                }
+            }
+
             delegate: SimpleMessageBubble {
                 width: messagesView.width
                 messageText: model.text || ""
@@ -615,7 +633,7 @@ ApplicationWindow {
 
                     var viewHeight = messagesView.height
                     var contentHeight = messagesView.contentHeight
-                    var contentY = messagesView.contentY
+                    var contentY = messagesView.contentY - messagesView.originY
 
                     var maxContentY = contentHeight - viewHeight
                     if (maxContentY <= 0) return 0
@@ -645,7 +663,7 @@ ApplicationWindow {
                 onPressed: function(mouse) {
                     isDragging = true
                     dragStartY = mouse.y
-                    contentYAtDragStart = messagesView.contentY
+                    contentYAtDragStart = messagesView.contentY - messagesView.originY
                     messagesView.shouldAutoScroll = false
                 }
 
@@ -665,13 +683,13 @@ ApplicationWindow {
                     var deltaRatio = deltaY / maxThumbY
                     var newContentY = contentYAtDragStart + (deltaRatio * maxContentY)
 
-                    messagesView.contentY = Math.max(0, Math.min(newContentY, maxContentY))
+                    messagesView.contentY = messagesView.originY + Math.max(0, Math.min(newContentY, maxContentY))
                 }
 
                 onReleased: {
                     isDragging = false
 
-                    var maxContentY = messagesView.contentHeight - messagesView.height
+                    var maxContentY = messagesView.originY + messagesView.contentHeight - messagesView.height
                     if (messagesView.contentY >= maxContentY - 10) {
                         messagesView.shouldAutoScroll = true
                     }
@@ -680,9 +698,9 @@ ApplicationWindow {
                 onWheel: function(wheel) {
                     var delta = wheel.angleDelta.y
                     var scrollAmount = delta > 0 ? -80 : 80
-                    var maxContentY = messagesView.contentHeight - messagesView.height
+                    var maxContentY = messagesView.originY + messagesView.contentHeight - messagesView.height
                     var newContentY = messagesView.contentY + scrollAmount
-                    messagesView.contentY = Math.max(0, Math.min(newContentY, maxContentY))
+                    messagesView.contentY = Math.max(messagesView.originY, Math.min(newContentY, maxContentY))
 
                     if (scrollAmount < 0) {
                         messagesView.shouldAutoScroll = false
@@ -726,7 +744,7 @@ ApplicationWindow {
                     autoScrollCursor.visible = false
                     scrollTimer.stop()
 
-                    var maxContentY = messagesView.contentHeight - messagesView.height
+                    var maxContentY = messagesView.originY + messagesView.contentHeight - messagesView.height
                     if (messagesView.contentY >= maxContentY - 10) {
                         messagesView.shouldAutoScroll = true
                     }
@@ -750,9 +768,9 @@ ApplicationWindow {
                     // Speed depends on distance (dead zone 10px)
                     var speed = Math.abs(deltaY) > 10 ? deltaY * 0.4 : 0
 
-                    var maxContentY = messagesView.contentHeight - messagesView.height
+                    var maxContentY = messagesView.originY + messagesView.contentHeight - messagesView.height
                     var newContentY = messagesView.contentY + speed
-                    messagesView.contentY = Math.max(0, Math.min(newContentY, maxContentY))
+                    messagesView.contentY = Math.max(messagesView.originY, Math.min(newContentY, maxContentY))
 
                     // Update cursor color and direction
                     if (Math.abs(deltaY) < 10) {
@@ -1074,7 +1092,14 @@ ApplicationWindow {
             })
         }
 
+        function onModelLoadingFinished(success) {
+            if (success) {
+                chatManager.setActiveModel(modelInfo.modelPath)
+            }
+        }
+
         function onGenerationFinished(tokens, duration) {
+            chatManager.finishStreamingMessage()
             currentResponse = ""
             currentMessageIndex = -1
             messagesView.positionViewAtEnd()
@@ -1086,19 +1111,43 @@ ApplicationWindow {
         target: chatManager
 
         function onCurrentChatChanged() {
+            // Chats reopen with the model they were last used with; instant if it is still resident
+            var chatModel = chatManager.currentChatModel
+            if (chatModel !== "" && chatModel !== modelInfo.modelPath) {
+                llamaConnector.loadModel(chatModel)
+            }
+            llamaConnector.setActiveChat(chatManager.currentChatId)
             messagesView.shouldAutoScroll = false
+            messagesView.holdPosition = false
+            messagesView.pendingJump = -1
 
             Qt.callLater(function() {
+                // A search hit opened this chat; stay on the hit
+                if (messagesView.holdPosition) return
                 messagesView.positionViewAtEnd()
                 messagesView.currentIndex = messagesView.count - 1
 
                 Qt.callLater(function() {
+                    if (messagesView.holdPosition) return
                     messagesView.positionViewAtEnd()
                     messagesView.shouldAutoScroll = true
                 })
             })
         }
 
+        function onJumpToMessage(position) {
+            messagesView.holdPosition = true
+            if (messagesView.count > position) {
+                messagesView.pendingJump = -1
+                Qt.callLater(function() {
+                    messagesView.shouldAutoScroll = false
+                    messagesView.positionViewAtIndex(position, ListView.Center)
+                })
+            } else {
+                messagesView.pendingJump = position
+            }
+        }
+
         function onMessageAdded(text, isUser) {
             Qt.callLater(function() {
                 messagesView.positionViewAtEnd()
@@ -320,7 +320,7 @@ Rectangle {
 
                                 delegate: Rectangle {
                                     width: modelsListView.width
-                                    height: 70
+                                    height: 88
                                     color: modelArea.containsMouse ? Qt.lighter(modelPanel.surfaceColor, 1.1) : "transparent"
                                     radius: 6
 
@@ -330,7 +330,12 @@ Rectangle {
                                         hoverEnabled: true
 
                                         onClicked: {
-                                            if (modelData.fullPath !== modelInfo.modelPath) {
+                                            if (modelData.isAdapter) {
+                                                // Applies on top of the loaded base model, no reload
+                                                llamaConnector.setLoraAdapter(
+                                                    modelData.fullPath === modelInfo.activeLora ? "" : modelData.fullPath,
+                                                    modelInfo.loraScale)
+                                            } else if (modelData.fullPath !== modelInfo.modelPath) {
                                                 loadingPopup.open()
                                                 llamaConnector.loadModel(modelData.fullPath)
                                             }
@@ -407,6 +412,41 @@ Rectangle {
                                                         font.bold: true
                                                     }
                                                 }
+
+                                                Rectangle {
+                                                    width: 65
+                                                    height: 20
+                                                    radius: 4
+                                                    color: modelData.fullPath === modelInfo.activeLora ? modelPanel.accentColor : modelPanel.textSecondary
+                                                    opacity: 0.3
+                                                    visible: modelData.isAdapter === true
+
+                                                    Text {
+                                                        anchors.centerIn: parent
+                                                        text: modelData.fullPath === modelInfo.activeLora ? "LORA ON" : "LORA"
+                                                        color: modelPanel.textPrimary
+                                                        font.pixelSize: 9
+                                                        font.bold: true
+                                                    }
+                                                }
+
+                                                // Still loaded from earlier; switching back is instant
+                                                Rectangle {
+                                                    width: 65
+                                                    height: 20
+                                                    radius: 4
+                                                    color: modelPanel.primaryColor
+                                                    opacity: 0.3
+                                                    visible: modelData.isResident && modelData.fullPath !== modelInfo.modelPath
+
+                                                    Text {
+                                                        anchors.centerIn: parent
+                                                        text: "RESIDENT"
+                                                        color: modelPanel.textPrimary
+                                                        font.pixelSize: 9
+                                                        font.bold: true
+                                                    }
+                                                }
                                             }
 
                                             Row {
@@ -424,6 +464,13 @@ Rectangle {
                                                     font.pixelSize: 11
                                                 }
 
+                                                Text {
+                                                    text: modelData.valid ? "⚙️ " + modelData.quantization + " • " + modelData.architecture
+                                                                          : "⚠️ Unreadable header"
+                                                    color: modelPanel.textSecondary
+                                                    font.pixelSize: 11
+                                                }
+
                                                 Text {
                                                     text: modelData.isAutoLoad ? "⚡ Auto-load" : ""
                                                     color: "#4ade80"
@@ -431,6 +478,20 @@ Rectangle {
                                                     font.bold: true
                                                 }
                                             }
+
+                                            // Pre-load estimate: resident memory at the default context, fit, decode speed
+                                            Text {
+                                                visible: modelData.valid && modelData.fit !== undefined
+                                                text: "🧮 ~" + modelData.estimatedMemory + " • "
+                                                      + (modelData.fit === "fits" ? "fits in RAM"
+                                                         : modelData.fit === "tight" ? "tight fit"
+                                                         : modelData.fit === "swap" ? "will swap" : "fit unknown")
+                                                      + (modelData.estimatedSpeed > 0 ? " • ~" + modelData.estimatedSpeed.toFixed(1) + " tok/s" : "")
+                                                color: modelData.fit === "swap" ? "#ef4444"
+                                                       : modelData.fit === "tight" ? "#fbbf24"
+                                                       : modelData.fit === "fits" ? "#4ade80" : modelPanel.textSecondary
+                                                font.pixelSize: 11
+                                            }
                                         }
                                     }
 
@@ -523,11 +584,32 @@ Rectangle {
                             metrics: [
                                 { label: "Usage", value: modelInfo.cpuUsage + "%", progress: modelInfo.cpuUsage / 100.0 },
                                 { label: "Clock", value: (modelInfo.cpuClock / 1000.0).toFixed(2) + " GHz", color: "#4ade80" },
+                                { label: "Backend", value: modelInfo.cpuBackend + " • " + modelInfo.cpuIsa },
+                                { label: "Threads", value: modelInfo.threadPinning },
+                                {
+                                    label: "Inference threads (" + modelInfo.inferenceThreadCount + ", " + modelInfo.inferencePreemptions + " preempt/s)",
+                                    value: modelInfo.decodeStarved ? modelInfo.inferenceCpuUsage + "% starved" : modelInfo.inferenceCpuUsage + "%",
+                                    progress: modelInfo.inferenceCpuUsage / 100.0,
+                                    color: modelInfo.decodeStarved ? "#ef4444" : undefined
+                                },
                                 {
                                     label: modelInfo.isLoaded ? "RAM (Model: " + modelInfo.modelMemoryUsed.toFixed(1) + " GB)" : "RAM",
                                     value: modelInfo.memoryUsed.toFixed(1) + "/" + modelInfo.memoryTotal.toFixed(1) + " GB",
                                     progress: modelInfo.memoryPercent / 100.0
-                                }
+                                },
+                                {
+                                    label: "Budget (KV cache: " + modelInfo.stateCacheMemory.toFixed(0) + " MB RAM, " + modelInfo.stateCacheDisk.toFixed(0) + " MB disk)",
+                                    value: modelInfo.processMemory.toFixed(1) + "/" + modelInfo.memoryBudget.toFixed(1) + " GB",
+                                    progress: modelInfo.processMemory / Math.max(modelInfo.memoryBudget, 0.1),
+                                    color: modelInfo.processMemory > modelInfo.memoryBudget ? "#ef4444" : undefined
+                                },
+                                {
+                                    label: "Resident models (" + modelInfo.residentModels.length + ")",
+                                    value: modelInfo.residentModels.length === 0 ? "None"
+                                           : modelInfo.residentModels.map(function(m) { return m.fileName + " " + m.footprint }).join(", ")
+                                             + " • " + modelInfo.residentMemory.toFixed(1) + " GB"
+                                },
+                                { label: "Evictions (" + modelInfo.evictionCount + ")", value: modelInfo.lastEviction }
                             ]
                         }
                     }
@@ -1296,7 +1378,7 @@ Rectangle {
         id: settingsPopup
         anchors.centerIn: Overlay.overlay
         width: 400
-        height: 450
+        height: 920
         modal: true
         focus: true
 
@@ -1334,6 +1416,142 @@ Rectangle {
                 anchors.horizontalCenter: parent.horizontalCenter
             }
 
+            Column {
+                width: parent.width
+                spacing: 8
+
+                Text {
+                    text: "NUMA strategy (applies after restart)"
+                    color: modelPanel.textPrimary
+                    font.pixelSize: 12
+                    font.bold: true
+                }
+
+                ComboBox {
+                    width: parent.width
+                    model: ["disabled", "distribute", "isolate", "numactl"]
+                    currentIndex: Math.max(0, model.indexOf(modelInfo.numaStrategy))
+                    onActivated: modelInfo.numaStrategy = currentText
+                }
+
+                Text {
+                    text: modelInfo.numaTopology
+                    color: modelPanel.textSecondary
+                    font.pixelSize: 10
+                    width: parent.width
+                    wrapMode: Text.WrapAnywhere
+                }
+            }
+
+            Column {
+                width: parent.width
+                spacing: 8
+
+                Text {
+                    text: "Memory budget, MB (0 = automatic)"
+                    color: modelPanel.textPrimary
+                    font.pixelSize: 12
+                    font.bold: true
+                }
+
+                SpinBox {
+                    width: parent.width
+                    from: 0
+                    to: 1048576
+                    stepSize: 512
+                    editable: true
+                    value: modelInfo.memoryBudgetMB
+                    onValueModified: modelInfo.memoryBudgetMB = value
+                }
+            }
+
+            Column {
+                width: parent.width
+                spacing: 8
+
+                Text {
+                    text: "LoRA adapter for this chat (scale " + loraScaleSlider.value.toFixed(2) + ")"
+                    color: modelPanel.textPrimary
+                    font.pixelSize: 12
+                    font.bold: true
+                }
+
+                ComboBox {
+                    id: loraCombo
+                    width: parent.width
+                    enabled: modelInfo.isLoaded
+                    model: ["Base model"].concat(modelInfo.loraAdapters.map(function(a) { return a.name }))
+                    currentIndex: 1 + modelInfo.loraAdapters.findIndex(function(a) { return a.fullPath === modelInfo.activeLora })
+                    onActivated: function(index) {
+                        llamaConnector.setLoraAdapter(index > 0 ? modelInfo.loraAdapters[index - 1].fullPath : "",
+                                                      loraScaleSlider.value)
+                    }
+                }
+
+                Slider {
+                    id: loraScaleSlider
+                    width: parent.width
+                    from: 0.0
+                    to: 2.0
+                    stepSize: 0.05
+                    value: modelInfo.loraScale
+                    enabled: modelInfo.activeLora !== ""
+                    onMoved: llamaConnector.setLoraAdapter(modelInfo.activeLora, value)
+                }
+            }
+
+            Column {
+                width: parent.width
+                spacing: 8
+
+                Text {
+                    text: "Trace timeline (Chrome / Perfetto JSON)"
+                    color: modelPanel.textPrimary
+                    font.pixelSize: 12
+                    font.bold: true
+                }
+
+                Row {
+                    spacing: 12
+
+                    Switch {
+                        checked: tracer.enabled
+                        onToggled: tracer.enabled = checked
+                    }
+
+                    ActionButton {
+                        text: "Save trace"
+                        width: 120
+                        enabled: tracer.enabled
+                        onClicked: traceSavedText.text = tracer.saveTrace() || "Failed to write trace"
+                    }
+                }
+
+                Row {
+                    spacing: 12
+
+                    Switch {
+                        checked: modelInfo.recordRequests
+                        onToggled: modelInfo.recordRequests = checked
+                    }
+
+                    Text {
+                        text: "Record requests for replay"
+                        color: modelPanel.textSecondary
+                        font.pixelSize: 12
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+                }
+
+                Text {
+                    id: traceSavedText
+                    color: modelPanel.textSecondary
+                    font.pixelSize: 10
+                    width: parent.width
+                    wrapMode: Text.WrapAnywhere
+                }
+            }
+
             Column {
                 width: parent.width
                 spacing: 8
@@ -0,0 +1,223 @@
+#include "blockscodec.h"
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDebug>
+
+// Append-only: ids are stored, so entries must never move
+static const char *const LANGUAGES[] = {
+    "", "text", "python", "cpp", "c", "javascript", "typescript", "java", "rust", "go",
+    "bash", "sh", "shell", "json", "html", "css", "sql", "yaml", "xml", "markdown",
+    "csharp", "kotlin", "swift", "ruby", "php", "qml", "cmake", "diff", "lua", "powershell",
+};
+static const int LANGUAGE_COUNT = int(sizeof(LANGUAGES) / sizeof(LANGUAGES[0]));
+
+enum BlockFlags : quint8 {
+    TypeMask = 0x03,
+    Closed = 0x04,
+    InlineContent = 0x08,
+    InlineLanguage = 0x10,
+};
+
+static void writeVarint(QByteArray &out, quint32 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+static void writeString(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    writeVarint(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+
+namespace {
+
+struct Reader {
+    const uchar *pos;
+    const uchar *end;
+    bool ok = true;
+
+    quint8 byte()
+    {
+        if (pos >= end) {
+            ok = false;
+            return 0;
+        }
+        return *pos++;
+    }
+
+    quint32 varint()
+    {
+        quint32 value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            quint8 b = byte();
+            value |= quint32(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    QString string()
+    {
+        quint32 size = varint();
+        if (!ok || size > quint32(end - pos)) {
+            ok = false;
+            return QString();
+        }
+        QString value = QString::fromUtf8(reinterpret_cast<const char *>(pos), int(size));
+        pos += size;
+        return value;
+    }
+};
+
+}
+
+static int languageId(const QString &language)
+{
+    for (int i = 0; i < LANGUAGE_COUNT; ++i) {
+        if (language == QLatin1String(LANGUAGES[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+namespace BlocksCodec {
+
+QByteArray encode(const QString &text, const ParsedContent &parsed)
+{
+    QByteArray out;
+    out.reserve(2 + parsed.blocks.size() * 8);
+    out.append(char(VERSION));
+    writeVarint(out, quint32(parsed.blocks.size()));
+
+    // Blocks come in text order, so each search starts where the last one matched
+    int cursor = 0;
+    for (const ContentBlock &block : parsed.blocks) {
+        int offset = block.content.isEmpty() ? cursor : text.indexOf(block.content, cursor);
+        if (offset < 0) {
+            offset = text.indexOf(block.content);
+        }
+        int language = languageId(block.language);
+
+        quint8 flags = quint8(block.type) & TypeMask;
+        if (block.isClosed) flags |= Closed;
+        if (offset < 0) flags |= InlineContent;
+        if (language < 0) flags |= InlineLanguage;
+
+        out.append(char(flags));
+        out.append(char(language < 0 ? 0 : language));
+        writeVarint(out, quint32(qMax(0, block.lineCount)));
+
+        if (offset < 0) {
+            writeString(out, block.content);
+        } else {
+            writeVarint(out, quint32(offset));
+            writeVarint(out, quint32(block.content.size()));
+            cursor = offset + block.content.size();
+        }
+        if (language < 0) {
+            writeString(out, block.language);
+        }
+    }
+
+    return out;
+}
+
+bool decode(const QString &text, const QByteArray &data, ParsedContent *parsed)
+{
+    Reader in{reinterpret_cast<const uchar *>(data.constData()),
+              reinterpret_cast<const uchar *>(data.constData()) + data.size()};
+
+    if (in.byte() != VERSION) {
+        return false;
+    }
+    quint32 count = in.varint();
+    // Every block takes at least four bytes
+    if (!in.ok || count > quint32(data.size())) {
+        return false;
+    }
+
+    ParsedContent result;
+    result.blocks.reserve(int(count));
+    for (quint32 i = 0; i < count && in.ok; ++i) {
+        quint8 flags = in.byte();
+        quint8 language = in.byte();
+
+        ContentBlock block;
+        block.type = static_cast<ContentType>(flags & TypeMask);
+        block.isClosed = flags & Closed;
+        block.lineCount = int(in.varint());
+
+        if (flags & InlineContent) {
+            block.content = in.string();
+        } else {
+            quint32 offset = in.varint();
+            quint32 length = in.varint();
+            if (offset > quint32(text.size()) || length > quint32(text.size()) - offset) {
+                return false;
+            }
+            block.content = text.mid(int(offset), int(length));
+        }
+
+        if (flags & InlineLanguage) {
+            block.language = in.string();
+        } else if (language < LANGUAGE_COUNT) {
+            block.language = QString::fromLatin1(LANGUAGES[language]);
+        } else {
+            return false;
+        }
+
+        result.blocks.append(block);
+    }
+
+    if (!in.ok) {
+        return false;
+    }
+    *parsed = result;
+    return true;
+}
+
+ParsedContent decodeJson(const QString &json)
+{
+    ParsedContent result;
+
+    if (json.isEmpty()) {
+        return result;
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(json.toUtf8());
+    if (!doc.isArray()) {
+        qDebug() << "ERROR: blocks_json is not an array";
+        return result;
+    }
+
+    QJsonArray blocksArray = doc.array();
+
+    for (const QJsonValue& value : blocksArray) {
+        if (!value.isObject()) continue;
+
+        QJsonObject blockObj = value.toObject();
+
+        ContentBlock block;
+        block.type = static_cast<ContentType>(blockObj["type"].toInt());
+        block.content = blockObj["content"].toString();
+        block.language = blockObj["language"].toString();
+        block.isClosed = blockObj["isClosed"].toBool();
+        block.lineCount = blockObj["lineCount"].toInt();
+
+        result.blocks.append(block);
+    }
+
+    return result;
+}
+
+}
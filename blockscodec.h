@@ -0,0 +1,32 @@
+#ifndef BLOCKSCODEC_H
+#define BLOCKSCODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include "message.h"
+
+// Storage format for parsed message blocks (messages.blocks). Block content
+// is almost always a substring of the message text, so a block is stored as
+// an offset and length into `text` plus its type, closed flag, line count
+// and a language id from a fixed table; only content that is not found in
+// the text, or an unlisted language, is stored inline.
+//
+//   u8 version, varint count, then per block:
+//   u8 flags (type | closed | inline content | inline language)
+//   u8 language id, varint line count,
+//   varint offset + varint length, or varint size + UTF-8 bytes if inline,
+//   [varint size + UTF-8 bytes of the language if inline]
+namespace BlocksCodec {
+
+static constexpr quint8 VERSION = 1;
+
+QByteArray encode(const QString &text, const ParsedContent &parsed);
+// False on a malformed blob or an unknown version; callers fall back to parsing
+bool decode(const QString &text, const QByteArray &data, ParsedContent *parsed);
+
+// The JSON format of the old blocks_json column, read only for migration
+ParsedContent decodeJson(const QString &json);
+
+}
+
+#endif // BLOCKSCODEC_H
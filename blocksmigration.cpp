@@ -0,0 +1,135 @@
+#include "blocksmigration.h"
+#include "blockscodec.h"
+#include "chatmanager.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QtConcurrent>
+#include <QDebug>
+
+// Rows parsed and committed per transaction
+static const int BATCH_SIZE = 256;
+
+BlocksMigration::BlocksMigration(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName("blocks_migration")
+    , m_stop(0)
+{
+}
+
+BlocksMigration::~BlocksMigration()
+{
+}
+
+QString BlocksMigration::checkpointKey() const
+{
+    return QString("blocks_migration_v%1").arg(VERSION);
+}
+
+void BlocksMigration::run()
+{
+    int migrated = 0;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+        db.setDatabaseName(m_databasePath);
+        // The GUI connection writes concurrently; wait for its locks instead of failing
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!db.open()) {
+            qDebug() << "Blocks migration: failed to open database:" << db.lastError().text();
+        } else {
+            QSqlQuery query(db);
+            query.prepare("SELECT value FROM settings WHERE key = ?");
+            query.addBindValue(checkpointKey());
+            QString checkpoint = (query.exec() && query.next()) ? query.value(0).toString() : QString();
+
+            if (checkpoint != "done") {
+                qint64 lastId = checkpoint.toLongLong();
+
+                query.prepare("SELECT COUNT(*) FROM messages WHERE id > ? AND isUser = 0 AND blocks IS NULL");
+                query.addBindValue(lastId);
+                int total = (query.exec() && query.next()) ? query.value(0).toInt() : 0;
+                if (total > 0) {
+                    qDebug() << "Blocks migration:" << total << "messages to encode, resuming after id" << lastId;
+                }
+
+                QSqlQuery select(db);
+                select.prepare("SELECT id, text, blocks_json FROM messages WHERE id > ? AND isUser = 0 "
+                               "AND blocks IS NULL ORDER BY id LIMIT ?");
+                // The JSON copy is dropped once the binary form exists. Only if
+                // the text is still what was parsed: a reply may be streaming
+                QSqlQuery update(db);
+                update.prepare("UPDATE messages SET blocks = ?, blocks_json = NULL "
+                               "WHERE id = ? AND blocks IS NULL AND text = ?");
+                QSqlQuery saveCheckpoint(db);
+                saveCheckpoint.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?)");
+
+                while (m_stop.loadRelaxed() == 0) {
+                    select.addBindValue(lastId);
+                    select.addBindValue(BATCH_SIZE);
+                    if (!select.exec()) {
+                        qDebug() << "Blocks migration: select failed:" << select.lastError().text();
+                        break;
+                    }
+
+                    QList<qint64> ids;
+                    QList<QPair<QString, QString>> rows;  // text, blocks_json
+                    while (select.next()) {
+                        ids.append(select.value(0).toLongLong());
+                        rows.append(qMakePair(select.value(1).toString(), select.value(2).toString()));
+                    }
+                    select.finish();
+
+                    if (ids.isEmpty()) {
+                        saveCheckpoint.addBindValue(checkpointKey());
+                        saveCheckpoint.addBindValue(QString("done"));
+                        saveCheckpoint.exec();
+                        break;
+                    }
+
+                    // Rows cached as JSON convert without re-parsing the text
+                    const QList<QByteArray> blocks = QtConcurrent::blockingMapped(
+                        rows, [](const QPair<QString, QString> &row) {
+                            ParsedContent parsed = row.second.isEmpty() ? ChatManager::parseMarkdown(row.first)
+                                                                        : BlocksCodec::decodeJson(row.second);
+                            return BlocksCodec::encode(row.first, parsed);
+                        });
+
+                    // Rows and checkpoint commit together, so a restart never skips or redoes work
+                    db.transaction();
+                    bool ok = true;
+                    for (int i = 0; i < ids.size() && ok; ++i) {
+                        update.addBindValue(blocks[i]);
+                        update.addBindValue(ids[i]);
+                        update.addBindValue(rows[i].first);
+                        ok = update.exec();
+                    }
+                    saveCheckpoint.addBindValue(checkpointKey());
+                    saveCheckpoint.addBindValue(QString::number(ids.last()));
+                    ok = ok && saveCheckpoint.exec();
+
+                    if (!ok || !db.commit()) {
+                        qDebug() << "Blocks migration: batch failed:" << db.lastError().text();
+                        db.rollback();
+                        break;
+                    }
+
+                    lastId = ids.last();
+                    migrated += ids.size();
+                    emit progress(migrated, total);
+                }
+
+                if (migrated > 0) {
+                    qDebug() << "Blocks migration: encoded blocks for" << migrated << "messages";
+                }
+            }
+        }
+        db.close();
+    }
+
+    // The connection belongs to this thread
+    QSqlDatabase::removeDatabase(m_connectionName);
+    emit finished(migrated);
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCKSMIGRATION_H
+#define BLOCKSMIGRATION_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+
+// Fills the binary blocks column for AI messages stored before it existed,
+// converting the old blocks_json where present and parsing the text where
+// not. Walks rowid ranges in batches, encodes each batch across all cores and
+// commits it together with a checkpoint in the settings table, so a run
+// that is interrupted resumes where it stopped. Lives on its own thread
+// with its own connection
+class BlocksMigration : public QObject
+{
+    Q_OBJECT
+public:
+    // Bump to re-run the migration after a parser or format change
+    static constexpr int VERSION = 2;
+
+    explicit BlocksMigration(const QString &databasePath, QObject *parent = nullptr);
+    ~BlocksMigration();
+
+    // Thread-safe; the current batch finishes first
+    void requestStop() { m_stop.storeRelaxed(1); }
+
+public slots:
+    void run();
+
+signals:
+    void progress(int migrated, int total);
+    void finished(int migrated);
+
+private:
+    QString checkpointKey() const;
+
+    QString m_databasePath;
+    QString m_connectionName;
+    QAtomicInt m_stop;
+};
+
+#endif // BLOCKSMIGRATION_H
@@ -0,0 +1,444 @@
+#include "chatarchive.h"
+#include "blockscodec.h"
+#include "chatmanager.h"
+#include "chatstorage.h"
+#include "textcodec.h"
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QUuid>
+#include <QtConcurrent>
+#include <QDebug>
+
+static const char *const FORMAT = "aichat-jsonl";
+static const int FORMAT_VERSION = 1;
+// Rows read per page on export and committed per transaction on import
+static const int BATCH_SIZE = 512;
+// Chats read per page on export
+static const int CHAT_BATCH_SIZE = 64;
+
+namespace {
+
+struct ImportedMessage {
+    QString chatId;
+    QString text;
+    bool isUser = false;
+    QString timestamp;
+    qint64 timestampMs = 0;
+    QByteArray blocks;
+    QByteArray compressed;
+};
+
+}
+
+// The epoch-ms field next to a display timestamp; derived from the string
+// (local time) when the archive predates it
+static qint64 toMs(const QJsonObject &object, const QString &key)
+{
+    const QJsonValue ms = object[key + "Ms"];
+    if (ms.isDouble()) {
+        return qint64(ms.toDouble());
+    }
+    QDateTime time = QDateTime::fromString(object[key].toString(), "yyyy-MM-dd hh:mm:ss");
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+static bool writeLine(QSaveFile &file, const QJsonObject &object)
+{
+    QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    return file.write(line) == line.size();
+}
+
+ChatArchive::ChatArchive(Mode mode, const QString &databasePath, const QString &filePath,
+                         const QString &chatId, QObject *parent)
+    : QObject(parent)
+    , m_mode(mode)
+    , m_databasePath(databasePath)
+    , m_filePath(filePath)
+    , m_chatId(chatId)
+    , m_connectionName("chat_archive")
+    , m_stop(0)
+{
+}
+
+void ChatArchive::run()
+{
+    bool ok = false;
+    qint64 count = 0;
+    QString error;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+        db.setDatabaseName(m_databasePath);
+        // The storage writer runs concurrently; wait for its locks instead of failing
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!db.open()) {
+            error = "Failed to open database: " + db.lastError().text();
+        } else {
+            attachArchive(db);
+            ok = m_mode == Export ? exportChats(&count, &error) : importChats(&count, &error);
+        }
+        db.close();
+    }
+
+    // The connection belongs to this thread
+    QSqlDatabase::removeDatabase(m_connectionName);
+    emit finished(ok, count, error);
+}
+
+// ChatStorage's archive.db, if there is one yet
+void ChatArchive::attachArchive(QSqlDatabase &db)
+{
+    const QString path = ChatStorage::archivePath(m_databasePath);
+    if (!QFile::exists(path)) {
+        return;
+    }
+    QSqlQuery query(db);
+    query.prepare("ATTACH DATABASE ? AS archive");
+    query.addBindValue(path);
+    if (query.exec()) {
+        query.exec("SELECT 1 FROM archive.sqlite_master WHERE name = 'chats'");
+        m_hasArchive = query.next();
+    }
+}
+
+bool ChatArchive::exportChats(qint64 *count, QString *error)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+
+    // Written next to the target and renamed over it at the end, so a
+    // cancelled or failed export leaves no partial file behind
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = "Cannot write " + m_filePath + ": " + file.errorString();
+        return false;
+    }
+
+    QStringList schemas = {"main"};
+    if (m_hasArchive) {
+        schemas.append("archive");
+    }
+
+    // A chat left in both databases by an interrupted move is the main copy
+    auto notInMain = [](const QString &schema, const QString &idColumn) {
+        return schema == "main" ? QString()
+                                : " AND NOT EXISTS (SELECT 1 FROM main.chats h WHERE h.id = " + idColumn + ")";
+    };
+
+    qint64 total = 0;
+    QSqlQuery query(db);
+    for (const QString &schema : std::as_const(schemas)) {
+        query.prepare("SELECT COUNT(*) FROM " + schema + ".messages m WHERE "
+                      + (m_chatId.isEmpty() ? "1" : "m.chat_id = ?") + notInMain(schema, "m.chat_id"));
+        if (!m_chatId.isEmpty()) {
+            query.addBindValue(m_chatId);
+        }
+        total += (query.exec() && query.next()) ? query.value(0).toLongLong() : 0;
+        query.finish();
+    }
+
+    QJsonObject header;
+    header["type"] = "header";
+    header["format"] = FORMAT;
+    header["version"] = FORMAT_VERSION;
+    bool ok = writeLine(file, header);
+
+    // Keyset pages throughout: no statement stays open across a page, so
+    // the export never pins a read transaction for its whole run
+    QSqlQuery chats(db);
+    chats.setForwardOnly(true);
+    QSqlQuery messages(db);
+    messages.setForwardOnly(true);
+
+    for (const QString &schema : std::as_const(schemas)) {
+        chats.prepare("SELECT c.rowid, c.id, c.title, c.lastMessage, c.lastTimestamp, c.model_path, c.last_ms FROM "
+                      + schema + ".chats c WHERE c.rowid > ?" + (m_chatId.isEmpty() ? "" : " AND c.id = ?")
+                      + notInMain(schema, "c.id") + " ORDER BY c.rowid LIMIT ?");
+        messages.prepare("SELECT id, text, text_z, isUser, timestamp, ts_ms FROM " + schema + ".messages "
+                         "WHERE chat_id = ? AND id > ? ORDER BY id LIMIT ?");
+
+        qint64 lastChatRow = 0;
+        while (ok && m_stop.loadRelaxed() == 0) {
+            chats.addBindValue(lastChatRow);
+            if (!m_chatId.isEmpty()) {
+                chats.addBindValue(m_chatId);
+            }
+            chats.addBindValue(CHAT_BATCH_SIZE);
+            if (!chats.exec()) {
+                *error = "Failed to read chats: " + chats.lastError().text();
+                ok = false;
+                break;
+            }
+
+            QList<QJsonObject> page;
+            while (chats.next()) {
+                lastChatRow = chats.value(0).toLongLong();
+                QJsonObject chat;
+                chat["type"] = "chat";
+                chat["id"] = chats.value(1).toString();
+                chat["title"] = chats.value(2).toString();
+                chat["lastMessage"] = chats.value(3).toString();
+                chat["lastTimestamp"] = chats.value(4).toString();
+                chat["modelPath"] = chats.value(5).toString();
+                chat["lastTimestampMs"] = chats.value(6).toLongLong();
+                page.append(chat);
+            }
+            chats.finish();
+            if (page.isEmpty()) {
+                break;
+            }
+
+            for (const QJsonObject &chat : std::as_const(page)) {
+                if (!ok || m_stop.loadRelaxed() != 0) {
+                    break;
+                }
+                ok = writeLine(file, chat);
+
+                const QString chatId = chat["id"].toString();
+                qint64 lastId = 0;
+                while (ok && m_stop.loadRelaxed() == 0) {
+                    messages.addBindValue(chatId);
+                    messages.addBindValue(lastId);
+                    messages.addBindValue(BATCH_SIZE);
+                    if (!messages.exec()) {
+                        *error = "Failed to read messages: " + messages.lastError().text();
+                        ok = false;
+                        break;
+                    }
+
+                    int rows = 0;
+                    while (ok && messages.next()) {
+                        lastId = messages.value(0).toLongLong();
+                        QString text;
+                        if (messages.value(2).isNull()) {
+                            text = messages.value(1).toString();
+                        } else if (!TextCodec::decompress(messages.value(2).toByteArray(), &text)) {
+                            qDebug() << "Export: failed to decompress message" << lastId;
+                        }
+
+                        QJsonObject message;
+                        message["type"] = "message";
+                        message["chatId"] = chatId;
+                        message["text"] = text;
+                        message["isUser"] = messages.value(3).toBool();
+                        message["timestamp"] = messages.value(4).toString();
+                        message["timestampMs"] = messages.value(5).toLongLong();
+                        ok = writeLine(file, message);
+                        ++rows;
+                    }
+                    messages.finish();
+
+                    *count += rows;
+                    emit progress(total > 0 ? float(*count) / total : 1.0f);
+                    if (rows < BATCH_SIZE) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (ok && m_stop.loadRelaxed() != 0) {
+        *error = "Export cancelled";
+        ok = false;
+    }
+    if (!ok) {
+        if (error->isEmpty()) {
+            *error = "Cannot write " + m_filePath + ": " + file.errorString();
+        }
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        *error = "Cannot write " + m_filePath + ": " + file.errorString();
+        return false;
+    }
+
+    qDebug() << "Exported" << *count << "messages to" << m_filePath;
+    return true;
+}
+
+bool ChatArchive::importChats(qint64 *count, QString *error)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = "Cannot read " + m_filePath + ": " + file.errorString();
+        return false;
+    }
+    const qint64 size = qMax<qint64>(1, file.size());
+
+    QSettings settings("YourCompany", "AIChatGUI");
+    const bool compress = settings.value("compressMessages", true).toBool();
+
+    QSqlQuery chatExists(db);
+    chatExists.prepare(m_hasArchive ? "SELECT 1 FROM chats WHERE id = ? UNION ALL SELECT 1 FROM archive.chats WHERE id = ?"
+                                    : "SELECT 1 FROM chats WHERE id = ?");
+    QSqlQuery insertChat(db);
+    insertChat.prepare("INSERT INTO chats (id, title, lastMessage, lastTimestamp, created_at, model_path, "
+                       "last_ms, created_ms) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    // Inserted plain so the full-text trigger indexes the text, then compressed
+    QSqlQuery insertMessage(db);
+    insertMessage.prepare("INSERT INTO messages (chat_id, text, isUser, timestamp, ts_ms, blocks) "
+                          "VALUES (?, ?, ?, ?, ?, ?)");
+    QSqlQuery compressMessage(db);
+    compressMessage.prepare("UPDATE messages SET text = NULL, text_z = ? WHERE id = ?");
+
+    // Archive chat id -> id in this database; one entry per chat, not per message
+    QHash<QString, QString> chatIds;
+    QList<ImportedMessage> batch;
+    batch.reserve(BATCH_SIZE);
+    qint64 skipped = 0;
+
+    auto flush = [&]() -> bool {
+        if (batch.isEmpty()) {
+            return true;
+        }
+
+        // Blocks and compressed bodies are built across all cores, as the
+        // blocks migration does, then the batch commits as one transaction
+        QtConcurrent::blockingMap(batch, [compress](ImportedMessage &message) {
+            if (!message.isUser) {
+                message.blocks = BlocksCodec::encode(message.text, ChatManager::parseMarkdown(message.text));
+            }
+            if (compress) {
+                message.compressed = TextCodec::compress(message.text);
+            }
+        });
+
+        db.transaction();
+        bool ok = true;
+        for (const ImportedMessage &message : std::as_const(batch)) {
+            insertMessage.addBindValue(message.chatId);
+            insertMessage.addBindValue(message.text);
+            insertMessage.addBindValue(message.isUser);
+            insertMessage.addBindValue(message.timestamp);
+            insertMessage.addBindValue(message.timestampMs);
+            insertMessage.addBindValue(message.blocks.isEmpty() ? QVariant() : QVariant(message.blocks));
+            if (!(ok = insertMessage.exec())) {
+                break;
+            }
+            if (!message.compressed.isEmpty()) {
+                compressMessage.addBindValue(message.compressed);
+                compressMessage.addBindValue(insertMessage.lastInsertId());
+                if (!(ok = compressMessage.exec())) {
+                    break;
+                }
+            }
+        }
+        if (!ok || !db.commit()) {
+            *error = "Failed to import messages: " + db.lastError().text();
+            db.rollback();
+            return false;
+        }
+
+        *count += batch.size();
+        batch.clear();
+        emit progress(float(file.pos()) / size);
+        return true;
+    };
+
+    bool sawHeader = false;
+    qint64 lineNumber = 0;
+    while (!file.atEnd() && m_stop.loadRelaxed() == 0) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError parseError;
+        const QJsonObject object = QJsonDocument::fromJson(line, &parseError).object();
+        if (parseError.error != QJsonParseError::NoError) {
+            *error = QString("Line %1: %2").arg(lineNumber).arg(parseError.errorString());
+            flush();
+            return false;
+        }
+
+        const QString type = object["type"].toString();
+        if (!sawHeader) {
+            if (type != "header" || object["format"].toString() != FORMAT
+                || object["version"].toInt() > FORMAT_VERSION) {
+                *error = m_filePath + " is not a chat archive this version can read";
+                return false;
+            }
+            sawHeader = true;
+        } else if (type == "chat") {
+            // Chats are rare next to messages; insert them as they come
+            if (!flush()) {
+                return false;
+            }
+
+            const QString archiveId = object["id"].toString();
+            QString id = archiveId;
+            chatExists.addBindValue(id);
+            if (m_hasArchive) {
+                chatExists.addBindValue(id);
+            }
+            if (id.isEmpty() || (chatExists.exec() && chatExists.next())) {
+                id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            }
+            chatExists.finish();
+
+            insertChat.addBindValue(id);
+            insertChat.addBindValue(object["title"].toString());
+            insertChat.addBindValue(object["lastMessage"].toString());
+            insertChat.addBindValue(object["lastTimestamp"].toString());
+            insertChat.addBindValue(object["lastTimestamp"].toString());
+            insertChat.addBindValue(object["modelPath"].toString());
+            qint64 lastMs = toMs(object, "lastTimestamp");
+            insertChat.addBindValue(lastMs);
+            insertChat.addBindValue(lastMs);
+            if (!insertChat.exec()) {
+                *error = "Failed to import chat: " + insertChat.lastError().text();
+                return false;
+            }
+            chatIds.insert(archiveId, id);
+        } else if (type == "message") {
+            auto chat = chatIds.constFind(object["chatId"].toString());
+            if (chat == chatIds.constEnd()) {
+                ++skipped;  // its chat line was missing
+                continue;
+            }
+
+            ImportedMessage message;
+            message.chatId = *chat;
+            message.text = object["text"].toString();
+            message.isUser = object["isUser"].toBool();
+            message.timestamp = object["timestamp"].toString();
+            message.timestampMs = toMs(object, "timestamp");
+            batch.append(message);
+            if (batch.size() >= BATCH_SIZE && !flush()) {
+                return false;
+            }
+        }
+        // Unknown line types are skipped, so newer archives stay readable
+    }
+
+    if (!flush()) {
+        return false;
+    }
+    if (!sawHeader) {
+        *error = m_filePath + " is empty";
+        return false;
+    }
+    if (m_stop.loadRelaxed() != 0) {
+        *error = "Import cancelled";
+        return false;
+    }
+    if (skipped > 0) {
+        qDebug() << "Import: skipped" << skipped << "messages without a chat";
+    }
+
+    qDebug() << "Imported" << *count << "messages in" << chatIds.size() << "chats from" << m_filePath;
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef CHATARCHIVE_H
+#define CHATARCHIVE_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+
+class QSqlDatabase;
+
+// Export and import of chats as JSON Lines, one object per line:
+//
+//   {"type":"header","format":"aichat-jsonl","version":1}
+//   {"type":"chat","id":...,"title":...,"lastMessage":...,"lastTimestamp":...,
+//    "lastTimestampMs":...,"modelPath":...}
+//   {"type":"message","chatId":...,"text":...,"isUser":...,"timestamp":...,"timestampMs":...}
+//
+// Each chat line comes before its messages. Both directions stream: export
+// walks keyset pages of one chat at a time and writes them out, import reads
+// a line at a time and commits in batches, so memory stays flat however
+// large the archive. Imported chats whose id already exists get a new one.
+// Chats moved to archive.db are exported along with the others.
+// Lives on its own thread with its own connection, like BlocksMigration
+class ChatArchive : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode { Export, Import };
+
+    // chatId limits an export to one chat; empty exports them all
+    ChatArchive(Mode mode, const QString &databasePath, const QString &filePath,
+                const QString &chatId = QString(), QObject *parent = nullptr);
+
+    Mode mode() const { return m_mode; }
+
+    // Thread-safe; the current batch finishes first
+    void requestStop() { m_stop.storeRelaxed(1); }
+
+public slots:
+    void run();
+
+signals:
+    void progress(float fraction);
+    // count is the number of messages written or imported
+    void finished(bool ok, qint64 count, const QString &error);
+
+private:
+    void attachArchive(QSqlDatabase &db);
+    bool exportChats(qint64 *count, QString *error);
+    bool importChats(qint64 *count, QString *error);
+
+    Mode m_mode;
+    QString m_databasePath;
+    QString m_filePath;
+    QString m_chatId;
+    QString m_connectionName;
+    bool m_hasArchive = false;
+    QAtomicInt m_stop;
+};
+
+#endif // CHATARCHIVE_H
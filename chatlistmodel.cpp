@@ -0,0 +1,134 @@
+#include "chatlistmodel.h"
+
+ChatListModel::ChatListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int ChatListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_chats.size();
+}
+
+QVariant ChatListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_chats.size())
+        return QVariant();
+
+    const Chat &chat = m_chats.at(index.row());
+
+    switch (role) {
+    case IdRole:
+        return chat.id;
+    case TitleRole:
+        return chat.title;
+    case LastMessageRole:
+        return chat.lastMessage;
+    case LastTimestampRole:
+        return chat.lastTimestamp;
+    case IsCurrentRole:
+        return chat.id == m_currentChatId;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ChatListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[IdRole] = "chatId";
+    roles[TitleRole] = "title";
+    roles[LastMessageRole] = "lastMessage";
+    roles[LastTimestampRole] = "lastTimestamp";
+    roles[IsCurrentRole] = "isCurrent";
+    return roles;
+}
+
+const Chat *ChatListModel::find(const QString &chatId) const
+{
+    auto it = m_rows.constFind(chatId);
+    return it == m_rows.constEnd() ? nullptr : &m_chats.at(*it);
+}
+
+void ChatListModel::setChats(const QList<Chat> &chats)
+{
+    beginResetModel();
+    m_chats = chats;
+    m_rows.clear();
+    reindex(0, m_chats.size() - 1);
+    endResetModel();
+    emit countChanged();
+}
+
+void ChatListModel::prepend(const Chat &chat)
+{
+    beginInsertRows(QModelIndex(), 0, 0);
+    m_chats.prepend(chat);
+    reindex(0, m_chats.size() - 1);
+    endInsertRows();
+    emit countChanged();
+}
+
+void ChatListModel::remove(const QString &chatId)
+{
+    auto it = m_rows.constFind(chatId);
+    if (it == m_rows.constEnd()) {
+        return;
+    }
+
+    int row = *it;
+    beginRemoveRows(QModelIndex(), row, row);
+    m_chats.removeAt(row);
+    m_rows.remove(chatId);
+    reindex(row, m_chats.size() - 1);
+    endRemoveRows();
+    emit countChanged();
+}
+
+void ChatListModel::updateChat(const Chat &chat)
+{
+    auto it = m_rows.constFind(chat.id);
+    if (it == m_rows.constEnd()) {
+        return;
+    }
+
+    int row = *it;
+    bool newer = chat.lastTimestampMs > m_chats[row].lastTimestampMs;
+    m_chats[row] = chat;
+    QModelIndex index = createIndex(row, 0);
+    emit dataChanged(index, index, {TitleRole, LastMessageRole, LastTimestampRole});
+
+    if (newer && row > 0) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), 0);
+        m_chats.move(row, 0);
+        reindex(0, row);
+        endMoveRows();
+    }
+}
+
+void ChatListModel::setCurrentChatId(const QString &chatId)
+{
+    if (chatId == m_currentChatId) {
+        return;
+    }
+
+    int previous = m_rows.value(m_currentChatId, -1);
+    m_currentChatId = chatId;
+    int current = m_rows.value(m_currentChatId, -1);
+
+    for (int row : {previous, current}) {
+        if (row >= 0) {
+            QModelIndex index = createIndex(row, 0);
+            emit dataChanged(index, index, {IsCurrentRole});
+        }
+    }
+}
+
+void ChatListModel::reindex(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        m_rows.insert(m_chats.at(row).id, row);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CHATLISTMODEL_H
+#define CHATLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include "message.h"
+
+// The chat list, most recently active first. Changes to one chat are
+// reported as dataChanged on its row (or a move to the top), so the view
+// never rebinds as a whole while a reply streams in.
+class ChatListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum ChatRoles {
+        IdRole = Qt::UserRole + 1,
+        TitleRole,
+        LastMessageRole,
+        LastTimestampRole,
+        IsCurrentRole
+    };
+
+    explicit ChatListModel(QObject *parent = nullptr);
+
+    // QAbstractListModel interface
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    const QList<Chat> &chats() const { return m_chats; }
+    bool isEmpty() const { return m_chats.isEmpty(); }
+    bool contains(const QString &chatId) const { return m_rows.contains(chatId); }
+    // Null if there is no such chat; valid until the model next changes
+    const Chat *find(const QString &chatId) const;
+
+    void setChats(const QList<Chat> &chats);
+    void prepend(const Chat &chat);
+    void remove(const QString &chatId);
+    // Stores the chat's new fields. A newer lastTimestamp moves it to the top
+    void updateChat(const Chat &chat);
+    void setCurrentChatId(const QString &chatId);
+
+signals:
+    void countChanged();
+
+private:
+    void reindex(int first, int last);
+
+    QList<Chat> m_chats;
+    QHash<QString, int> m_rows;  // chat id -> row
+    QString m_currentChatId;
+};
+
+#endif // CHATLISTMODEL_H
@@ -3,481 +3,617 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QUuid>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlError>
+#include <QJsonDocument>
+#include <QRegularExpression>
 #include <QStandardPaths>
+#include <QSettings>
+#include <QSet>
+#include <QUrl>
+#include "blockscodec.h"
+#include "blocksmigration.h"
+#include "chatarchive.h"
+#include "textcompaction.h"
+#include "chatstorage.h"
+#include "tracer.h"
+#include <algorithm>
+
+// Moving inactive chats to the archive database: chats per write
+// transaction, pause between batches, first pass after startup, then hourly
+static const int DEMOTE_BATCH = 20;
+static const int DEMOTE_PAUSE_MS = 100;
+static const int DEMOTE_DELAY_MS = 30 * 1000;
+static const int DEMOTE_INTERVAL_MS = 60 * 60 * 1000;
 
 ChatManager::ChatManager(QObject *parent)
     : QObject(parent)
 {
+    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir dir(dataPath);
+    if (!dir.exists()) {
+        dir.mkpath(dataPath);
+    }
+    QString dbPath = dataPath + "/chats.db";
+    qDebug() << "Database path:" << dbPath;
+
+    m_storage = new ChatStorage(dbPath, this);
+    connect(m_storage, &ChatStorage::writeFailed, this, [](const QString &error) {
+        qDebug() << error;
+    });
+
+    m_chatModel = new ChatListModel(this);
+
     m_messageModel = new MessageListModel(this);
-    initDatabase();
-    m_messageModel->setDatabase(&m_db);
+    m_messageModel->setStorage(m_storage);
+    // Pages arrive asynchronously; keep messageCount bindings current
+    connect(m_messageModel, &MessageListModel::countChanged, this, &ChatManager::messagesChanged);
+    connect(m_messageModel, &MessageListModel::messageRevealed, this, &ChatManager::jumpToMessage);
+
+    // Streaming replies: persist at most this often, re-render at most once per frame
+    QSettings settings("YourCompany", "AIChatGUI");
+    m_checkpointTimer.setSingleShot(true);
+    m_checkpointTimer.setInterval(qBound(100, settings.value("streamCheckpointMs", 1000).toInt(), 60000));
+    connect(&m_checkpointTimer, &QTimer::timeout, this, [this]() { checkpointStreamingMessage(nullptr); });
+    m_displayTimer.setSingleShot(true);
+    m_displayTimer.setInterval(33);
+    connect(&m_displayTimer, &QTimer::timeout, this, [this]() {
+        showStreamingMessage(parseMarkdown(m_streamingText));
+    });
+    m_demoteAfterDays = qMax(settings.value("archiveAfterDays", 90).toInt(), 0);
+    m_demoteTimer.setInterval(DEMOTE_INTERVAL_MS);
+    connect(&m_demoteTimer, &QTimer::timeout, this, &ChatManager::demoteInactiveChats);
+
     loadExampleQuestions();
     loadChats();
     createNewWelcomeChat();
 }
 
+ChatManager::~ChatManager()
+{
+    finishStreamingMessage();
+
+    if (m_migration) {
+        m_migration->requestStop();
+    }
+    m_migrationThread.quit();
+    m_migrationThread.wait();
+    delete m_migration;
+
+    if (m_compaction) {
+        m_compaction->requestStop();
+    }
+    m_compactionThread.quit();
+    m_compactionThread.wait();
+    delete m_compaction;
+
+    if (m_archive) {
+        m_archive->requestStop();
+    }
+    m_archiveThread.quit();
+    m_archiveThread.wait();
+    delete m_archive;
+}
+
 void ChatManager::createNewChat()
 {
     Chat newChat;
     newChat.id = generateChatId();
     newChat.title = "New Chat";
     newChat.lastMessage = "";
-    newChat.lastTimestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    QDateTime now = QDateTime::currentDateTime();
+    newChat.lastTimestamp = now.toString("yyyy-MM-dd hh:mm:ss");
+    newChat.lastTimestampMs = now.toMSecsSinceEpoch();
+    newChat.modelPath = m_activeModelPath;
 
-    saveChatToDb(newChat);
-    m_chats.prepend(newChat);
-    m_currentChatId = newChat.id;
+    m_storage->saveChat(newChat);
+    m_chatModel->prepend(newChat);
+    setCurrentChat(newChat.id);
+    m_messageModel->loadMessages(newChat.id);
 
-    emit chatListChanged();
     emit currentChatChanged();
     emit messagesChanged();
 }
 
 void ChatManager::createNewWelcomeChat()
 {
-    m_currentChatId = "welcome";
+    setCurrentChat("welcome");
     m_messageModel->clear();
 
     emit currentChatChanged();
     emit messagesChanged();
-    emit chatListChanged();
 
     qDebug() << "Welcome chat created";
 }
 
 void ChatManager::switchToChat(const QString &chatId)
 {
+    TRACE_ZONE("db", "ChatManager::switchToChat");
     if (m_currentChatId != chatId) {
-        m_currentChatId = chatId;
-        m_messageModel->loadMessages(chatId, 30);
+        // Queued ahead of the page read, so the reopened chat sees the latest text
+        checkpointStreamingMessage(nullptr);
+        setCurrentChat(chatId);
+        m_messageModel->loadMessages(chatId);
 
         emit currentChatChanged();
         emit messagesChanged();
-        emit chatListChanged();
     }
 }
 
 void ChatManager::deleteChat(const QString &chatId)
 {
-    deleteChatFromDb(chatId);
-
-    for (int i = 0; i < m_chats.size(); ++i) {
-        if (m_chats[i].id == chatId) {
-            m_chats.removeAt(i);
-            break;
-        }
+    if (m_streaming && chatId == m_streamingChatId) {
+        m_checkpointTimer.stop();
+        m_displayTimer.stop();
+        m_streaming = false;
+        m_streamingChatId.clear();
     }
 
+    m_storage->deleteChat(chatId);
+    m_messageModel->forgetChat(chatId);
+    m_chatModel->remove(chatId);
+
     if (m_currentChatId == chatId) {
-        if (!m_chats.isEmpty()) {
-            m_currentChatId = m_chats.first().id;
+        if (!m_chatModel->isEmpty()) {
+            setCurrentChat(m_chatModel->chats().first().id);
+            m_messageModel->loadMessages(m_currentChatId);
         } else {
             createNewChat();
             return;
         }
     }
 
-    emit chatListChanged();
     emit currentChatChanged();
     emit messagesChanged();
 }
 
 void ChatManager::addMessage(const QString &text, bool isUser)
 {
+    TRACE_ZONE("db", "ChatManager::addMessage");
+    if (m_streaming) {
+        finishStreamingMessage();
+    }
+
     // Create real chat on first user message from welcome screen
     if (m_currentChatId == "welcome" && isUser) {
         qDebug() << "Creating new chat from welcome screen";
         createNewChat();
     }
 
-    for (auto &chat : m_chats) {
-        if (chat.id == m_currentChatId) {
-            Message msg;
-            msg.text = text;
-            msg.isUser = isUser;
-            msg.timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-
-            // Parse all AI messages
-            if (!isUser) {
-                msg.parsed = parseMarkdown(text);
-                qDebug() << "Parsed" << msg.parsed.blocks.size() << "blocks for AI message";
-            }
+    if (const Chat *current = m_chatModel->find(m_currentChatId)) {
+        Chat chat = *current;
+        Message msg;
+        msg.text = text;
+        msg.isUser = isUser;
+        QDateTime now = QDateTime::currentDateTime();
+        msg.timestamp = now.toString("yyyy-MM-dd hh:mm:ss");
+        msg.timestampMs = now.toMSecsSinceEpoch();
 
-            chat.messages.append(msg);
-            chat.lastMessage = text.left(50) + (text.length() > 50 ? "..." : "");
-            chat.lastTimestamp = msg.timestamp;
+        // Parse all AI messages
+        if (!isUser) {
+            msg.parsed = parseMarkdown(text);
+            qDebug() << "Parsed" << msg.parsed.blocks.size() << "blocks for AI message";
+        }
 
-            // Auto-generate title from first user message
-            if (chat.title == "New Chat" && isUser && !text.isEmpty()) {
-                chat.title = generateTitle(text);
-            }
+        chat.lastMessage = text.left(50) + (text.length() > 50 ? "..." : "");
+        chat.lastTimestamp = msg.timestamp;
+        chat.lastTimestampMs = msg.timestampMs;
 
-            // Save message with blocks_json
-            QSqlQuery query;
-            query.prepare("INSERT INTO messages (chat_id, text, isUser, timestamp, blocks_json) "
-                          "VALUES (?, ?, ?, ?, ?)");
-            query.addBindValue(chat.id);
-            query.addBindValue(msg.text);
-            query.addBindValue(msg.isUser);
-            query.addBindValue(msg.timestamp);
-
-            if (!isUser && !msg.parsed.blocks.isEmpty()) {
-                query.addBindValue(serializeBlocks(msg.parsed));
-            } else {
-                query.addBindValue(QVariant());
-            }
+        // Auto-generate title from first user message
+        if (chat.title == "New Chat" && isUser && !text.isEmpty()) {
+            chat.title = generateTitle(text);
+        }
 
-            if (!query.exec()) {
-                qDebug() << "Failed to save message:" << query.lastError().text();
+        // A reply starts streaming here; its blocks are stored with the final
+        // write only, so until then it is parsed from its text when read
+        QFuture<qint64> messageId = m_storage->appendMessage(chat, msg, QByteArray());
+        // The model keys its pages on row ids; hand this one over once known
+        messageId.then(this, [this, chatId = chat.id](qint64 id) {
+            if (id >= 0) {
+                m_messageModel->setMessageId(chatId, id);
             }
-
-            updateChatInDb(chat);
-            m_messageModel->appendMessage(msg);
-            break;
+        });
+
+        if (!isUser) {
+            // Further tokens go through updateLastMessage against this row
+            m_streaming = true;
+            m_streamingMessageId = messageId;
+            m_streamingChatId = chat.id;
+            m_streamingText = text;
+            m_streamingDirty = false;
         }
+
+        m_messageModel->appendMessage(msg);
+        m_chatModel->updateChat(chat);
     }
 
     emit messageAdded(text, isUser);
-    emit chatListChanged();
     emit messagesChanged();
 }
 
-QString ChatManager::serializeBlocks(const ParsedContent& parsed)
+QVariantList ChatManager::getCurrentMessages()
 {
-    QJsonArray blocksArray;
+    QVariantList messages;
+
+    if (m_messageModel->chatId() != m_currentChatId) {
+        return messages;
+    }
+
+    for (const auto &msg : m_messageModel->messages()) {
+        QVariantMap msgMap;
+        msgMap["text"] = msg.text;
+        msgMap["isUser"] = msg.isUser;
+        msgMap["timestamp"] = msg.timestamp;
+
+        QVariantList blocks;
+        for (const auto &block : msg.parsed.blocks) {
+            QVariantMap blockMap;
+            blockMap["type"] = static_cast<int>(block.type);
+            blockMap["content"] = block.content;
+            blockMap["language"] = block.language;
+            blockMap["isClosed"] = block.isClosed;
+            blockMap["lineCount"] = block.lineCount;
+            blocks.append(blockMap);
+        }
+        msgMap["blocks"] = blocks;
 
-    for (const auto& block : parsed.blocks) {
-        QJsonObject blockObj;
-        blockObj["type"] = static_cast<int>(block.type);
-        blockObj["content"] = block.content;
-        blockObj["language"] = block.language;
-        blockObj["isClosed"] = block.isClosed;
-        blockObj["lineCount"] = block.lineCount;
-        blocksArray.append(blockObj);
+        messages.append(msgMap);
     }
 
-    QJsonDocument doc(blocksArray);
-    return doc.toJson(QJsonDocument::Compact);
+    return messages;
 }
 
-ParsedContent ChatManager::deserializeBlocks(const QString& json)
+void ChatManager::renameChatTitle(const QString &chatId, const QString &newTitle)
 {
-    ParsedContent result;
-
-    if (json.isEmpty()) {
-        return result;
+    if (const Chat *found = m_chatModel->find(chatId)) {
+        Chat chat = *found;
+        chat.title = newTitle;
+        m_storage->updateChat(chat);
+        m_chatModel->updateChat(chat);
     }
+}
 
-    QJsonDocument doc = QJsonDocument::fromJson(json.toUtf8());
-    if (!doc.isArray()) {
-        qDebug() << "ERROR: blocks_json is not an array";
-        return result;
+void ChatManager::updateLastMessage(const QString &text)
+{
+    TRACE_ZONE("db", "ChatManager::updateLastMessage");
+    if (!m_streaming) {
+        return;
     }
 
-    QJsonArray blocksArray = doc.array();
+    // Called per token with the whole reply; only remember it here. Parsing
+    // and SQL run on the timers, so a long answer is not re-processed per token
+    m_streamingText = text;
+    m_streamingDirty = true;
+    if (!m_displayTimer.isActive()) {
+        m_displayTimer.start();
+    }
+    if (!m_checkpointTimer.isActive()) {
+        m_checkpointTimer.start();
+    }
+}
 
-    for (const QJsonValue& value : blocksArray) {
-        if (!value.isObject()) continue;
+void ChatManager::finishStreamingMessage()
+{
+    TRACE_ZONE("db", "ChatManager::finishStreamingMessage");
+    if (!m_streaming) {
+        return;
+    }
 
-        QJsonObject blockObj = value.toObject();
+    m_displayTimer.stop();
+    m_checkpointTimer.stop();
 
-        ContentBlock block;
-        block.type = static_cast<ContentType>(blockObj["type"].toInt());
-        block.content = blockObj["content"].toString();
-        block.language = blockObj["language"].toString();
-        block.isClosed = blockObj["isClosed"].toBool();
-        block.lineCount = blockObj["lineCount"].toInt();
+    ParsedContent parsed = parseMarkdown(m_streamingText);
+    showStreamingMessage(parsed);
+    checkpointStreamingMessage(&parsed);
 
-        result.blocks.append(block);
+    // A chat left mid-reply was cached with a partial message
+    if (m_messageModel->chatId() != m_streamingChatId) {
+        m_messageModel->forgetChat(m_streamingChatId);
     }
 
-    return result;
+    m_streaming = false;
+    m_streamingMessageId = QFuture<qint64>();
+    m_streamingChatId.clear();
+    m_streamingText.clear();
 }
 
-QVariantList ChatManager::getCurrentMessages()
+void ChatManager::showStreamingMessage(const ParsedContent &parsed)
 {
-    QVariantList messages;
-
-    for (const auto &chat : m_chats) {
-        if (chat.id == m_currentChatId) {
-            for (const auto &msg : chat.messages) {
-                QVariantMap msgMap;
-                msgMap["text"] = msg.text;
-                msgMap["isUser"] = msg.isUser;
-                msgMap["timestamp"] = msg.timestamp;
-
-                QVariantList blocks;
-                for (const auto &block : msg.parsed.blocks) {
-                    QVariantMap blockMap;
-                    blockMap["type"] = static_cast<int>(block.type);
-                    blockMap["content"] = block.content;
-                    blockMap["language"] = block.language;
-                    blockMap["isClosed"] = block.isClosed;
-                    blockMap["lineCount"] = block.lineCount;
-                    blocks.append(blockMap);
-                    qDebug() << "Block type:" << static_cast<int>(block.type)
-                             << "content:" << block.content.left(50);
-                }
-                msgMap["blocks"] = blocks;
-
-                messages.append(msgMap);
-            }
-            break;
-        }
+    // Nothing to update while the window is scrolled away from the reply
+    if (!m_streaming || m_messageModel->chatId() != m_streamingChatId
+        || m_messageModel->rowCount() == 0 || m_messageModel->hasNewerMessages()) {
+        return;
     }
 
-    return messages;
+    Message lastMsg = m_messageModel->lastMessage();
+    if (lastMsg.isUser) {
+        return;
+    }
+    lastMsg.text = m_streamingText;
+    lastMsg.parsed = parsed;
+    m_messageModel->updateLastMessage(lastMsg);
+    emit messagesChanged();
 }
 
-void ChatManager::renameChatTitle(const QString &chatId, const QString &newTitle)
+void ChatManager::checkpointStreamingMessage(const ParsedContent *finalBlocks)
 {
-    for (auto &chat : m_chats) {
-        if (chat.id == chatId) {
-            chat.title = newTitle;
-            updateChatInDb(chat);
-            break;
-        }
+    TRACE_ZONE("db", "ChatManager::checkpointStreamingMessage");
+    if (!m_streaming || (!finalBlocks && !m_streamingDirty)) {
+        return;
     }
 
-    emit chatListChanged();
+    // Intermediate checkpoints store text only; blocks are cached with the
+    // final write, and a reply cut short by a crash is parsed when opened
+    if (const Chat *found = m_chatModel->find(m_streamingChatId)) {
+        Chat chat = *found;
+        chat.lastMessage = m_streamingText.left(50) + (m_streamingText.length() > 50 ? "..." : "");
+        m_storage->updateMessage(m_streamingMessageId, m_streamingText,
+                                 finalBlocks ? BlocksCodec::encode(m_streamingText, *finalBlocks) : QByteArray(), chat);
+        m_chatModel->updateChat(chat);
+    }
+    m_streamingDirty = false;
 }
 
-void ChatManager::updateLastMessage(const QString &text)
+void ChatManager::search(const QString &query, int offset, int limit)
 {
-    for (auto &chat : m_chats) {
-        if (chat.id == m_currentChatId && !chat.messages.isEmpty()) {
-            auto &lastMsg = chat.messages.last();
-            if (!lastMsg.isUser) {
-                lastMsg.text = text;
-                lastMsg.parsed = parseMarkdown(text);
-
-                QSqlQuery query;
-                query.prepare("UPDATE messages SET text = ?, blocks_json = ? "
-                              "WHERE chat_id = ? AND id = (SELECT MAX(id) FROM messages WHERE chat_id = ?)");
-                query.addBindValue(text);
-                query.addBindValue(serializeBlocks(lastMsg.parsed));
-                query.addBindValue(chat.id);
-                query.addBindValue(chat.id);
-
-                if (!query.exec()) {
-                    qDebug() << "Failed to update message blocks:" << query.lastError().text();
-                }
+    TRACE_ZONE("db", "ChatManager::search");
+    m_storage->search(query, offset, limit).then(this, [this, query, offset](const QList<SearchHit> &hits) {
+        QVariantList results;
+        for (const SearchHit &hit : hits) {
+            QVariantMap result;
+            result["messageId"] = hit.messageId;
+            result["chatId"] = hit.chatId;
+            result["chatTitle"] = hit.chatTitle;
+            result["snippet"] = hit.snippet;
+            result["timestamp"] = hit.timestamp;
+            result["isUser"] = hit.isUser;
+            result["position"] = hit.position;
+            result["archived"] = hit.archived;
+            results.append(result);
+        }
+        emit searchResultsReady(query, offset, results);
+    });
+}
 
-                m_messageModel->updateLastMessage(lastMsg);
-                emit messagesChanged();
+void ChatManager::openSearchResult(const QString &chatId, qint64 messageId)
+{
+    TRACE_ZONE("db", "ChatManager::openSearchResult");
+    // A hit in an archived chat: move the chat back first
+    if (!m_chatModel->find(chatId) && chatId != "welcome") {
+        m_storage->promoteChat(chatId).then(this, [this, chatId, messageId](const Chat &chat) {
+            if (chat.id.isEmpty()) {
+                qDebug() << "Chat not found:" << chatId;
                 return;
             }
-        }
+            m_chatModel->prepend(chat);
+            openSearchResult(chatId, messageId);
+        });
+        return;
     }
-}
 
-QVariantList ChatManager::getChatList() const
-{
-    QVariantList chatList;
+    // Opens the page around the hit instead of the chat's newest page;
+    // jumpToMessage follows through messageRevealed
+    if (m_currentChatId != chatId) {
+        checkpointStreamingMessage(nullptr);
+        setCurrentChat(chatId);
+        m_messageModel->loadAround(chatId, messageId);
 
-    for (const auto &chat : m_chats) {
-        QVariantMap chatMap;
-        chatMap["id"] = chat.id;
-        chatMap["title"] = chat.title;
-        chatMap["lastMessage"] = chat.lastMessage;
-        chatMap["lastTimestamp"] = chat.lastTimestamp;
-        chatMap["isCurrent"] = (chat.id == m_currentChatId);
-        chatList.append(chatMap);
+        emit currentChatChanged();
+        emit messagesChanged();
+    } else {
+        m_messageModel->loadAround(chatId, messageId);
     }
+}
 
-    return chatList;
+void ChatManager::setCurrentChat(const QString &chatId)
+{
+    m_currentChatId = chatId;
+    m_chatModel->setCurrentChatId(chatId);
 }
 
 QString ChatManager::getCurrentChatTitle() const
 {
-    for (const auto &chat : m_chats) {
-        if (chat.id == m_currentChatId) {
-            return chat.title;
-        }
-    }
-    return "New Chat";
+    const Chat *chat = m_chatModel->find(m_currentChatId);
+    return chat ? chat->title : QStringLiteral("New Chat");
 }
 
-void ChatManager::initDatabase()
+QString ChatManager::getCurrentChatModel() const
 {
-    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir dir(dataPath);
-    if (!dir.exists()) {
-        dir.mkpath(dataPath);
-    }
-
-    QString dbPath = dataPath + "/chats.db";
-    qDebug() << "Database path:" << dbPath;
+    const Chat *chat = m_chatModel->find(m_currentChatId);
+    return chat ? chat->modelPath : QString();
+}
 
-    m_db = QSqlDatabase::addDatabase("QSQLITE");
-    m_db.setDatabaseName(dbPath);
+void ChatManager::setActiveModel(const QString &modelPath)
+{
+    m_activeModelPath = modelPath;
 
-    if (!m_db.open()) {
-        qDebug() << "Failed to open database:" << m_db.lastError().text();
-        return;
+    const Chat *current = m_chatModel->find(m_currentChatId);
+    if (current && current->modelPath != modelPath) {
+        Chat chat = *current;
+        chat.modelPath = modelPath;
+        m_storage->updateChat(chat);
+        m_chatModel->updateChat(chat);
     }
+}
 
-    // SQLite optimizations
-    QSqlQuery pragmaQuery;
-    pragmaQuery.exec("PRAGMA journal_mode=WAL");
-    pragmaQuery.exec("PRAGMA synchronous=NORMAL");
-    pragmaQuery.exec("PRAGMA cache_size=-32000");
-    pragmaQuery.exec("PRAGMA temp_store=MEMORY");
-
-    qDebug() << "SQLite optimizations applied";
-
-    QSqlQuery query;
-
-    query.exec("CREATE TABLE IF NOT EXISTS chats ("
-               "id TEXT PRIMARY KEY, "
-               "title TEXT, "
-               "lastMessage TEXT, "
-               "lastTimestamp TEXT, "
-               "created_at TEXT)");
-
-    query.exec("CREATE TABLE IF NOT EXISTS messages ("
-               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "chat_id TEXT, "
-               "text TEXT, "
-               "isUser INTEGER, "
-               "timestamp TEXT, "
-               "blocks_json TEXT, "
-               "FOREIGN KEY(chat_id) REFERENCES chats(id) ON DELETE CASCADE)");
-
-    query.exec("CREATE TABLE IF NOT EXISTS settings ("
-               "key TEXT PRIMARY KEY, "
-               "value TEXT)");
-
-    qDebug() << "Settings table created";
-
-    // Add blocks_json column if it doesn't exist
-    QSqlQuery checkColumn;
-    checkColumn.exec("PRAGMA table_info(messages)");
-    bool hasBlocksJson = false;
-    while (checkColumn.next()) {
-        if (checkColumn.value(1).toString() == "blocks_json") {
-            hasBlocksJson = true;
-            break;
+void ChatManager::loadChats()
+{
+    TRACE_ZONE("db", "ChatManager::loadChats");
+
+    // Metadata only; messages are loaded by the message model when a chat is opened
+    m_storage->loadChats().then(this, [this](const QList<Chat> &chats) {
+        // Chats created while the list was loading are not in it yet
+        QSet<QString> loaded;
+        for (const Chat &chat : chats) {
+            loaded.insert(chat.id);
         }
-    }
-
-    if (!hasBlocksJson) {
-        qDebug() << "Adding blocks_json column to existing messages table";
-        query.exec("ALTER TABLE messages ADD COLUMN blocks_json TEXT");
-    }
+        QList<Chat> merged;
+        for (const Chat &chat : m_chatModel->chats()) {
+            if (!loaded.contains(chat.id)) {
+                merged.append(chat);
+            }
+        }
+        merged += chats;
+        m_chatModel->setChats(merged);
 
-    // Create index for fast sorting
-    query.exec("CREATE INDEX IF NOT EXISTS idx_chat_messages_desc "
-               "ON messages(chat_id, id DESC)");
+        qDebug() << "Loaded" << merged.size() << "chats from database";
 
-    qDebug() << "Database initialized with blocks_json support";
+        // Runs on its own connection; start it once the schema is in place
+        if (!m_migration) {
+            startBlocksMigration();
+        }
+        if (m_demoteAfterDays > 0 && !m_demoteTimer.isActive()) {
+            m_demoteTimer.start();
+            QTimer::singleShot(DEMOTE_DELAY_MS, this, &ChatManager::demoteInactiveChats);
+        }
+    });
 }
 
-void ChatManager::loadChats()
+void ChatManager::demoteInactiveChats()
 {
-    m_chats.clear();
-
-    QSqlQuery query("SELECT id, title, lastMessage, lastTimestamp FROM chats ORDER BY lastTimestamp DESC");
-
-    while (query.next()) {
-        Chat chat;
-        chat.id = query.value(0).toString();
-        chat.title = query.value(1).toString();
-        chat.lastMessage = query.value(2).toString();
-        chat.lastTimestamp = query.value(3).toString();
-
-        // Load messages with blocks_json
-        QSqlQuery msgQuery;
-        msgQuery.prepare("SELECT text, isUser, timestamp, blocks_json FROM messages WHERE chat_id = ? ORDER BY id ASC");
-        msgQuery.addBindValue(chat.id);
-        msgQuery.exec();
-
-        while (msgQuery.next()) {
-            Message msg;
-            msg.text = msgQuery.value(0).toString();
-            msg.isUser = msgQuery.value(1).toBool();
-            msg.timestamp = msgQuery.value(2).toString();
-            QString blocksJson = msgQuery.value(3).toString();
-
-            if (!msg.isUser) {
-                if (!blocksJson.isEmpty()) {
-                    // Load from cache
-                    msg.parsed = deserializeBlocks(blocksJson);
-                    qDebug() << "Loaded cached blocks:" << msg.parsed.blocks.size();
-                } else {
-                    // Parse and cache (migration for old messages)
-                    msg.parsed = parseMarkdown(msg.text);
-                    qDebug() << "Parsed and caching blocks:" << msg.parsed.blocks.size();
-
-                    QSqlQuery updateQuery;
-                    updateQuery.prepare("UPDATE messages SET blocks_json = ? WHERE chat_id = ? AND text = ?");
-                    updateQuery.addBindValue(serializeBlocks(msg.parsed));
-                    updateQuery.addBindValue(chat.id);
-                    updateQuery.addBindValue(msg.text);
-                    updateQuery.exec();
-                }
+    if (m_demoting) {
+        return;
+    }
+    m_demoting = true;
+
+    const qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - qint64(m_demoteAfterDays) * 24 * 3600 * 1000;
+    m_storage->demoteChats(cutoff, DEMOTE_BATCH, m_currentChatId).then(this, [this](const QStringList &ids) {
+        m_demoting = false;
+        for (const QString &id : ids) {
+            if (id == m_currentChatId) {
+                // Opened while the batch was queued; bring it straight back
+                m_storage->promoteChat(id);
+                m_messageModel->forgetChat(id);
+                m_messageModel->loadMessages(id);
+                continue;
             }
-
-            chat.messages.append(msg);
+            m_messageModel->forgetChat(id);
+            m_chatModel->remove(id);
         }
+        if (!ids.isEmpty()) {
+            qDebug() << "Moved" << ids.size() << "inactive chats to the archive database";
+        }
+        // Small batches keep the writer free for the chat in use
+        if (ids.size() == DEMOTE_BATCH) {
+            QTimer::singleShot(DEMOTE_PAUSE_MS, this, &ChatManager::demoteInactiveChats);
+        }
+    });
+}
 
-        m_chats.append(chat);
-    }
+void ChatManager::startBlocksMigration()
+{
+    // AI messages saved before blocks were cached are parsed on demand when
+    // opened; this fills the column in the background so that stops happening
+    m_migration = new BlocksMigration(m_storage->databasePath());
+    m_migration->moveToThread(&m_migrationThread);
+    m_migrationThread.setObjectName("BlocksMigration");
+
+    connect(&m_migrationThread, &QThread::started, m_migration, &BlocksMigration::run);
+    connect(m_migration, &BlocksMigration::progress, this, [this](int migrated, int total) {
+        m_migrationProgress = total > 0 ? float(migrated) / total : 1.0f;
+        emit migrationProgressChanged();
+    });
+    connect(m_migration, &BlocksMigration::finished, &m_migrationThread, &QThread::quit);
+    connect(&m_migrationThread, &QThread::finished, this, [this]() {
+        m_migrationProgress = 1.0f;
+        emit migrationProgressChanged();
+        startTextCompaction();
+    });
+
+    m_migrationProgress = 0.0f;
+    m_migrationThread.start(QThread::LowPriority);
+}
 
-    if (!m_chats.isEmpty()) {
-        m_currentChatId = m_chats.first().id;
+void ChatManager::startTextCompaction()
+{
+    QSettings settings("YourCompany", "AIChatGUI");
+    if (m_compaction || !settings.value("compressMessages", true).toBool()) {
+        return;
     }
 
-    qDebug() << "Loaded" << m_chats.size() << "chats from database";
+    // One pass over the whole table at low priority; later bodies are
+    // compressed as they are written
+    m_compaction = new TextCompaction(m_storage->databasePath());
+    m_compaction->moveToThread(&m_compactionThread);
+    m_compactionThread.setObjectName("TextCompaction");
+
+    connect(&m_compactionThread, &QThread::started, m_compaction, &TextCompaction::run);
+    connect(m_compaction, &TextCompaction::finished, this,
+            [](int compressed, qint64 bytesBefore, qint64 bytesAfter) {
+                if (compressed > 0) {
+                    qDebug() << "Text compaction: compressed" << compressed << "messages,"
+                             << (bytesBefore - bytesAfter) / (1024 * 1024) << "MB saved ("
+                             << bytesBefore / 1024 << "KB ->" << bytesAfter / 1024 << "KB)";
+                }
+            });
+    connect(m_compaction, &TextCompaction::finished, &m_compactionThread, &QThread::quit);
+
+    m_compactionThread.start(QThread::LowestPriority);
 }
 
-void ChatManager::saveChatToDb(const Chat &chat)
+static QString localPath(const QString &path)
 {
-    QSqlQuery query;
-    query.prepare("INSERT INTO chats (id, title, lastMessage, lastTimestamp, created_at) "
-                  "VALUES (?, ?, ?, ?, ?)");
-    query.addBindValue(chat.id);
-    query.addBindValue(chat.title);
-    query.addBindValue(chat.lastMessage);
-    query.addBindValue(chat.lastTimestamp);
-    query.addBindValue(chat.lastTimestamp);
+    return path.startsWith("file:") ? QUrl(path).toLocalFile() : path;
+}
 
-    if (!query.exec()) {
-        qDebug() << "Failed to save chat:" << query.lastError().text();
+void ChatManager::exportChats(const QString &path, const QString &chatId)
+{
+    if (m_archive) {
+        return;
     }
+    // The reply being streamed is exported as far as it has come
+    checkpointStreamingMessage(nullptr);
+    startArchive(new ChatArchive(ChatArchive::Export, m_storage->databasePath(), localPath(path), chatId));
 }
 
-void ChatManager::updateChatInDb(const Chat &chat)
+void ChatManager::importChats(const QString &path)
 {
-    QSqlQuery query;
-    query.prepare("UPDATE chats SET title = ?, lastMessage = ?, lastTimestamp = ? WHERE id = ?");
-    query.addBindValue(chat.title);
-    query.addBindValue(chat.lastMessage);
-    query.addBindValue(chat.lastTimestamp);
-    query.addBindValue(chat.id);
+    if (m_archive) {
+        return;
+    }
+    startArchive(new ChatArchive(ChatArchive::Import, m_storage->databasePath(), localPath(path)));
+}
 
-    if (!query.exec()) {
-        qDebug() << "Failed to update chat:" << query.lastError().text();
+void ChatManager::cancelArchive()
+{
+    if (m_archive) {
+        m_archive->requestStop();
     }
 }
 
-void ChatManager::deleteChatFromDb(const QString &chatId)
+void ChatManager::startArchive(ChatArchive *archive)
 {
-    QSqlQuery query;
-    query.prepare("DELETE FROM chats WHERE id = ?");
-    query.addBindValue(chatId);
+    m_archive = archive;
+    m_archive->moveToThread(&m_archiveThread);
+    m_archiveThread.setObjectName("ChatArchive");
+    m_archiveProgress = 0.0f;
+    emit archiveProgressChanged();
+
+    connect(&m_archiveThread, &QThread::started, m_archive, &ChatArchive::run);
+    connect(m_archive, &ChatArchive::progress, this, [this](float fraction) {
+        m_archiveProgress = fraction;
+        emit archiveProgressChanged();
+    });
+    connect(m_archive, &ChatArchive::finished, this, [this](bool ok, qint64 count, const QString &error) {
+        m_archiveThread.quit();
+        m_archiveThread.wait();
+        const bool imported = m_archive->mode() == ChatArchive::Import;
+        delete m_archive;
+        m_archive = nullptr;
+        emit archiveProgressChanged();
+        if (!ok) {
+            qDebug() << "Chat archive:" << error;
+        }
 
-    if (!query.exec()) {
-        qDebug() << "Failed to delete chat:" << query.lastError().text();
-    }
+        // Committed batches stay even if the import stopped early
+        if (imported && count > 0) {
+            loadChats();
+        }
+        emit archiveFinished(ok, ok ? QString("%1 messages").arg(count) : error);
+    });
 
-    // Delete messages (if CASCADE is not configured)
-    query.prepare("DELETE FROM messages WHERE chat_id = ?");
-    query.addBindValue(chatId);
-    query.exec();
+    // Its own connection: wait until it can see everything written so far
+    m_storage->pendingWrites().then(this, [this]() {
+        m_archiveThread.start(QThread::LowPriority);
+    });
 }
 
 QString ChatManager::generateChatId()
@@ -496,22 +632,14 @@ QString ChatManager::generateTitle(const QString &firstMessage)
 
 int ChatManager::getMessageCount() const
 {
-    for (const auto& chat : m_chats) {
-        if (chat.id == m_currentChatId) {
-            return chat.messages.size();
-        }
-    }
-    return 0;
+    return m_messageModel->chatId() == m_currentChatId ? m_messageModel->rowCount() : 0;
 }
 
 ParsedContent ChatManager::parseMarkdown(const QString &text)
 {
+    TRACE_ZONE("parser", "parseMarkdown");
     ParsedContent result;
 
-    qDebug() << "=== parseMarkdown called ===";
-    qDebug() << "Text length:" << text.length();
-    qDebug() << "Text preview:" << text.left(100);
-
     QRegularExpression thinkRegex("<think>([\\s\\S]*?)(?:</think>|$)");
     QRegularExpression codeRegex("```(\\w*)\\n?([\\s\\S]*?)(?:```|$)");
 
@@ -600,45 +728,37 @@ ParsedContent ChatManager::parseMarkdown(const QString &text)
         }
     }
 
-    qDebug() << "=== parseMarkdown finished ===";
-    qDebug() << "Total blocks parsed:" << result.blocks.size();
-    for (int i = 0; i < result.blocks.size(); i++) {
-        qDebug() << "Block" << i << "- Type:" << static_cast<int>(result.blocks[i].type)
-        << "Content length:" << result.blocks[i].content.length();
-    }
-
     return result;
 }
 
 void ChatManager::loadExampleQuestions()
 {
+    // Defaults show until the stored list arrives
     m_exampleQuestions.clear();
+    m_exampleQuestions << "💡 Explain quantum physics in simple terms"
+                       << "📝 Help me write Python code"
+                       << "🎨 Give me interface design tips";
 
-    QSqlQuery query;
-    query.prepare("SELECT value FROM settings WHERE key = ?");
-    query.addBindValue("example_questions");
-
-    if (query.exec() && query.next()) {
-        QString json = query.value(0).toString();
+    m_storage->loadSetting("example_questions").then(this, [this](const QString &json) {
         QJsonDocument doc = QJsonDocument::fromJson(json.toUtf8());
 
+        QStringList questions;
         if (doc.isArray()) {
             QJsonArray arr = doc.array();
             for (const QJsonValue &val : arr) {
-                m_exampleQuestions.append(val.toString());
+                questions.append(val.toString());
             }
         }
-    }
-
 
-    if (m_exampleQuestions.isEmpty()) {
-        m_exampleQuestions << "💡 Explain quantum physics in simple terms"
-                           << "📝 Help me write Python code"
-                           << "🎨 Give me interface design tips";
-        saveExampleQuestions();
-    }
+        if (questions.isEmpty()) {
+            saveExampleQuestions();
+        } else {
+            m_exampleQuestions = questions;
+            emit exampleQuestionsChanged();
+        }
 
-    qDebug() << "Loaded example questions:" << m_exampleQuestions.size();
+        qDebug() << "Loaded example questions:" << m_exampleQuestions.size();
+    });
 }
 
 void ChatManager::saveExampleQuestions()
@@ -651,16 +771,7 @@ void ChatManager::saveExampleQuestions()
     QJsonDocument doc(arr);
     QString json = doc.toJson(QJsonDocument::Compact);
 
-    QSqlQuery query;
-    query.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?)");
-    query.addBindValue("example_questions");
-    query.addBindValue(json);
-
-    if (!query.exec()) {
-        qDebug() << "Failed to save example questions:" << query.lastError().text();
-    } else {
-        qDebug() << "Example questions saved";
-    }
+    m_storage->saveSetting("example_questions", json);
 }
 
 void ChatManager::updateExampleQuestion(int index, const QString &text)
@@ -7,25 +7,42 @@
 #include <QString>
 #include <QVariantList>
 #include <QStandardPaths>
-#include <QSqlDatabase>
+#include <QFuture>
+#include <QThread>
+#include <QTimer>
 #include "message.h"
+#include "chatlistmodel.h"
 #include "messagelistmodel.h"
 
+class ChatListModel;
 class MessageListModel;
+class BlocksMigration;
+class TextCompaction;
+class ChatArchive;
+class ChatStorage;
 
 class ChatManager : public QObject
 {
     Q_OBJECT
-    Q_PROPERTY(QVariantList chatList READ getChatList NOTIFY chatListChanged)
+    Q_PROPERTY(ChatListModel* chatListModel READ chatListModel CONSTANT)
     Q_PROPERTY(QString currentChatId READ getCurrentChatId NOTIFY currentChatChanged)
     Q_PROPERTY(QString currentChatTitle READ getCurrentChatTitle NOTIFY currentChatChanged)
+    Q_PROPERTY(QString currentChatModel READ getCurrentChatModel NOTIFY currentChatChanged)
     Q_PROPERTY(int messageCount READ getMessageCount NOTIFY messagesChanged)
     Q_PROPERTY(MessageListModel* messageModel READ messageModel CONSTANT)
     Q_PROPERTY(bool isWelcomeChat READ isWelcomeChat NOTIFY currentChatChanged)
     Q_PROPERTY(QVariantList exampleQuestions READ getExampleQuestions NOTIFY exampleQuestionsChanged)
+    Q_PROPERTY(bool migrationActive READ migrationActive NOTIFY migrationProgressChanged)
+    Q_PROPERTY(float migrationProgress READ migrationProgress NOTIFY migrationProgressChanged)
+    Q_PROPERTY(bool archiveActive READ archiveActive NOTIFY archiveProgressChanged)
+    Q_PROPERTY(float archiveProgress READ archiveProgress NOTIFY archiveProgressChanged)
 
 public:
     explicit ChatManager(QObject *parent = nullptr);
+    ~ChatManager();
+
+    // Pure, also used off the GUI thread by storage and the blocks migration
+    static ParsedContent parseMarkdown(const QString &text);
 
     Q_INVOKABLE void createNewChat();
     Q_INVOKABLE void switchToChat(const QString &chatId);
@@ -34,44 +51,96 @@ public:
     Q_INVOKABLE QVariantList getCurrentMessages();
     Q_INVOKABLE void renameChatTitle(const QString &chatId, const QString &newTitle);
     Q_INVOKABLE void updateLastMessage(const QString &text);
+    // Parses and persists the streamed reply once generation ends
+    Q_INVOKABLE void finishStreamingMessage();
     Q_INVOKABLE void createNewWelcomeChat();
     Q_INVOKABLE void updateExampleQuestion(int index, const QString &text);
+    // Full-text search over all chats; results arrive via searchResultsReady
+    Q_INVOKABLE void search(const QString &query, int offset = 0, int limit = 30);
+    // Opens the chat of a search hit and scrolls to the message
+    Q_INVOKABLE void openSearchResult(const QString &chatId, qint64 messageId);
+    // JSONL export of one chat (or all when chatId is empty) and import, on a
+    // background thread; paths may be file URLs. archiveFinished reports back
+    Q_INVOKABLE void exportChats(const QString &path, const QString &chatId = QString());
+    Q_INVOKABLE void importChats(const QString &path);
+    Q_INVOKABLE void cancelArchive();
+    // Remembers the loaded model for the current chat and for new chats
+    Q_INVOKABLE void setActiveModel(const QString &modelPath);
 
     bool isWelcomeChat() const { return m_currentChatId == "welcome"; }
     MessageListModel* messageModel() const { return m_messageModel; }
-    QVariantList getChatList() const;
+    ChatListModel* chatListModel() const { return m_chatModel; }
+    ChatStorage* storage() const { return m_storage; }
     QString getCurrentChatId() const { return m_currentChatId; }
     QString getCurrentChatTitle() const;
+    QString getCurrentChatModel() const;
     int getMessageCount() const;
     QVariantList getExampleQuestions() const;
+    bool migrationActive() const { return m_migrationThread.isRunning(); }
+    float migrationProgress() const { return m_migrationProgress; }
+    bool archiveActive() const { return m_archive != nullptr; }
+    float archiveProgress() const { return m_archiveProgress; }
 
 signals:
-    void chatListChanged();
     void currentChatChanged();
     void messagesChanged();
     void messageAdded(const QString& text, bool isUser);
     void exampleQuestionsChanged();
+    void migrationProgressChanged();
+    void archiveProgressChanged();
+    void archiveFinished(bool ok, const QString &message);
+    void searchResultsReady(const QString &query, int offset, const QVariantList &hits);
+    void jumpToMessage(int position);
 
 private:
-    QString serializeBlocks(const ParsedContent& parsed);
-    ParsedContent deserializeBlocks(const QString& json);
-
-    void initDatabase();
+    void startBlocksMigration();
+    void startTextCompaction();
+    void startArchive(ChatArchive *archive);
+    void demoteInactiveChats();
+    void showStreamingMessage(const ParsedContent &parsed);
+    void checkpointStreamingMessage(const ParsedContent *finalBlocks);
     void loadChats();
-    void saveChatToDb(const Chat &chat);
-    void updateChatInDb(const Chat &chat);
-    void deleteChatFromDb(const QString &chatId);
     QString generateChatId();
     QString generateTitle(const QString &firstMessage);
 
-    QList<Chat> m_chats;
-    QString m_currentChatId;
-    QSqlDatabase m_db;
+    void setCurrentChat(const QString &chatId);
 
-    ParsedContent parseMarkdown(const QString &text);
+    ChatListModel *m_chatModel;
+    QString m_currentChatId;
+    QString m_activeModelPath;
+    ChatStorage *m_storage;
 
     MessageListModel* m_messageModel;
 
+    // Fills the blocks column for legacy messages in the background
+    QThread m_migrationThread;
+    BlocksMigration *m_migration = nullptr;
+    float m_migrationProgress = 1.0f;
+    // Then compresses large bodies stored before compression existed
+    QThread m_compactionThread;
+    TextCompaction *m_compaction = nullptr;
+
+    // At most one export or import at a time
+    QThread m_archiveThread;
+    ChatArchive *m_archive = nullptr;
+    float m_archiveProgress = 0.0f;
+
+    // Moves chats inactive for m_demoteAfterDays to archive.db in batches,
+    // once after startup and then on the timer; 0 days turns it off
+    QTimer m_demoteTimer;
+    int m_demoteAfterDays = 90;
+    bool m_demoting = false;
+
+    // Write-behind state of the reply being streamed: the text lives in
+    // memory and reaches SQLite on a timer and when generation finishes
+    bool m_streaming = false;
+    QFuture<qint64> m_streamingMessageId;  // pending until the insert runs
+    QString m_streamingChatId;
+    QString m_streamingText;
+    bool m_streamingDirty = false;
+    QTimer m_checkpointTimer;
+    QTimer m_displayTimer;
+
     void loadExampleQuestions();
     void saveExampleQuestions();
     QStringList m_exampleQuestions;
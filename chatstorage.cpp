@@ -0,0 +1,1307 @@
+#include "chatstorage.h"
+#include "blockscodec.h"
+#include "textcodec.h"
+#include "chatmanager.h"
+#include <QThread>
+#include <QPromise>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSettings>
+#include <QHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QDebug>
+#include <climits>
+#include <memory>
+#include <algorithm>
+#include "metrics.h"
+#include "tracer.h"
+
+// Runs a prepared statement and records its latency in the metrics registry
+static bool execTimed(QSqlQuery &query)
+{
+    static MetricHistogram *latency = Metrics::instance().histogram(
+        "aichat_db_query_duration_seconds", "SQLite statement latency", Metrics::latencyBuckets());
+    static MetricCounter *errors = Metrics::instance().counter(
+        "aichat_db_errors_total", "SQLite statements that failed");
+
+    TRACE_ZONE("db", "exec");
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.exec();
+    latency->observe(timer.nsecsElapsed() / 1e9);
+    if (!ok) {
+        errors->add();
+    }
+    return ok;
+}
+
+// Statements prepared once and reused. Each storage thread owns exactly one
+// connection, so the cache is per thread and needs no locking
+static QHash<QString, QSqlQuery *> &statementCache()
+{
+    thread_local QHash<QString, QSqlQuery *> cache;
+    return cache;
+}
+
+// Before the thread's connection is closed
+static void clearStatementCache()
+{
+    qDeleteAll(statementCache());
+    statementCache().clear();
+}
+
+// Whether this thread's connection has archive.db attached: 0 not tried
+// yet, 1 attached, -1 failed. One connection per thread, as above
+static int &archiveState()
+{
+    thread_local int state = 0;
+    return state;
+}
+
+static bool hasArchive()
+{
+    return archiveState() == 1;
+}
+
+// The writer creates the archive schema; readers only use an archive that has it
+static void attachArchive(QSqlDatabase &db, const QString &path, bool requireSchema)
+{
+    if (archiveState() != 0) {
+        return;
+    }
+    QSqlQuery query(db);
+    query.prepare("ATTACH DATABASE ? AS archive");
+    query.addBindValue(path);
+    if (!query.exec()) {
+        qDebug() << "Archive database unavailable:" << query.lastError().text();
+        archiveState() = -1;
+        return;
+    }
+    archiveState() = 1;
+
+    if (requireSchema) {
+        query.exec("SELECT 1 FROM archive.sqlite_master WHERE name = 'messages_fts'");
+        bool ready = query.next();
+        query.finish();
+        if (!ready) {
+            query.exec("DETACH DATABASE archive");
+            archiveState() = -1;
+        }
+    }
+}
+
+// The cached statement for `sql`, prepared on first use. Reset when this goes
+// out of scope, so a SELECT never keeps its read transaction (and with it an
+// old WAL snapshot) open between calls
+class CachedQuery
+{
+public:
+    CachedQuery(QSqlDatabase &db, const QString &sql)
+    {
+        QSqlQuery *&query = statementCache()[sql];
+        if (!query) {
+            query = new QSqlQuery(db);
+            query->setForwardOnly(true);
+            if (!query->prepare(sql)) {
+                qDebug() << "Failed to prepare:" << sql.left(80) << query->lastError().text();
+            }
+        }
+        m_query = query;
+    }
+    ~CachedQuery() { m_query->finish(); }
+
+    QSqlQuery &operator*() { return *m_query; }
+
+private:
+    Q_DISABLE_COPY(CachedQuery)
+    QSqlQuery *m_query;
+};
+
+ChatStorage::ChatStorage(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_archivePath(archivePath(databasePath))
+{
+    m_writer = startConnectionThread("chat_storage_writer");
+
+    QSettings settings("YourCompany", "AIChatGUI");
+    int readers = qBound(1, settings.value("storageReaders", 2).toInt(), 4);
+    m_compressBodies = settings.value("compressMessages", true).toBool();
+    for (int i = 0; i < readers; ++i) {
+        m_readers.append(startConnectionThread(QString("chat_storage_reader_%1").arg(i)));
+    }
+
+    // First task on the writer; every read waits for it through m_lastWrite
+    const QString path = m_databasePath;
+    const QString archive = m_archivePath;
+    write<bool>([path, archive](QSqlDatabase &db) {
+        if (!db.isOpen()) {
+            qDebug() << "Failed to open database:" << path;
+            return false;
+        }
+        initSchema(db);
+        // Creates the file, so the read-only connections can attach it
+        attachArchive(db, archive, false);
+        if (hasArchive()) {
+            initArchiveSchema(db);
+        }
+        return true;
+    });
+}
+
+QString ChatStorage::archivePath(const QString &databasePath)
+{
+    return QFileInfo(databasePath).dir().filePath("archive.db");
+}
+
+ChatStorage::~ChatStorage()
+{
+    // Queued behind any pending writes, so nothing issued before shutdown is lost
+    QList<Connection> connections = m_readers;
+    connections.prepend(m_writer);
+    for (const Connection &connection : std::as_const(connections)) {
+        const QString name = connection.name;
+        QMetaObject::invokeMethod(connection.context, [name]() {
+            clearStatementCache();
+            if (QSqlDatabase::contains(name)) {
+                {
+                    QSqlDatabase db = QSqlDatabase::database(name, false);
+                    db.close();
+                }
+                QSqlDatabase::removeDatabase(name);
+            }
+            QThread::currentThread()->quit();
+        }, Qt::QueuedConnection);
+    }
+    for (const Connection &connection : std::as_const(connections)) {
+        connection.thread->wait();
+        delete connection.thread;
+    }
+}
+
+ChatStorage::Connection ChatStorage::startConnectionThread(const QString &name)
+{
+    Connection connection;
+    connection.name = name;
+    connection.thread = new QThread;
+    connection.thread->setObjectName(name);
+    connection.context = new QObject;
+    connection.context->moveToThread(connection.thread);
+    connect(connection.thread, &QThread::finished, connection.context, &QObject::deleteLater);
+    connection.thread->start();
+    return connection;
+}
+
+template <typename T, typename Task>
+QFuture<T> ChatStorage::post(const Connection &connection, Task task)
+{
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+    promise->start();
+
+    const QString name = connection.name;
+    const QString path = m_databasePath;
+    const bool readOnly = connection.name != m_writer.name;
+
+    QMetaObject::invokeMethod(connection.context, [promise, task, name, path, readOnly]() mutable {
+        // Connections open lazily, on the thread that will use them
+        QSqlDatabase db = QSqlDatabase::database(name, false);
+        if (!db.isValid()) {
+            db = QSqlDatabase::addDatabase("QSQLITE", name);
+            db.setDatabaseName(path);
+            db.setConnectOptions(readOnly ? "QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000"
+                                          : "QSQLITE_BUSY_TIMEOUT=5000");
+        }
+        if (!db.isOpen() && !db.open()) {
+            qDebug() << "Failed to open" << name << ":" << db.lastError().text();
+        }
+        promise->addResult(task(db));
+        promise->finish();
+    }, Qt::QueuedConnection);
+
+    return future;
+}
+
+template <typename T, typename Task>
+QFuture<T> ChatStorage::write(Task task)
+{
+    QFuture<T> future = post<T>(m_writer, task);
+    m_lastWrite = QFuture<void>(future);
+    return future;
+}
+
+template <typename T, typename Task>
+QFuture<T> ChatStorage::read(Task task)
+{
+    const Connection &reader = m_readers[m_nextReader];
+    m_nextReader = (m_nextReader + 1) % m_readers.size();
+
+    QFuture<void> barrier = m_lastWrite;
+    const QString archive = m_archivePath;
+    return post<T>(reader, [barrier, task, archive](QSqlDatabase &db) mutable {
+        barrier.waitForFinished();
+        attachArchive(db, archive, true);
+        return task(db);
+    });
+}
+
+static bool hasColumn(QSqlDatabase &db, const QString &table, const QString &column)
+{
+    QSqlQuery query(db);
+    query.exec("PRAGMA table_info(" + table + ")");
+    while (query.next()) {
+        if (query.value(1).toString() == column) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool execAll(QSqlDatabase &db, const QStringList &statements)
+{
+    QSqlQuery query(db);
+    for (const QString &sql : statements) {
+        if (!query.exec(sql)) {
+            qDebug() << "Migration statement failed:" << sql.left(80) << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+// v1: the schema as it stood before it was versioned. Databases from that
+// time may lack any of the later columns, hence the checks
+static bool migrateToV1(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+
+    bool ok = execAll(db, {
+        "CREATE TABLE IF NOT EXISTS chats ("
+        "id TEXT PRIMARY KEY, "
+        "title TEXT, "
+        "lastMessage TEXT, "
+        "lastTimestamp TEXT, "
+        "created_at TEXT)",
+        "CREATE TABLE IF NOT EXISTS messages ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "chat_id TEXT, "
+        "text TEXT, "
+        "isUser INTEGER, "
+        "timestamp TEXT, "
+        "blocks_json TEXT, "
+        "blocks BLOB, "
+        "text_z BLOB, "
+        "FOREIGN KEY(chat_id) REFERENCES chats(id) ON DELETE CASCADE)",
+        "CREATE TABLE IF NOT EXISTS settings ("
+        "key TEXT PRIMARY KEY, "
+        "value TEXT)",
+    });
+
+    // blocks: binary, see BlocksCodec. text_z: compressed body, see TextCodec
+    if (ok && !hasColumn(db, "messages", "blocks_json")) {
+        ok = query.exec("ALTER TABLE messages ADD COLUMN blocks_json TEXT");
+    }
+    if (ok && !hasColumn(db, "messages", "blocks")) {
+        ok = query.exec("ALTER TABLE messages ADD COLUMN blocks BLOB");
+    }
+    if (ok && !hasColumn(db, "messages", "text_z")) {
+        ok = query.exec("ALTER TABLE messages ADD COLUMN text_z BLOB");
+    }
+    if (ok && !hasColumn(db, "chats", "model_path")) {
+        ok = query.exec("ALTER TABLE chats ADD COLUMN model_path TEXT");
+    }
+    ok = ok && query.exec("CREATE INDEX IF NOT EXISTS idx_chat_messages_desc ON messages(chat_id, id DESC)");
+    if (!ok) {
+        return false;
+    }
+
+    // Full-text index over message text. External content: the index holds
+    // only tokens, the triggers keep it in step with every write path.
+    // Compressing a body sets text to NULL and must keep its tokens, so the
+    // triggers skip NULL text; rows with a compressed body are taken out of
+    // the index by unindexCompressed() before they change or go away
+    query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'messages_fts'");
+    bool hasFts = query.next();
+    query.finish();
+
+    if (!query.exec("CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5("
+                    "text, content='messages', content_rowid='id', "
+                    "tokenize='unicode61 remove_diacritics 2')")) {
+        // Search stays unavailable; not a reason to refuse the database
+        qDebug() << "Full-text search unavailable:" << query.lastError().text();
+        return true;
+    }
+
+    ok = execAll(db, {
+        "DROP TRIGGER IF EXISTS messages_fts_delete",
+        "DROP TRIGGER IF EXISTS messages_fts_update",
+        "CREATE TRIGGER IF NOT EXISTS messages_fts_insert AFTER INSERT ON messages BEGIN "
+        "INSERT INTO messages_fts(rowid, text) VALUES (new.id, new.text); END",
+        "CREATE TRIGGER messages_fts_delete AFTER DELETE ON messages "
+        "WHEN old.text IS NOT NULL BEGIN "
+        "INSERT INTO messages_fts(messages_fts, rowid, text) VALUES ('delete', old.id, old.text); END",
+        "CREATE TRIGGER messages_fts_update AFTER UPDATE OF text ON messages "
+        "WHEN new.text IS NOT NULL BEGIN "
+        "INSERT INTO messages_fts(messages_fts, rowid, text) "
+        "SELECT 'delete', old.id, old.text WHERE old.text IS NOT NULL; "
+        "INSERT INTO messages_fts(rowid, text) VALUES (new.id, new.text); END",
+    });
+
+    if (ok && !hasFts) {
+        QElapsedTimer timer;
+        timer.start();
+        ok = query.exec("INSERT INTO messages_fts(messages_fts) VALUES ('rebuild')");
+        qDebug() << "Built full-text index in" << timer.elapsed() << "ms";
+    }
+    return ok;
+}
+
+// v2: epoch-millisecond timestamps next to the display strings, which were
+// stored in local time, and a covering index for the chat list
+static bool migrateToV2(QSqlDatabase &db)
+{
+    return execAll(db, {
+        "ALTER TABLE chats ADD COLUMN last_ms INTEGER",
+        "ALTER TABLE chats ADD COLUMN created_ms INTEGER",
+        "ALTER TABLE messages ADD COLUMN ts_ms INTEGER",
+        "UPDATE chats SET "
+        "last_ms = CAST(strftime('%s', lastTimestamp, 'utc') AS INTEGER) * 1000, "
+        "created_ms = CAST(strftime('%s', created_at, 'utc') AS INTEGER) * 1000",
+        "UPDATE messages SET ts_ms = CAST(strftime('%s', timestamp, 'utc') AS INTEGER) * 1000",
+        // loadChats reads only these columns, in this order
+        "CREATE INDEX IF NOT EXISTS idx_chats_recent "
+        "ON chats(last_ms DESC, id, title, lastMessage, lastTimestamp, model_path)",
+    });
+}
+
+// v3: token ids per message and vocabulary, see saveLatestTokens(). They
+// go with their message; text is never edited once a reply is final
+static bool migrateToV3(QSqlDatabase &db)
+{
+    return execAll(db, {
+        "CREATE TABLE IF NOT EXISTS message_tokens ("
+        "message_id INTEGER NOT NULL, "
+        "vocab TEXT NOT NULL, "
+        "tokens BLOB NOT NULL, "
+        "PRIMARY KEY (message_id, vocab)) WITHOUT ROWID",
+        "CREATE TRIGGER IF NOT EXISTS message_tokens_delete AFTER DELETE ON messages BEGIN "
+        "DELETE FROM message_tokens WHERE message_id = old.id; END",
+    });
+}
+
+// Numbered schema migrations; PRAGMA user_version holds the last one
+// applied. Append only: a migration that has shipped never changes
+static const struct {
+    int version;
+    bool (*apply)(QSqlDatabase &db);
+} MIGRATIONS[] = {
+    {1, migrateToV1},
+    {2, migrateToV2},
+    {3, migrateToV3},
+};
+
+void ChatStorage::initSchema(QSqlDatabase &db)
+{
+    // SQLite optimizations
+    QSqlQuery pragmaQuery(db);
+    pragmaQuery.exec("PRAGMA journal_mode=WAL");
+    pragmaQuery.exec("PRAGMA synchronous=NORMAL");
+    pragmaQuery.exec("PRAGMA cache_size=-32000");
+    pragmaQuery.exec("PRAGMA temp_store=MEMORY");
+    // Only takes effect on a new database; lets freed pages go back to the disk
+    pragmaQuery.exec("PRAGMA auto_vacuum=INCREMENTAL");
+
+    qDebug() << "SQLite optimizations applied";
+
+    pragmaQuery.exec("PRAGMA user_version");
+    int version = pragmaQuery.next() ? pragmaQuery.value(0).toInt() : 0;
+    pragmaQuery.finish();
+
+    // Each migration commits with its version number, so a failed one is
+    // retried on the next start and never half-applied
+    for (const auto &migration : MIGRATIONS) {
+        if (migration.version <= version) {
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        db.transaction();
+        if (!migration.apply(db)
+            || !pragmaQuery.exec(QString("PRAGMA user_version = %1").arg(migration.version))
+            || !db.commit()) {
+            qDebug() << "Schema migration to v" << migration.version << "failed:" << db.lastError().text();
+            db.rollback();
+            break;
+        }
+        version = migration.version;
+        qDebug() << "Schema migrated to v" << version << "in" << timer.elapsed() << "ms";
+    }
+
+    qDebug() << "Database schema at v" << version;
+}
+
+// The archive holds chats and messages rows as they were in the main
+// database, ids included. Message ids stay unique across both: AUTOINCREMENT
+// never hands out an id again. No triggers; the archive's full-text index
+// is maintained by the moves themselves, see indexArchived()
+void ChatStorage::initArchiveSchema(QSqlDatabase &db)
+{
+    QSqlQuery pragmaQuery(db);
+    pragmaQuery.exec("PRAGMA archive.journal_mode=WAL");
+    pragmaQuery.exec("PRAGMA archive.synchronous=NORMAL");
+    pragmaQuery.exec("PRAGMA archive.auto_vacuum=INCREMENTAL");
+
+    bool ok = execAll(db, {
+        "CREATE TABLE IF NOT EXISTS archive.chats ("
+        "id TEXT PRIMARY KEY, "
+        "title TEXT, "
+        "lastMessage TEXT, "
+        "lastTimestamp TEXT, "
+        "created_at TEXT, "
+        "model_path TEXT, "
+        "last_ms INTEGER, "
+        "created_ms INTEGER)",
+        "CREATE TABLE IF NOT EXISTS archive.messages ("
+        "id INTEGER PRIMARY KEY, "
+        "chat_id TEXT, "
+        "text TEXT, "
+        "isUser INTEGER, "
+        "timestamp TEXT, "
+        "blocks_json TEXT, "
+        "blocks BLOB, "
+        "text_z BLOB, "
+        "ts_ms INTEGER)",
+        "CREATE INDEX IF NOT EXISTS archive.idx_archive_chat_messages ON messages(chat_id, id)",
+        "CREATE VIRTUAL TABLE IF NOT EXISTS archive.messages_fts USING fts5("
+        "text, content='messages', content_rowid='id', "
+        "tokenize='unicode61 remove_diacritics 2')",
+    });
+
+    if (!ok) {
+        qDebug() << "Archive database unusable, chats stay in the main database";
+        pragmaQuery.exec("DETACH DATABASE archive");
+        archiveState() = -1;
+    }
+}
+
+// User input as an FTS5 query: every word must match, the last one as a
+// prefix so results follow typing. Quoting keeps FTS5 syntax out of it
+static QString toFtsQuery(const QString &input)
+{
+    static const QRegularExpression whitespace("\\s+");
+    const QStringList words = input.split(whitespace, Qt::SkipEmptyParts);
+
+    QStringList terms;
+    for (const QString &word : words) {
+        QString term = word;
+        term.replace('"', "\"\"");
+        terms.append('"' + term + '"');
+    }
+    if (!terms.isEmpty() && !input.back().isSpace()) {
+        terms.last() += '*';
+    }
+    return terms.join(' ');
+}
+
+QFuture<QList<Chat>> ChatStorage::loadChats()
+{
+    return read<QList<Chat>>([](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::loadChats");
+        QList<Chat> chats;
+
+        // Metadata only; messages are loaded per chat when it is opened
+        // Served from idx_chats_recent alone
+        CachedQuery cached(db, "SELECT id, title, lastMessage, lastTimestamp, model_path, last_ms FROM chats "
+                               "ORDER BY last_ms DESC");
+        QSqlQuery &query = *cached;
+        if (!execTimed(query)) {
+            qDebug() << "Failed to load chats:" << query.lastError().text();
+            return chats;
+        }
+
+        while (query.next()) {
+            Chat chat;
+            chat.id = query.value(0).toString();
+            chat.title = query.value(1).toString();
+            chat.lastMessage = query.value(2).toString();
+            chat.lastTimestamp = query.value(3).toString();
+            chat.modelPath = query.value(4).toString();
+            chat.lastTimestampMs = query.value(5).toLongLong();
+            chats.append(chat);
+        }
+        return chats;
+    });
+}
+
+// The body of a row whose text and text_z columns are given
+static QString messageText(const QVariant &text, const QVariant &textZ)
+{
+    QString body;
+    if (textZ.isNull()) {
+        body = text.toString();
+    } else if (!TextCodec::decompress(textZ.toByteArray(), &body)) {
+        qDebug() << "Failed to decompress message body";
+    }
+    return body;
+}
+
+// Reads message rows in query order; decoding here keeps it off the GUI thread
+// too, and compressed bodies are only inflated for the page being shown
+static QList<Message> readMessages(QSqlQuery &query)
+{
+    QList<Message> messages;
+    while (query.next()) {
+        Message msg;
+        msg.id = query.value(0).toLongLong();
+        msg.text = messageText(query.value(1), query.value(6));
+        msg.isUser = query.value(2).toBool();
+        msg.timestamp = query.value(3).toString();
+        msg.timestampMs = query.value(7).toLongLong();
+
+        if (!msg.isUser && !BlocksCodec::decode(msg.text, query.value(4).toByteArray(), &msg.parsed)) {
+            // Not yet reached by the background blocks migration
+            QString blocksJson = query.value(5).toString();
+            msg.parsed = blocksJson.isEmpty() ? ChatManager::parseMarkdown(msg.text)
+                                              : BlocksCodec::decodeJson(blocksJson);
+        }
+
+        messages.append(msg);
+    }
+    return messages;
+}
+
+// Up to `limit` rows strictly before (older than) or after (newer than) `id`,
+// returned oldest first. Both walk the (chat_id, id) index from the key.
+static QList<Message> queryPage(QSqlDatabase &db, const QString &chatId, qint64 id, bool older, int limit)
+{
+    CachedQuery cached(db, older ? "SELECT id, text, isUser, timestamp, blocks, blocks_json, text_z, ts_ms "
+                                   "FROM messages WHERE chat_id = ? AND id < ? ORDER BY id DESC LIMIT ?"
+                                 : "SELECT id, text, isUser, timestamp, blocks, blocks_json, text_z, ts_ms "
+                                   "FROM messages WHERE chat_id = ? AND id > ? ORDER BY id ASC LIMIT ?");
+    QSqlQuery &query = *cached;
+    query.addBindValue(chatId);
+    query.addBindValue(id);
+    query.addBindValue(limit);
+
+    if (!execTimed(query)) {
+        qDebug() << "Failed to load messages:" << query.lastError().text();
+        return QList<Message>();
+    }
+
+    QList<Message> messages = readMessages(query);
+    if (older) {
+        std::reverse(messages.begin(), messages.end());
+    }
+    return messages;
+}
+
+static void finishPage(MessagePage &page)
+{
+    if (!page.messages.isEmpty()) {
+        page.oldestId = page.messages.first().id;
+        page.newestId = page.messages.last().id;
+    }
+}
+
+QFuture<MessagePage> ChatStorage::loadMessages(const QString &chatId, qint64 beforeId, int limit)
+{
+    return read<MessagePage>([chatId, beforeId, limit](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::loadMessages");
+        MessagePage page;
+        page.chatId = chatId;
+        page.messages = queryPage(db, chatId, beforeId < 0 ? LLONG_MAX : beforeId, true, limit);
+        page.hasMore = limit > 0 && page.messages.size() == limit;
+        finishPage(page);
+        return page;
+    });
+}
+
+QFuture<MessagePage> ChatStorage::loadNewerMessages(const QString &chatId, qint64 afterId, int limit)
+{
+    return read<MessagePage>([chatId, afterId, limit](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::loadNewerMessages");
+        MessagePage page;
+        page.chatId = chatId;
+        page.messages = queryPage(db, chatId, afterId, false, limit);
+        page.hasNewer = limit > 0 && page.messages.size() == limit;
+        finishPage(page);
+        return page;
+    });
+}
+
+QFuture<MessagePage> ChatStorage::loadMessagesAround(const QString &chatId, qint64 messageId, int limit)
+{
+    return read<MessagePage>([chatId, messageId, limit](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::loadMessagesAround");
+        MessagePage page;
+        page.chatId = chatId;
+
+        // The target and the older half, then the newer half
+        int before = qMax(1, limit / 2);
+        int after = qMax(1, limit - before);
+        page.messages = queryPage(db, chatId, messageId + 1, true, before);
+        page.hasMore = page.messages.size() == before;
+        QList<Message> newer = queryPage(db, chatId, messageId, false, after);
+        page.hasNewer = newer.size() == after;
+        page.messages += newer;
+
+        finishPage(page);
+        return page;
+    });
+}
+
+// snippet() reads the content table, which is NULL for a compressed body;
+// builds the same kind of excerpt from the inflated text instead
+static QString fallbackSnippet(const QString &body, const QString &input)
+{
+    static const QRegularExpression whitespace("\\s+");
+    const QStringList words = input.split(whitespace, Qt::SkipEmptyParts);
+
+    int first = -1;
+    for (const QString &word : words) {
+        int at = body.indexOf(word, 0, Qt::CaseInsensitive);
+        if (at >= 0 && (first < 0 || at < first)) {
+            first = at;
+        }
+    }
+
+    int start = qMax(0, first - 40);
+    QString excerpt = body.mid(start, 120);
+    for (const QString &word : words) {
+        for (int at = excerpt.indexOf(word, 0, Qt::CaseInsensitive); at >= 0;
+             at = excerpt.indexOf(word, at + word.size() + 2, Qt::CaseInsensitive)) {
+            excerpt.insert(at + word.size(), QChar(0xE001));
+            excerpt.insert(at, QChar(0xE000));
+        }
+    }
+    return (start > 0 ? QStringLiteral("…") : QString()) + excerpt
+           + (start + 120 < body.size() ? QStringLiteral("…") : QString());
+}
+
+QFuture<QList<SearchHit>> ChatStorage::search(const QString &text, int offset, int limit)
+{
+    const QString ftsQuery = toFtsQuery(text);
+    return read<QList<SearchHit>>([text, ftsQuery, offset, limit](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::search");
+        QList<SearchHit> hits;
+        if (ftsQuery.isEmpty()) {
+            return hits;
+        }
+
+        // Highlight markers from the private use area survive HTML escaping
+        static const QString hot = "SELECT m.id, m.chat_id, c.title, m.isUser, m.timestamp, "
+                                   "snippet(messages_fts, 0, char(57344), char(57345), '…', 16), "
+                                   "messages_fts.rank AS rank, m.text_z, 0 "
+                                   "FROM messages_fts "
+                                   "JOIN messages m ON m.id = messages_fts.rowid "
+                                   "LEFT JOIN chats c ON c.id = m.chat_id "
+                                   "WHERE messages_fts MATCH ? ";
+        // An interrupted move can leave a chat in both; the main copy wins
+        static const QString cold = "UNION ALL "
+                                    "SELECT m.id, m.chat_id, c.title, m.isUser, m.timestamp, "
+                                    "snippet(messages_fts, 0, char(57344), char(57345), '…', 16), "
+                                    "messages_fts.rank, m.text_z, 1 "
+                                    "FROM archive.messages_fts "
+                                    "JOIN archive.messages m ON m.id = messages_fts.rowid "
+                                    "LEFT JOIN archive.chats c ON c.id = m.chat_id "
+                                    "WHERE messages_fts MATCH ? "
+                                    "AND NOT EXISTS (SELECT 1 FROM main.chats h WHERE h.id = m.chat_id) ";
+        const bool archive = hasArchive();
+        CachedQuery cached(db, hot + (archive ? cold : QString()) + "ORDER BY rank LIMIT ? OFFSET ?");
+        QSqlQuery &query = *cached;
+        query.addBindValue(ftsQuery);
+        if (archive) {
+            query.addBindValue(ftsQuery);
+        }
+        query.addBindValue(limit);
+        query.addBindValue(offset);
+
+        if (!execTimed(query)) {
+            qDebug() << "Search failed:" << query.lastError().text();
+            return hits;
+        }
+
+        while (query.next()) {
+            SearchHit hit;
+            hit.messageId = query.value(0).toLongLong();
+            hit.chatId = query.value(1).toString();
+            hit.chatTitle = query.value(2).toString();
+            hit.isUser = query.value(3).toBool();
+            hit.timestamp = query.value(4).toString();
+            QString snippet = query.value(5).toString();
+            if (snippet.isEmpty() && !query.value(7).isNull()) {
+                snippet = fallbackSnippet(messageText(QVariant(), query.value(7)), text);
+            }
+            hit.snippet = snippet.simplified().toHtmlEscaped()
+                              .replace(QChar(0xE000), "<b>").replace(QChar(0xE001), "</b>");
+            hit.score = -query.value(6).toDouble();
+            hit.archived = query.value(8).toBool();
+            hits.append(hit);
+        }
+
+        // Row index within the chat, for this page only; walks the (chat_id, id)
+        // index. An archived chat keeps all its rows, so the index is the same
+        // once it is back
+        for (SearchHit &hit : hits) {
+            CachedQuery cachedPosition(db, hit.archived
+                                               ? "SELECT COUNT(*) FROM archive.messages WHERE chat_id = ? AND id < ?"
+                                               : "SELECT COUNT(*) FROM messages WHERE chat_id = ? AND id < ?");
+            QSqlQuery &position = *cachedPosition;
+            position.addBindValue(hit.chatId);
+            position.addBindValue(hit.messageId);
+            if (execTimed(position) && position.next()) {
+                hit.position = position.value(0).toInt();
+            }
+        }
+
+        return hits;
+    });
+}
+
+QFuture<QList<HistoryTurn>> ChatStorage::loadHistory(const QString &chatId, const QString &vocab, int limit)
+{
+    return read<QList<HistoryTurn>>([chatId, vocab, limit](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::loadHistory");
+        QList<HistoryTurn> turns;
+
+        // Bodies are only read, and inflated, for rows without cached ids
+        CachedQuery cached(db, "SELECT m.id, m.isUser, t.tokens, "
+                               "CASE WHEN t.tokens IS NULL THEN m.text END, "
+                               "CASE WHEN t.tokens IS NULL THEN m.text_z END "
+                               "FROM messages m LEFT JOIN message_tokens t "
+                               "ON t.message_id = m.id AND t.vocab = ? "
+                               "WHERE m.chat_id = ? ORDER BY m.id DESC LIMIT ?");
+        QSqlQuery &query = *cached;
+        query.addBindValue(vocab);
+        query.addBindValue(chatId);
+        query.addBindValue(limit);
+        if (!execTimed(query)) {
+            qDebug() << "Failed to load history:" << query.lastError().text();
+            return turns;
+        }
+
+        while (query.next()) {
+            HistoryTurn turn;
+            turn.messageId = query.value(0).toLongLong();
+            turn.isUser = query.value(1).toBool();
+            turn.tokens = query.value(2).toByteArray();
+            if (turn.tokens.isEmpty()) {
+                turn.text = messageText(query.value(3), query.value(4));
+            }
+            turns.prepend(turn);
+        }
+        return turns;
+    });
+}
+
+QFuture<QString> ChatStorage::loadSetting(const QString &key)
+{
+    return read<QString>([key](QSqlDatabase &db) {
+        CachedQuery cached(db, "SELECT value FROM settings WHERE key = ?");
+        QSqlQuery &query = *cached;
+        query.addBindValue(key);
+        return (execTimed(query) && query.next()) ? query.value(0).toString() : QString();
+    });
+}
+
+QFuture<bool> ChatStorage::saveChat(const Chat &chat)
+{
+    return write<bool>([this, chat](QSqlDatabase &db) {
+        CachedQuery cached(db, "INSERT INTO chats (id, title, lastMessage, lastTimestamp, created_at, model_path, "
+                               "last_ms, created_ms) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+        QSqlQuery &query = *cached;
+        query.addBindValue(chat.id);
+        query.addBindValue(chat.title);
+        query.addBindValue(chat.lastMessage);
+        query.addBindValue(chat.lastTimestamp);
+        query.addBindValue(chat.lastTimestamp);
+        query.addBindValue(chat.modelPath);
+        query.addBindValue(chat.lastTimestampMs);
+        query.addBindValue(chat.lastTimestampMs);
+
+        if (!execTimed(query)) {
+            emit writeFailed("Failed to save chat: " + query.lastError().text());
+            return false;
+        }
+        return true;
+    });
+}
+
+// Shared by the writer tasks that touch the chat row
+static bool updateChatRow(QSqlDatabase &db, const Chat &chat)
+{
+    CachedQuery cached(db, "UPDATE chats SET title = ?, lastMessage = ?, lastTimestamp = ?, model_path = ?, "
+                           "last_ms = ? WHERE id = ?");
+    QSqlQuery &query = *cached;
+    query.addBindValue(chat.title);
+    query.addBindValue(chat.lastMessage);
+    query.addBindValue(chat.lastTimestamp);
+    query.addBindValue(chat.modelPath);
+    query.addBindValue(chat.lastTimestampMs);
+    query.addBindValue(chat.id);
+    return execTimed(query);
+}
+
+// Removes the index entries of compressed rows matching `where`. The delete
+// and update triggers cannot, as FTS5 needs the original text to unindex it
+static void unindexCompressed(QSqlDatabase &db, const QString &where, const QVariant &key)
+{
+    QSqlQuery select(db);
+    select.prepare("SELECT id, text_z FROM messages WHERE " + where + " AND text_z IS NOT NULL");
+    select.addBindValue(key);
+    if (!execTimed(select)) {
+        return;
+    }
+
+    CachedQuery cached(db, "INSERT INTO messages_fts(messages_fts, rowid, text) VALUES ('delete', ?, ?)");
+    QSqlQuery &unindex = *cached;
+    while (select.next()) {
+        unindex.addBindValue(select.value(0));
+        unindex.addBindValue(messageText(QVariant(), select.value(1)));
+        execTimed(unindex);
+    }
+}
+
+// Moves a large body to text_z once it is final. The text stays indexed:
+// the update trigger skips NULL text
+static bool compressBody(QSqlDatabase &db, qint64 id, const QString &text)
+{
+    const QByteArray compressed = TextCodec::compress(text);
+    if (compressed.isEmpty()) {
+        return true;
+    }
+
+    CachedQuery cached(db, "UPDATE messages SET text = NULL, text_z = ? WHERE id = ?");
+    QSqlQuery &query = *cached;
+    query.addBindValue(compressed);
+    query.addBindValue(id);
+    return execTimed(query);
+}
+
+static const char *const CHAT_COLUMNS =
+    "id, title, lastMessage, lastTimestamp, created_at, model_path, last_ms, created_ms";
+static const char *const MESSAGE_COLUMNS =
+    "id, chat_id, text, isUser, timestamp, blocks_json, blocks, text_z, ts_ms";
+
+// Adds the archived messages of a chat to the archive's full-text index, or
+// removes them; compressed bodies are inflated for it
+static bool indexArchived(QSqlDatabase &db, const QString &chatId, bool remove)
+{
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    select.prepare("SELECT id, text, text_z FROM archive.messages WHERE chat_id = ?");
+    select.addBindValue(chatId);
+    if (!execTimed(select)) {
+        return false;
+    }
+
+    CachedQuery cached(db, remove ? "INSERT INTO archive.messages_fts(messages_fts, rowid, text) VALUES ('delete', ?, ?)"
+                                  : "INSERT INTO archive.messages_fts(rowid, text) VALUES (?, ?)");
+    QSqlQuery &index = *cached;
+    while (select.next()) {
+        index.addBindValue(select.value(0));
+        index.addBindValue(messageText(select.value(1), select.value(2)));
+        if (!execTimed(index)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Drops a chat's archived copy, if any
+static bool removeArchived(QSqlDatabase &db, const QString &chatId)
+{
+    if (!hasArchive()) {
+        return true;
+    }
+
+    QSqlQuery query(db);
+    bool ok = indexArchived(db, chatId, true);
+    query.prepare("DELETE FROM archive.messages WHERE chat_id = ?");
+    query.addBindValue(chatId);
+    ok = ok && execTimed(query);
+    query.prepare("DELETE FROM archive.chats WHERE id = ?");
+    query.addBindValue(chatId);
+    return ok && execTimed(query);
+}
+
+// Rows are copied as stored; the main database's triggers unindex the plain
+// bodies and drop the cached token ids as they are deleted
+static bool moveToArchive(QSqlDatabase &db, const QString &chatId)
+{
+    // A copy left by an interrupted move is replaced
+    bool ok = removeArchived(db, chatId);
+
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO archive.chats (%1) SELECT %1 FROM main.chats WHERE id = ?").arg(CHAT_COLUMNS));
+    query.addBindValue(chatId);
+    ok = ok && execTimed(query);
+    query.prepare(QString("INSERT INTO archive.messages (%1) SELECT %1 FROM main.messages WHERE chat_id = ?")
+                      .arg(MESSAGE_COLUMNS));
+    query.addBindValue(chatId);
+    ok = ok && execTimed(query) && indexArchived(db, chatId, false);
+    if (!ok) {
+        return false;
+    }
+
+    unindexCompressed(db, "chat_id = ?", chatId);
+    query.prepare("DELETE FROM main.messages WHERE chat_id = ?");
+    query.addBindValue(chatId);
+    ok = execTimed(query);
+    query.prepare("DELETE FROM main.chats WHERE id = ?");
+    query.addBindValue(chatId);
+    return ok && execTimed(query);
+}
+
+// Messages go back in plain, so the insert trigger indexes them, then get
+// their compressed body back; the update trigger skips NULL text
+static bool moveFromArchive(QSqlDatabase &db, const QString &chatId)
+{
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT OR IGNORE INTO main.chats (%1) SELECT %1 FROM archive.chats WHERE id = ?")
+                      .arg(CHAT_COLUMNS));
+    query.addBindValue(chatId);
+    bool ok = execTimed(query);
+
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    select.prepare("SELECT id, text, text_z, isUser, timestamp, blocks_json, blocks, ts_ms "
+                   "FROM archive.messages WHERE chat_id = ? ORDER BY id");
+    select.addBindValue(chatId);
+    ok = ok && execTimed(select);
+
+    // Rows still in the main database from an interrupted move stay as they are
+    CachedQuery cachedInsert(db, "INSERT OR IGNORE INTO main.messages "
+                                 "(id, chat_id, text, isUser, timestamp, blocks_json, blocks, ts_ms) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    QSqlQuery &insert = *cachedInsert;
+    CachedQuery cachedCompress(db, "UPDATE main.messages SET text = NULL, text_z = ? WHERE id = ?");
+    QSqlQuery &compress = *cachedCompress;
+    while (ok && select.next()) {
+        insert.addBindValue(select.value(0));
+        insert.addBindValue(chatId);
+        insert.addBindValue(messageText(select.value(1), select.value(2)));
+        insert.addBindValue(select.value(3));
+        insert.addBindValue(select.value(4));
+        insert.addBindValue(select.value(5));
+        insert.addBindValue(select.value(6));
+        insert.addBindValue(select.value(7));
+        ok = execTimed(insert);
+        if (ok && insert.numRowsAffected() > 0 && !select.value(2).isNull()) {
+            compress.addBindValue(select.value(2));
+            compress.addBindValue(select.value(0));
+            ok = execTimed(compress);
+        }
+    }
+    select.finish();
+
+    return ok && removeArchived(db, chatId);
+}
+
+QFuture<bool> ChatStorage::updateChat(const Chat &chat)
+{
+    return write<bool>([this, chat](QSqlDatabase &db) {
+        if (!updateChatRow(db, chat)) {
+            emit writeFailed("Failed to update chat: " + db.lastError().text());
+            return false;
+        }
+        return true;
+    });
+}
+
+QFuture<bool> ChatStorage::deleteChat(const QString &chatId)
+{
+    return write<bool>([this, chatId](QSqlDatabase &db) {
+        db.transaction();
+
+        QSqlQuery query(db);
+        query.prepare("DELETE FROM chats WHERE id = ?");
+        query.addBindValue(chatId);
+        bool ok = execTimed(query);
+
+        // Delete messages (if CASCADE is not configured)
+        unindexCompressed(db, "chat_id = ?", chatId);
+        query.prepare("DELETE FROM messages WHERE chat_id = ?");
+        query.addBindValue(chatId);
+        ok = execTimed(query) && ok;
+        ok = removeArchived(db, chatId) && ok;
+
+        if (!ok || !db.commit()) {
+            emit writeFailed("Failed to delete chat: " + query.lastError().text());
+            db.rollback();
+            return false;
+        }
+        return true;
+    });
+}
+
+QFuture<qint64> ChatStorage::appendMessage(const Chat &chat, const Message &message, const QByteArray &blocks)
+{
+    const bool compress = m_compressBodies;
+    return write<qint64>([this, chat, message, blocks, compress](QSqlDatabase &db) -> qint64 {
+        db.transaction();
+
+        CachedQuery cached(db, "INSERT INTO messages (chat_id, text, isUser, timestamp, ts_ms, blocks) "
+                               "VALUES (?, ?, ?, ?, ?, ?)");
+        QSqlQuery &query = *cached;
+        query.addBindValue(chat.id);
+        query.addBindValue(message.text);
+        query.addBindValue(message.isUser);
+        query.addBindValue(message.timestamp);
+        query.addBindValue(message.timestampMs);
+        query.addBindValue(blocks.isEmpty() ? QVariant() : QVariant(blocks));
+
+        bool ok = execTimed(query);
+        qint64 id = ok ? query.lastInsertId().toLongLong() : -1;
+        ok = ok && updateChatRow(db, chat);
+        // Inserted plain first so the trigger indexes the text. A reply is
+        // compressed by its final updateMessage, not while it streams
+        if (ok && compress && message.isUser) {
+            ok = compressBody(db, id, message.text);
+        }
+
+        if (!ok || !db.commit()) {
+            emit writeFailed("Failed to save message: " + query.lastError().text());
+            db.rollback();
+            return -1;
+        }
+        return id;
+    });
+}
+
+QFuture<bool> ChatStorage::updateMessage(const QFuture<qint64> &messageId, const QString &text,
+                                         const QByteArray &blocks, const Chat &chat)
+{
+    const bool compress = m_compressBodies;
+    return write<bool>([this, messageId, text, blocks, chat, compress](QSqlDatabase &db) {
+        // Writes run in order, so the insert that yields the id has already finished
+        qint64 id = messageId.isValid() ? messageId.result() : -1;
+        if (id < 0) {
+            return false;
+        }
+
+        db.transaction();
+
+        // The background compaction may have compressed it in the meantime
+        unindexCompressed(db, "id = ?", id);
+
+        CachedQuery cached(db, "UPDATE messages SET text = ?, text_z = NULL, blocks = COALESCE(?, blocks) WHERE id = ?");
+        QSqlQuery &query = *cached;
+        query.addBindValue(text);
+        query.addBindValue(blocks.isNull() ? QVariant() : QVariant(blocks));
+        query.addBindValue(id);
+
+        bool ok = execTimed(query) && updateChatRow(db, chat);
+        // Final blocks mean the reply is complete
+        if (ok && compress && !blocks.isNull()) {
+            ok = compressBody(db, id, text);
+        }
+        if (!ok || !db.commit()) {
+            emit writeFailed("Failed to update message: " + query.lastError().text());
+            db.rollback();
+            return false;
+        }
+        return true;
+    });
+}
+
+QFuture<bool> ChatStorage::saveSetting(const QString &key, const QString &value)
+{
+    return write<bool>([this, key, value](QSqlDatabase &db) {
+        CachedQuery cached(db, "INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?)");
+        QSqlQuery &query = *cached;
+        query.addBindValue(key);
+        query.addBindValue(value);
+
+        if (!execTimed(query)) {
+            emit writeFailed("Failed to save setting " + key + ": " + query.lastError().text());
+            return false;
+        }
+        return true;
+    });
+}
+
+QFuture<bool> ChatStorage::saveLatestTokens(const QString &chatId, bool isUser, const QString &vocab,
+                                            const QByteArray &tokens)
+{
+    return write<bool>([chatId, isUser, vocab, tokens](QSqlDatabase &db) {
+        CachedQuery cached(db, "INSERT OR REPLACE INTO message_tokens (message_id, vocab, tokens) "
+                               "SELECT id, ?, ? FROM messages WHERE chat_id = ? AND isUser = ? "
+                               "AND id = (SELECT MAX(id) FROM messages WHERE chat_id = ?)");
+        QSqlQuery &query = *cached;
+        query.addBindValue(vocab);
+        query.addBindValue(tokens);
+        query.addBindValue(chatId);
+        query.addBindValue(isUser);
+        query.addBindValue(chatId);
+        // A cache: a failure only costs a tokenization later
+        if (!execTimed(query)) {
+            qDebug() << "Failed to cache message tokens:" << query.lastError().text();
+            return false;
+        }
+        return query.numRowsAffected() > 0;
+    });
+}
+
+QFuture<bool> ChatStorage::saveTokens(const QString &vocab, const QList<HistoryTurn> &turns)
+{
+    return write<bool>([vocab, turns](QSqlDatabase &db) {
+        db.transaction();
+
+        // Skips messages deleted since they were read
+        CachedQuery cached(db, "INSERT OR REPLACE INTO message_tokens (message_id, vocab, tokens) "
+                               "SELECT id, ?, ? FROM messages WHERE id = ?");
+        QSqlQuery &query = *cached;
+        bool ok = true;
+        for (const HistoryTurn &turn : turns) {
+            query.addBindValue(vocab);
+            query.addBindValue(turn.tokens);
+            query.addBindValue(turn.messageId);
+            if (!execTimed(query)) {
+                ok = false;
+                break;
+            }
+        }
+
+        if (!ok || !db.commit()) {
+            qDebug() << "Failed to cache message tokens:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+        return true;
+    });
+}
+
+QFuture<int> ChatStorage::retainTokenVocabularies(const QString &vocab, int keep)
+{
+    return write<int>([vocab, keep](QSqlDatabase &db) {
+        db.transaction();
+
+        // Most recently used first
+        QSqlQuery query(db);
+        query.prepare("SELECT value FROM settings WHERE key = 'token_vocabs'");
+        QStringList vocabs;
+        if (execTimed(query) && query.next()) {
+            vocabs = query.value(0).toString().split(',', Qt::SkipEmptyParts);
+        }
+        query.finish();
+
+        vocabs.removeAll(vocab);
+        vocabs.prepend(vocab);
+        vocabs = vocabs.mid(0, qMax(keep, 1));
+
+        QStringList placeholders;
+        for (int i = 0; i < vocabs.size(); ++i) {
+            placeholders.append("?");
+        }
+        query.prepare("DELETE FROM message_tokens WHERE vocab NOT IN (" + placeholders.join(", ") + ")");
+        for (const QString &kept : std::as_const(vocabs)) {
+            query.addBindValue(kept);
+        }
+        bool ok = execTimed(query);
+        int dropped = ok ? query.numRowsAffected() : 0;
+
+        query.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES ('token_vocabs', ?)");
+        query.addBindValue(vocabs.join(','));
+        ok = ok && execTimed(query);
+
+        if (!ok || !db.commit()) {
+            qDebug() << "Failed to update token vocabularies:" << db.lastError().text();
+            db.rollback();
+            return 0;
+        }
+        return dropped;
+    });
+}
+
+QFuture<QStringList> ChatStorage::demoteChats(qint64 inactiveBeforeMs, int limit, const QString &keepChatId)
+{
+    return write<QStringList>([this, inactiveBeforeMs, limit, keepChatId](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::demoteChats");
+        QStringList ids;
+        if (!hasArchive()) {
+            return ids;
+        }
+
+        {
+            // The oldest end of idx_chats_recent
+            CachedQuery cached(db, "SELECT id FROM chats WHERE last_ms < ? AND id != ? ORDER BY last_ms LIMIT ?");
+            QSqlQuery &query = *cached;
+            query.addBindValue(inactiveBeforeMs);
+            query.addBindValue(keepChatId);
+            query.addBindValue(limit);
+            if (!execTimed(query)) {
+                return ids;
+            }
+            while (query.next()) {
+                ids.append(query.value(0).toString());
+            }
+        }
+        if (ids.isEmpty()) {
+            return ids;
+        }
+
+        // With WAL each file commits on its own; a crash in between leaves a
+        // chat in both, which search skips and the next move cleans up
+        db.transaction();
+        bool ok = true;
+        for (const QString &id : std::as_const(ids)) {
+            if (!(ok = moveToArchive(db, id))) {
+                break;
+            }
+        }
+        if (!ok || !db.commit()) {
+            emit writeFailed("Failed to archive chats: " + db.lastError().text());
+            db.rollback();
+            return QStringList();
+        }
+        return ids;
+    });
+}
+
+QFuture<Chat> ChatStorage::promoteChat(const QString &chatId)
+{
+    return write<Chat>([this, chatId](QSqlDatabase &db) {
+        TRACE_ZONE("db", "ChatStorage::promoteChat");
+        Chat chat;
+        if (!hasArchive()) {
+            return chat;
+        }
+
+        {
+            CachedQuery cached(db, "SELECT title, lastMessage, lastTimestamp, model_path FROM archive.chats WHERE id = ?");
+            QSqlQuery &query = *cached;
+            query.addBindValue(chatId);
+            if (!execTimed(query) || !query.next()) {
+                return chat;
+            }
+            chat.title = query.value(0).toString();
+            chat.lastMessage = query.value(1).toString();
+            chat.lastTimestamp = query.value(2).toString();
+            chat.modelPath = query.value(3).toString();
+        }
+        // Opening it counts as activity, or the next pass would move it straight back
+        chat.lastTimestampMs = QDateTime::currentMSecsSinceEpoch();
+
+        db.transaction();
+        bool ok = moveFromArchive(db, chatId);
+        QSqlQuery query(db);
+        query.prepare("UPDATE chats SET last_ms = ? WHERE id = ?");
+        query.addBindValue(chat.lastTimestampMs);
+        query.addBindValue(chatId);
+        ok = ok && execTimed(query);
+
+        if (!ok || !db.commit()) {
+            emit writeFailed("Failed to restore archived chat: " + db.lastError().text());
+            db.rollback();
+            return chat;
+        }
+        chat.id = chatId;
+        return chat;
+    });
+}
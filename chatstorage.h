@@ -0,0 +1,136 @@
+#ifndef CHATSTORAGE_H
+#define CHATSTORAGE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QSqlDatabase>
+#include "message.h"
+
+class QThread;
+
+// A contiguous run of one chat's messages, oldest first
+struct MessagePage {
+    QString chatId;
+    QList<Message> messages;
+    qint64 oldestId = -1;
+    qint64 newestId = -1;
+    bool hasMore = false;   // older rows exist before this page
+    bool hasNewer = false;  // newer rows exist after this page
+};
+
+// One full-text match; position is the message's row index in its chat
+struct SearchHit {
+    qint64 messageId = -1;
+    QString chatId;
+    QString chatTitle;
+    QString snippet;    // HTML-escaped, matches wrapped in <b>
+    QString timestamp;
+    bool isUser = false;
+    int position = -1;
+    double score = 0.0; // higher is better
+    bool archived = false; // in archive.db until its chat is opened
+};
+
+// SQLite access off the GUI thread. Writes run in call order on one thread
+// that holds the only read-write connection; reads are spread over a few
+// read-only connections, which WAL lets run alongside the writer. Every
+// call returns immediately; use QFuture::then(context, ...) to get the
+// result back on the calling thread. Call from one thread (the GUI).
+//
+// Chats inactive for long are moved to archive.db next to the database,
+// attached to every connection as "archive". The main database, and with
+// it the chat list, then only grows with the chats in use; search covers
+// both, and an archived chat moves back when it is opened.
+class ChatStorage : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatStorage(const QString &databasePath, QObject *parent = nullptr);
+    ~ChatStorage();
+
+    QString databasePath() const { return m_databasePath; }
+    static QString archivePath(const QString &databasePath);
+    // Finishes once every write issued so far is committed; for work that
+    // opens its own connection and must see them
+    QFuture<void> pendingWrites() const { return m_lastWrite; }
+
+    // Reads first wait for the writes issued before them, so callers always
+    // see their own changes
+    QFuture<QList<Chat>> loadChats();
+    // Keyset pages on (chat_id, id). loadMessages returns the newest rows
+    // before beforeId (-1: the end of the chat); limit < 0 loads them all
+    QFuture<MessagePage> loadMessages(const QString &chatId, qint64 beforeId = -1, int limit = -1);
+    QFuture<MessagePage> loadNewerMessages(const QString &chatId, qint64 afterId, int limit);
+    // About limit rows with messageId in the middle
+    QFuture<MessagePage> loadMessagesAround(const QString &chatId, qint64 messageId, int limit);
+    QFuture<QString> loadSetting(const QString &key);
+    // Ranked matches for free text over all messages, through the FTS5 index
+    QFuture<QList<SearchHit>> search(const QString &text, int offset, int limit);
+    // The newest `limit` messages of a chat, oldest first, with the token ids
+    // cached for `vocab`; only rows without them carry their text
+    QFuture<QList<HistoryTurn>> loadHistory(const QString &chatId, const QString &vocab, int limit);
+
+    QFuture<bool> saveChat(const Chat &chat);
+    QFuture<bool> updateChat(const Chat &chat);
+    QFuture<bool> deleteChat(const QString &chatId);
+    // Inserts the message with its BlocksCodec-encoded blocks and refreshes
+    // the chat row in one transaction; yields the row id
+    QFuture<qint64> appendMessage(const Chat &chat, const Message &message, const QByteArray &blocks);
+    // messageId may still be pending from appendMessage. Null blocks leave
+    // the stored blocks as they are; non-null ones mark the reply final, and
+    // a large final body is stored compressed
+    QFuture<bool> updateMessage(const QFuture<qint64> &messageId, const QString &text,
+                                const QByteArray &blocks, const Chat &chat);
+    QFuture<bool> saveSetting(const QString &key, const QString &value);
+
+    // Token id cache, keyed by message and by a hash of the vocabulary and
+    // turn format that produced the ids. saveLatestTokens stores them for the
+    // newest message of the chat, if it has the given role; writes run in
+    // call order, so it lands on the message appended just before
+    QFuture<bool> saveLatestTokens(const QString &chatId, bool isUser, const QString &vocab,
+                                   const QByteArray &tokens);
+    QFuture<bool> saveTokens(const QString &vocab, const QList<HistoryTurn> &turns);
+    // Makes vocab the current vocabulary and drops the ids of all but the
+    // `keep` most recently used ones; yields the rows dropped
+    QFuture<int> retainTokenVocabularies(const QString &vocab, int keep);
+
+    // Moves up to `limit` chats last active before inactiveBeforeMs, oldest
+    // first, to the archive in one transaction; yields their ids
+    QFuture<QStringList> demoteChats(qint64 inactiveBeforeMs, int limit, const QString &keepChatId);
+    // Moves an archived chat back and marks it active now; yields the chat,
+    // with an empty id when it is not archived
+    QFuture<Chat> promoteChat(const QString &chatId);
+
+signals:
+    // Emitted from the writer thread
+    void writeFailed(const QString &error);
+
+private:
+    struct Connection {
+        QThread *thread = nullptr;
+        QObject *context = nullptr;  // lives on `thread`; queued tasks run through it
+        QString name;
+    };
+
+    Connection startConnectionThread(const QString &name);
+    template <typename T, typename Task> QFuture<T> post(const Connection &connection, Task task);
+    template <typename T, typename Task> QFuture<T> write(Task task);
+    template <typename T, typename Task> QFuture<T> read(Task task);
+
+    static void initSchema(QSqlDatabase &db);
+    static void initArchiveSchema(QSqlDatabase &db);
+
+    QString m_databasePath;
+    QString m_archivePath;
+    Connection m_writer;
+    QList<Connection> m_readers;
+    int m_nextReader = 0;
+    bool m_compressBodies = true;  // large final bodies go to text_z (TextCodec)
+    QFuture<void> m_lastWrite;
+};
+
+#endif // CHATSTORAGE_H
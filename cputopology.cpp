@@ -0,0 +1,200 @@
+#include "cputopology.h"
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+static QString readSysFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QString();
+    }
+    return QString::fromLatin1(file.readAll()).trimmed();
+}
+
+CpuTopology CpuTopology::detect()
+{
+    CpuTopology topo;
+
+#ifdef Q_OS_LINUX
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) {
+                topo.m_allowedCpus.append(cpu);
+            }
+        }
+    }
+
+    QDir nodeDir("/sys/devices/system/node");
+    const QStringList entries = nodeDir.entryList(QStringList() << "node*", QDir::Dirs, QDir::Name);
+    for (const QString &entry : entries) {
+        bool ok = false;
+        int id = entry.mid(4).toInt(&ok);
+        if (!ok) continue;
+
+        NumaNode node;
+        node.id = id;
+        const QList<int> cpus = parseCpuList(readSysFile(nodeDir.filePath(entry + "/cpulist")));
+        for (int cpu : cpus) {
+            if (topo.m_allowedCpus.contains(cpu)) {
+                node.cpus.append(cpu);
+            }
+        }
+        if (!node.cpus.isEmpty()) {
+            topo.m_nodes.append(node);
+        }
+    }
+#endif
+
+    if (topo.m_allowedCpus.isEmpty()) {
+        for (int cpu = 0; cpu < QThread::idealThreadCount(); ++cpu) {
+            topo.m_allowedCpus.append(cpu);
+        }
+    }
+
+    if (topo.m_nodes.isEmpty()) {
+        NumaNode node;
+        node.cpus = topo.m_allowedCpus;
+        topo.m_nodes.append(node);
+    }
+
+    std::sort(topo.m_nodes.begin(), topo.m_nodes.end(),
+              [](const NumaNode &a, const NumaNode &b) { return a.id < b.id; });
+
+    return topo;
+}
+
+QList<int> CpuTopology::physicalCpus(const QList<int> &cpus) const
+{
+    QList<int> result;
+
+    for (int cpu : cpus) {
+        QList<int> siblingList = siblings(cpu);
+        if (!siblingList.isEmpty() && siblingList.first() != cpu && cpus.contains(siblingList.first())) {
+            continue;
+        }
+        result.append(cpu);
+    }
+
+    return result;
+}
+
+QList<int> CpuTopology::siblings(int cpu)
+{
+#ifdef Q_OS_LINUX
+    QList<int> result = parseCpuList(readSysFile(
+        QString("/sys/devices/system/cpu/cpu%1/topology/thread_siblings_list").arg(cpu)));
+    if (!result.isEmpty()) {
+        return result;
+    }
+#endif
+    return QList<int>() << cpu;
+}
+
+int CpuTopology::nodeOfCpu(int cpu) const
+{
+    for (const NumaNode &node : m_nodes) {
+        if (node.cpus.contains(cpu)) {
+            return node.id;
+        }
+    }
+    return m_nodes.isEmpty() ? 0 : m_nodes.first().id;
+}
+
+QString CpuTopology::summary() const
+{
+    QStringList parts;
+    for (const NumaNode &node : m_nodes) {
+        parts << QString("node%1: %2").arg(node.id).arg(formatCpuList(node.cpus));
+    }
+    return QString("%1 node%2, %3 CPUs (%4)")
+        .arg(m_nodes.size())
+        .arg(m_nodes.size() == 1 ? "" : "s")
+        .arg(m_allowedCpus.size())
+        .arg(parts.join("; "));
+}
+
+int CpuTopology::currentCpu()
+{
+#ifdef Q_OS_LINUX
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+bool CpuTopology::pinCurrentThread(const QList<int> &cpus)
+{
+    if (cpus.isEmpty()) {
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &mask);
+        }
+    }
+
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    if (rc != 0) {
+        qWarning() << "Failed to pin thread to CPUs" << formatCpuList(cpus) << "error" << rc;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+QList<int> CpuTopology::parseCpuList(const QString &list)
+{
+    QList<int> cpus;
+
+    const QStringList ranges = list.split(',', Qt::SkipEmptyParts);
+    for (const QString &range : ranges) {
+        const QStringList bounds = range.trimmed().split('-');
+        bool okFirst = false;
+        bool okLast = false;
+        int first = bounds.value(0).toInt(&okFirst);
+        int last = bounds.size() > 1 ? bounds.value(1).toInt(&okLast) : first;
+        if (!okFirst || (bounds.size() > 1 && !okLast)) continue;
+
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.append(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+QString CpuTopology::formatCpuList(const QList<int> &cpus)
+{
+    QList<int> sorted = cpus;
+    std::sort(sorted.begin(), sorted.end());
+
+    QStringList parts;
+    int i = 0;
+    while (i < sorted.size()) {
+        int j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) {
+            ++j;
+        }
+        parts << (i == j ? QString::number(sorted[i])
+                         : QString("%1-%2").arg(sorted[i]).arg(sorted[j]));
+        i = j + 1;
+    }
+
+    return parts.join(',');
+}
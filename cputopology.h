@@ -0,0 +1,41 @@
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <QList>
+#include <QString>
+
+// NUMA node and its logical CPUs
+struct NumaNode {
+    int id = 0;
+    QList<int> cpus;
+};
+
+// Host CPU layout read from sysfs (Linux); single node elsewhere
+class CpuTopology
+{
+public:
+    static CpuTopology detect();
+
+    QList<NumaNode> nodes() const { return m_nodes; }
+    QList<int> allowedCpus() const { return m_allowedCpus; }
+    int nodeCount() const { return m_nodes.size(); }
+    int cpuCount() const { return m_allowedCpus.size(); }
+
+    // One logical CPU per physical core (first SMT sibling)
+    QList<int> physicalCpus(const QList<int> &cpus) const;
+    static QList<int> siblings(int cpu);
+    int nodeOfCpu(int cpu) const;
+    QString summary() const;
+
+    static int currentCpu();
+    static bool pinCurrentThread(const QList<int> &cpus);
+
+    static QList<int> parseCpuList(const QString &list);
+    static QString formatCpuList(const QList<int> &cpus);
+
+private:
+    QList<NumaNode> m_nodes;
+    QList<int> m_allowedCpus;  // sched_getaffinity mask (respects numactl/taskset)
+};
+
+#endif // CPUTOPOLOGY_H
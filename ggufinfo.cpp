@@ -0,0 +1,172 @@
+#include "ggufinfo.h"
+#include <QHash>
+#include <gguf.h>
+#include <ggml.h>
+#include <cstring>
+
+// llama_ftype values stored in general.file_type
+QString ggufFileTypeName(int fileType)
+{
+    static const QHash<int, QString> names = {
+        {0, "F32"}, {1, "F16"}, {2, "Q4_0"}, {3, "Q4_1"}, {7, "Q8_0"}, {8, "Q5_0"}, {9, "Q5_1"},
+        {10, "Q2_K"}, {11, "Q3_K_S"}, {12, "Q3_K_M"}, {13, "Q3_K_L"}, {14, "Q4_K_S"}, {15, "Q4_K_M"},
+        {16, "Q5_K_S"}, {17, "Q5_K_M"}, {18, "Q6_K"}, {19, "IQ2_XXS"}, {20, "IQ2_XS"}, {21, "Q2_K_S"},
+        {22, "IQ3_XS"}, {23, "IQ3_XXS"}, {24, "IQ1_S"}, {25, "IQ4_NL"}, {26, "IQ3_S"}, {27, "IQ3_M"},
+        {28, "IQ2_S"}, {29, "IQ2_M"}, {30, "IQ4_XS"}, {31, "IQ1_M"}, {32, "BF16"}, {36, "TQ1_0"},
+        {37, "TQ2_0"}, {38, "MXFP4_MOE"},
+    };
+    return names.value(fileType);
+}
+
+static qint64 intValue(const gguf_context *ctx, const QByteArray &key, qint64 fallback = 0)
+{
+    int64_t id = gguf_find_key(ctx, key.constData());
+    if (id < 0) {
+        return fallback;
+    }
+    switch (gguf_get_kv_type(ctx, id)) {
+    case GGUF_TYPE_UINT8:  return gguf_get_val_u8(ctx, id);
+    case GGUF_TYPE_INT8:   return gguf_get_val_i8(ctx, id);
+    case GGUF_TYPE_UINT16: return gguf_get_val_u16(ctx, id);
+    case GGUF_TYPE_INT16:  return gguf_get_val_i16(ctx, id);
+    case GGUF_TYPE_UINT32: return gguf_get_val_u32(ctx, id);
+    case GGUF_TYPE_INT32:  return gguf_get_val_i32(ctx, id);
+    case GGUF_TYPE_UINT64: return static_cast<qint64>(gguf_get_val_u64(ctx, id));
+    case GGUF_TYPE_INT64:  return gguf_get_val_i64(ctx, id);
+    default:               return fallback;
+    }
+}
+
+static QString stringValue(const gguf_context *ctx, const char *key)
+{
+    int64_t id = gguf_find_key(ctx, key);
+    if (id < 0 || gguf_get_kv_type(ctx, id) != GGUF_TYPE_STRING) {
+        return QString();
+    }
+    return QString::fromUtf8(gguf_get_val_str(ctx, id));
+}
+
+GgufInfo readGgufInfo(const QString &path)
+{
+    GgufInfo info;
+
+    // no_alloc: only metadata and tensor descriptors are read, never the weights
+    ggml_context *meta = nullptr;
+    gguf_init_params params = { /*no_alloc =*/ true, /*ctx =*/ &meta };
+    gguf_context *ctx = gguf_init_from_file(path.toUtf8().constData(), params);
+    if (!ctx) {
+        info.error = "Not a readable GGUF file";
+        return info;
+    }
+
+    info.name = stringValue(ctx, "general.name");
+    info.type = stringValue(ctx, "general.type");
+    info.architecture = stringValue(ctx, "general.architecture");
+    const QByteArray arch = info.architecture.toUtf8();
+
+    info.contextLength = static_cast<int>(intValue(ctx, arch + ".context_length"));
+    info.blockCount = static_cast<int>(intValue(ctx, arch + ".block_count"));
+    info.embeddingLength = static_cast<int>(intValue(ctx, arch + ".embedding_length"));
+    info.headCount = static_cast<int>(intValue(ctx, arch + ".attention.head_count"));
+    info.headCountKv = static_cast<int>(intValue(ctx, arch + ".attention.head_count_kv", info.headCount));
+    info.keyLength = static_cast<int>(intValue(ctx, arch + ".attention.key_length"));
+    info.valueLength = static_cast<int>(intValue(ctx, arch + ".attention.value_length"));
+    info.expertCount = static_cast<int>(intValue(ctx, arch + ".expert_count"));
+    info.expertUsedCount = static_cast<int>(intValue(ctx, arch + ".expert_used_count"));
+
+    // Weights: element count and stored size; remember which type holds the most bytes
+    QHash<int, qint64> bytesByType;
+    const int64_t nTensors = gguf_get_n_tensors(ctx);
+    for (int64_t i = 0; i < nTensors; ++i) {
+        qint64 size = static_cast<qint64>(gguf_get_tensor_size(ctx, i));
+        info.tensorBytes += size;
+        bytesByType[gguf_get_tensor_type(ctx, i)] += size;
+        // Merged expert tensors (ffn_*_exps) are only partly read per token
+        if (std::strstr(gguf_get_tensor_name(ctx, i), "_exps")) {
+            info.expertTensorBytes += size;
+        }
+    }
+    if (meta) {
+        for (ggml_tensor *t = ggml_get_first_tensor(meta); t; t = ggml_get_next_tensor(meta, t)) {
+            info.parameterCount += ggml_nelements(t);
+        }
+    }
+
+    info.quantization = ggufFileTypeName(static_cast<int>(intValue(ctx, "general.file_type", -1)));
+    if (info.quantization.isEmpty() && !bytesByType.isEmpty()) {
+        int dominant = bytesByType.constBegin().key();
+        for (auto it = bytesByType.constBegin(); it != bytesByType.constEnd(); ++it) {
+            if (it.value() > bytesByType.value(dominant)) {
+                dominant = it.key();
+            }
+        }
+        info.quantization = QString::fromLatin1(ggml_type_name(static_cast<ggml_type>(dominant))).toUpper();
+    }
+
+    gguf_free(ctx);
+    if (meta) {
+        ggml_free(meta);
+    }
+
+    info.valid = true;
+    return info;
+}
+
+QString GgufInfo::parameterString() const
+{
+    if (parameterCount >= 1000000000LL) {
+        return QString::number(parameterCount / 1e9, 'f', 1) + "B";
+    }
+    if (parameterCount > 0) {
+        return QString::number(parameterCount / 1e6, 'f', 0) + "M";
+    }
+    return "Unknown";
+}
+
+QVariantMap GgufInfo::toVariantMap() const
+{
+    QVariantMap map;
+    map["valid"] = valid;
+    map["error"] = error;
+    map["name"] = name;
+    map["type"] = type;
+    map["architecture"] = architecture;
+    map["quantization"] = quantization;
+    map["parameterCount"] = parameterCount;
+    map["tensorBytes"] = tensorBytes;
+    map["contextLength"] = contextLength;
+    map["blockCount"] = blockCount;
+    map["embeddingLength"] = embeddingLength;
+    map["headCount"] = headCount;
+    map["headCountKv"] = headCountKv;
+    map["keyLength"] = keyLength;
+    map["valueLength"] = valueLength;
+    map["expertCount"] = expertCount;
+    map["expertUsedCount"] = expertUsedCount;
+    map["expertTensorBytes"] = expertTensorBytes;
+    return map;
+}
+
+GgufInfo GgufInfo::fromVariantMap(const QVariantMap &map)
+{
+    GgufInfo info;
+    info.valid = map.value("valid").toBool();
+    info.error = map.value("error").toString();
+    info.name = map.value("name").toString();
+    info.type = map.value("type").toString();
+    info.architecture = map.value("architecture").toString();
+    info.quantization = map.value("quantization").toString();
+    info.parameterCount = map.value("parameterCount").toLongLong();
+    info.tensorBytes = map.value("tensorBytes").toLongLong();
+    info.contextLength = map.value("contextLength").toInt();
+    info.blockCount = map.value("blockCount").toInt();
+    info.embeddingLength = map.value("embeddingLength").toInt();
+    info.headCount = map.value("headCount").toInt();
+    info.headCountKv = map.value("headCountKv").toInt();
+    info.keyLength = map.value("keyLength").toInt();
+    info.valueLength = map.value("valueLength").toInt();
+    info.expertCount = map.value("expertCount").toInt();
+    info.expertUsedCount = map.value("expertUsedCount").toInt();
+    info.expertTensorBytes = map.value("expertTensorBytes").toLongLong();
+    return info;
+}
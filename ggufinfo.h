@@ -0,0 +1,43 @@
+#ifndef GGUFINFO_H
+#define GGUFINFO_H
+
+#include <QString>
+#include <QVariantMap>
+
+// Model metadata read from a GGUF header without loading any weights
+struct GgufInfo {
+    bool valid = false;
+    QString error;
+
+    QString name;
+    QString type;             // general.type: "model" or "adapter" (LoRA)
+    QString architecture;
+    QString quantization;     // e.g. Q4_K_M, from general.file_type or the dominant tensor type
+    qint64 parameterCount = 0;
+    qint64 tensorBytes = 0;   // size of all weights as stored
+    int contextLength = 0;    // training context
+    int blockCount = 0;
+    int embeddingLength = 0;
+    int headCount = 0;
+    int headCountKv = 0;
+    int keyLength = 0;        // per head; 0 = embedding / heads
+    int valueLength = 0;
+    int expertCount = 0;      // MoE: experts per layer, and used per token
+    int expertUsedCount = 0;
+    qint64 expertTensorBytes = 0;
+
+    bool isAdapter() const { return type == "adapter"; }
+
+    QVariantMap toVariantMap() const;
+    static GgufInfo fromVariantMap(const QVariantMap &map);
+
+    // "7.2B", "350M"
+    QString parameterString() const;
+};
+
+GgufInfo readGgufInfo(const QString &path);
+
+// Name of a general.file_type value (llama_ftype), empty if unknown
+QString ggufFileTypeName(int fileType);
+
+#endif // GGUFINFO_H
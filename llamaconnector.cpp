@@ -2,11 +2,55 @@
 #include <QDebug>
 #include <QFile>
 #include <chrono>
-#include <QCoreApplication>
+#include <algorithm>
+#include <QSet>
+#include <QStandardPaths>
+#include <QSettings>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <cstring>
+#include "chatstorage.h"
+#include "procfs.h"
+#include "tracer.h"
+#include <ggml-backend.h>
+#include <ggml-cpu.h>
+
+// ChatML turns. The token id cache is keyed by these too (vocabularyKey)
+static const QString SYSTEM_PROMPT = "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n";
+
+static QString userTurn(const QString &message)
+{
+    return "<|im_start|>user\n" + message + "<|im_end|>\n<|im_start|>assistant\n";
+}
 
-LlamaWorker::LlamaWorker(QObject *parent)
+static QByteArray tokensToBlob(const std::vector<llama_token> &tokens)
+{
+    return QByteArray(reinterpret_cast<const char *>(tokens.data()),
+                      qsizetype(tokens.size() * sizeof(llama_token)));
+}
+
+static std::vector<llama_token> blobToTokens(const QByteArray &blob)
+{
+    std::vector<llama_token> tokens(blob.size() / sizeof(llama_token));
+    memcpy(tokens.data(), blob.constData(), tokens.size() * sizeof(llama_token));
+    return tokens;
+}
+
+LlamaWorker::LlamaWorker(const QString &kvDir, QObject *parent)
     : QObject(parent), m_shouldStop(0)
 {
+    // One spill folder per resident model below this one. States from a
+    // previous run belong to contexts that no longer exist
+    m_kvDir = kvDir.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/kv" : kvDir;
+    QDir(m_kvDir).removeRecursively();
+
+    QSettings settings("YourCompany", "AIChatGUI");
+    m_maxResidentModels = std::clamp(settings.value("maxResidentModels", 2).toInt(), 1, 8);
+    registerMetrics();
+
 #ifdef _WIN32
     _putenv("GGML_CUDA_FORCE_CUBLAS=1");
     _putenv("GGML_CUDA_NO_PEER_COPY=1");
@@ -20,212 +64,1318 @@ LlamaWorker::LlamaWorker(QObject *parent)
     setenv("GGML_CUDA_F16", "1", 1);
 #endif
 
-    llama_backend_init();
+#ifdef AICHAT_BACKEND_DL
+    // Loads every ggml backend module next to the executable; for the CPU
+    // the variant with the highest score on this host wins
+    ggml_backend_load_all();
+#endif
+
+    llama_backend_init();
+    detectBackend();
+
+    qDebug() << "=== Backend Selection ===";
+    qDebug() << "Backend:" << m_backendName;
+    qDebug() << "CPU ISA:" << m_cpuIsa;
+    qDebug() << "CPU features:" << m_cpuFeatures;
+
+    qDebug() << "=== llama.cpp system info ===";
+    qDebug() << llama_print_system_info();
+    qDebug() << "=== GPU Support Check ===";
+    qDebug() << "GPU offload supported:" << llama_supports_gpu_offload();
+    qDebug() << "MMAP supported:" << llama_supports_mmap();
+    qDebug() << "MLOCK supported:" << llama_supports_mlock();
+}
+
+void LlamaWorker::registerMetrics()
+{
+    Metrics &registry = Metrics::instance();
+    m_metrics.requests = registry.counter("aichat_requests_total", "Chat requests processed");
+    m_metrics.requestsFailed = registry.counter("aichat_requests_failed_total", "Chat requests that failed");
+    m_metrics.requestsStopped = registry.counter("aichat_requests_stopped_total", "Chat requests stopped by the user");
+    m_metrics.promptTokens = registry.counter("aichat_prompt_tokens_total", "Prompt tokens decoded (prefill)");
+    m_metrics.generatedTokens = registry.counter("aichat_generated_tokens_total", "Tokens generated (decode)");
+    m_metrics.queueDepth = registry.gauge("aichat_queue_depth", "Requests queued for the worker");
+    m_metrics.prefillRate = registry.gauge("aichat_prefill_tokens_per_second", "Prefill throughput of the last request");
+    m_metrics.decodeRate = registry.gauge("aichat_decode_tokens_per_second", "Decode throughput of the last request");
+    m_metrics.kvTokens = registry.gauge("aichat_kv_tokens", "Tokens held in the live KV cache");
+    m_metrics.contextSize = registry.gauge("aichat_context_size_tokens", "Size of the live context");
+    m_metrics.stateCacheBytes = registry.gauge("aichat_state_cache_bytes", "Parked KV state held in RAM");
+    m_metrics.prefillSeconds = registry.histogram("aichat_prefill_duration_seconds", "Prompt decode time",
+                                                  Metrics::latencyBuckets());
+    m_metrics.timeToFirstToken = registry.histogram("aichat_time_to_first_token_seconds",
+                                                    "Time from request start to the first sampled token",
+                                                    Metrics::latencyBuckets());
+    m_metrics.requestSeconds = registry.histogram("aichat_request_duration_seconds", "Total request time",
+                                                  Metrics::latencyBuckets());
+
+    // Same thread, so these run inline with the emit
+    connect(this, &LlamaWorker::stateCacheChanged, this, [this](qint64 memoryBytes, qint64) {
+        m_metrics.stateCacheBytes->set(memoryBytes);
+    });
+    connect(this, &LlamaWorker::contextChanged, this, [this](int nCtx) {
+        m_metrics.contextSize->set(nCtx);
+    });
+}
+
+void LlamaWorker::recordRequestMetrics(int nGen, double totalSec, double decodeSec)
+{
+    m_metrics.generatedTokens->add(nGen);
+    if (nGen > 0 && decodeSec > 0.0) {
+        m_metrics.decodeRate->set(nGen / decodeSec);
+    }
+    m_metrics.requestSeconds->observe(totalSec);
+    m_metrics.kvTokens->set(m_n_past);
+}
+
+LlamaWorker::~LlamaWorker()
+{
+    delete m_recorder;
+    if (sampler) llama_sampler_free(sampler);
+    if (ctx) llama_free(ctx);
+    if (model) llama_model_free(model);
+    delete m_stateCache;
+    trimResidentModels(0);
+    freeThreadpools();
+    llama_backend_free();
+}
+
+QList<int> LlamaWorker::configureThreading(const CpuTopology &topology, const QString &numaStrategy,
+                                           const QString &priority)
+{
+    ggml_numa_strategy strategy = GGML_NUMA_STRATEGY_DISABLED;
+    if (numaStrategy == "distribute") strategy = GGML_NUMA_STRATEGY_DISTRIBUTE;
+    else if (numaStrategy == "isolate") strategy = GGML_NUMA_STRATEGY_ISOLATE;
+    else if (numaStrategy == "numactl") strategy = GGML_NUMA_STRATEGY_NUMACTL;
+
+    llama_numa_init(strategy);
+
+    if (priority == "medium") m_threadPriority = GGML_SCHED_PRIO_MEDIUM;
+    else if (priority == "high") m_threadPriority = GGML_SCHED_PRIO_HIGH;
+    else m_threadPriority = GGML_SCHED_PRIO_NORMAL;
+
+    // Candidate CPUs for inference
+    QList<int> candidates;
+    if (strategy == GGML_NUMA_STRATEGY_ISOLATE) {
+        int node = topology.nodeOfCpu(CpuTopology::currentCpu());
+        for (const NumaNode &n : topology.nodes()) {
+            if (n.id == node) candidates = n.cpus;
+        }
+    } else if (strategy == GGML_NUMA_STRATEGY_DISTRIBUTE) {
+        // Interleave nodes so any thread count spreads across sockets
+        QList<QList<int>> perNode;
+        int longest = 0;
+        for (const NumaNode &n : topology.nodes()) {
+            perNode.append(topology.physicalCpus(n.cpus));
+            longest = std::max(longest, int(perNode.last().size()));
+        }
+        for (int i = 0; i < longest; ++i) {
+            for (const QList<int> &cpus : perNode) {
+                if (i < cpus.size()) candidates.append(cpus[i]);
+            }
+        }
+    } else {
+        // NUMACTL: the affinity mask set by numactl is already the allowed set
+        candidates = topology.allowedCpus();
+    }
+
+    QList<int> physical = topology.physicalCpus(candidates);
+    QList<int> guiCpus;
+
+    // Keep one physical core (with its SMT siblings) for GUI/DB threads.
+    // With ISOLATE the other nodes are free, so take those instead
+    if (strategy == GGML_NUMA_STRATEGY_ISOLATE && topology.nodeCount() > 1) {
+        for (int cpu : topology.allowedCpus()) {
+            if (!candidates.contains(cpu)) guiCpus.append(cpu);
+        }
+    } else if (strategy != GGML_NUMA_STRATEGY_DISABLED && physical.size() > 4) {
+        int reserved = physical.takeFirst();
+        for (int cpu : CpuTopology::siblings(reserved)) {
+            if (topology.allowedCpus().contains(cpu)) guiCpus.append(cpu);
+        }
+    }
+
+    m_decodeCpus = physical;
+    m_inferenceCpus.clear();
+    for (int cpu : physical) {
+        for (int sibling : CpuTopology::siblings(cpu)) {
+            if (candidates.contains(sibling) && !guiCpus.contains(sibling)) {
+                m_inferenceCpus.append(sibling);
+            }
+        }
+    }
+
+    m_pinThreads = (strategy != GGML_NUMA_STRATEGY_DISABLED);
+    m_decodeThreads = std::clamp(int(physical.size()), 1, GGML_MAX_N_THREADS);
+    m_batchThreads = std::clamp(int(m_inferenceCpus.size()), 1, GGML_MAX_N_THREADS);
+
+    if (m_pinThreads) {
+        m_threadPinning = QString("decode %1 thr on %2 • prefill %3 thr on %4")
+                              .arg(m_decodeThreads).arg(CpuTopology::formatCpuList(m_decodeCpus))
+                              .arg(m_batchThreads).arg(CpuTopology::formatCpuList(m_inferenceCpus));
+        if (!guiCpus.isEmpty()) {
+            m_threadPinning += " • GUI/DB on " + CpuTopology::formatCpuList(guiCpus);
+        }
+    } else {
+        m_threadPinning = QString("decode %1 thr • prefill %2 thr (unpinned)")
+                              .arg(m_decodeThreads).arg(m_batchThreads);
+    }
+
+    qDebug() << "=== Threading ===";
+    qDebug() << "NUMA strategy:" << numaStrategy;
+    qDebug() << "Topology:" << topology.summary();
+    qDebug() << "Pinning:" << m_threadPinning;
+
+    return m_pinThreads ? guiCpus : QList<int>();
+}
+
+void LlamaWorker::ensureThreadpools()
+{
+    if (!ctx || m_threadpoolCtx == ctx) {
+        return;
+    }
+
+    if (!m_threadpool) {
+        // Go through the CPU backend registry so this also works when
+        // ggml-cpu is a dynamically loaded module
+        ggml_backend_dev_t cpuDev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+        ggml_backend_reg_t cpuReg = cpuDev ? ggml_backend_dev_backend_reg(cpuDev) : nullptr;
+        auto threadpoolNew = cpuReg ? (decltype(ggml_threadpool_new) *)
+            ggml_backend_reg_get_proc_address(cpuReg, "ggml_threadpool_new") : nullptr;
+
+        if (!threadpoolNew) {
+            qDebug() << "WARNING: ggml_threadpool_new not available, using default threads";
+            m_threadpoolCtx = ctx;
+            return;
+        }
+
+        if (m_pinThreads) {
+            // The calling thread is worker 0 of every graph compute
+            CpuTopology::pinCurrentThread(m_inferenceCpus);
+        }
+
+        ggml_threadpool_params decodeParams = ggml_threadpool_params_default(m_decodeThreads);
+        decodeParams.prio = m_threadPriority;
+        decodeParams.poll = 50;
+        decodeParams.strict_cpu = m_pinThreads;
+
+        ggml_threadpool_params batchParams = ggml_threadpool_params_default(m_batchThreads);
+        batchParams.prio = m_threadPriority;
+        batchParams.poll = 0;
+        batchParams.strict_cpu = m_pinThreads;
+
+        if (m_pinThreads) {
+            for (int cpu : m_decodeCpus) {
+                if (cpu < GGML_MAX_N_THREADS) decodeParams.cpumask[cpu] = true;
+            }
+            for (int cpu : m_inferenceCpus) {
+                if (cpu < GGML_MAX_N_THREADS) batchParams.cpumask[cpu] = true;
+            }
+        }
+
+        m_threadpool = threadpoolNew(&decodeParams);
+        m_threadpoolBatch = threadpoolNew(&batchParams);
+
+        if (!m_threadpool || !m_threadpoolBatch) {
+            qDebug() << "WARNING: Failed to create threadpools";
+            freeThreadpools();
+            m_threadpoolCtx = ctx;
+            return;
+        }
+    }
+
+    llama_attach_threadpool(ctx, m_threadpool, m_threadpoolBatch);
+    m_threadpoolCtx = ctx;
+    qDebug() << "Threadpools attached: decode" << m_decodeThreads << "prefill" << m_batchThreads;
+}
+
+void LlamaWorker::freeThreadpools()
+{
+    if (!m_threadpool && !m_threadpoolBatch) {
+        return;
+    }
+
+    ggml_backend_dev_t cpuDev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    ggml_backend_reg_t cpuReg = cpuDev ? ggml_backend_dev_backend_reg(cpuDev) : nullptr;
+    auto threadpoolFree = cpuReg ? (decltype(ggml_threadpool_free) *)
+        ggml_backend_reg_get_proc_address(cpuReg, "ggml_threadpool_free") : nullptr;
+
+    if (threadpoolFree) {
+        if (m_threadpool) threadpoolFree(m_threadpool);
+        if (m_threadpoolBatch) threadpoolFree(m_threadpoolBatch);
+    }
+    m_threadpool = nullptr;
+    m_threadpoolBatch = nullptr;
+    m_threadpoolCtx = nullptr;
+}
+
+void LlamaWorker::detectBackend()
+{
+    QStringList devices;
+    for (size_t i = 0; i < ggml_backend_dev_count(); i++) {
+        ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+        if (ggml_backend_dev_type(dev) != GGML_BACKEND_DEVICE_TYPE_CPU) {
+            devices << QString::fromUtf8(ggml_backend_dev_name(dev));
+        }
+    }
+    devices << "CPU";
+    m_backendName = devices.join(" + ");
+
+    ggml_backend_dev_t cpuDev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    if (!cpuDev) {
+        m_cpuIsa = "N/A";
+        return;
+    }
+
+    ggml_backend_reg_t cpuReg = ggml_backend_dev_backend_reg(cpuDev);
+    auto getFeatures = (ggml_backend_get_features_t)
+        ggml_backend_reg_get_proc_address(cpuReg, "ggml_backend_get_features");
+
+    QSet<QString> enabled;
+    QStringList featureList;
+    if (getFeatures) {
+        for (ggml_backend_feature *f = getFeatures(cpuReg); f && f->name; f++) {
+            QString name = QString::fromUtf8(f->name);
+            QString value = QString::fromUtf8(f->value);
+            if (value == "1") {
+                enabled.insert(name);
+                featureList << name;
+            } else {
+                featureList << name + "=" + value;
+            }
+        }
+    }
+    m_cpuFeatures = featureList.join(" ");
+
+    // Report the widest ISA the selected variant was compiled for
+    if (enabled.contains("AMX_INT8")) {
+        m_cpuIsa = "AMX";
+    } else if (enabled.contains("AVX512")) {
+        m_cpuIsa = enabled.contains("AVX512_VNNI") ? "AVX-512 VNNI" : "AVX-512";
+    } else if (enabled.contains("AVX_VNNI")) {
+        m_cpuIsa = "AVX-VNNI";
+    } else if (enabled.contains("AVX2")) {
+        m_cpuIsa = "AVX2";
+    } else if (enabled.contains("AVX")) {
+        m_cpuIsa = "AVX";
+    } else if (enabled.contains("SSE42")) {
+        m_cpuIsa = "SSE4.2";
+    } else if (enabled.contains("NEON")) {
+        m_cpuIsa = enabled.contains("SVE") ? "NEON + SVE" : "NEON";
+    } else {
+        m_cpuIsa = "Baseline";
+    }
+}
+
+void LlamaWorker::unloadModel()
+{
+    qDebug() << "=== LlamaWorker::unloadModel ===";
+
+    if (sampler) {
+        llama_sampler_free(sampler);
+        sampler = nullptr;
+    }
+    if (ctx) {
+        llama_free(ctx);
+        ctx = nullptr;
+        m_threadpoolCtx = nullptr;
+    }
+    if (model) {
+        llama_model_free(model);
+        model = nullptr;
+    }
+
+    vocab = nullptr;
+    m_n_past = 0;
+    m_session_tokens.clear();
+    delete m_stateCache;
+    m_stateCache = nullptr;
+    m_adapters.clear();
+    m_modelPath.clear();
+    m_modelFingerprint.clear();
+
+    // Unload frees memory, so resident models go too
+    trimResidentModels(0);
+    emitResidentModels();
+    emitLoraAdapters();
+    emit stateCacheChanged(0, 0);
+
+    qDebug() << "Model unloaded successfully";
+    emit modelUnloaded();
+}
+
+bool LlamaWorker::abortCallback(void *data)
+{
+    // Polled by ggml between graph nodes, so an in-flight decode stops
+    // within milliseconds instead of after the current token
+    auto *self = static_cast<LlamaWorker *>(data);
+    return self->m_shouldStop.loadRelaxed() == 1;
+}
+
+void LlamaWorker::loadModel(const QString &modelPath)
+{
+    TRACE_ZONE("llm", "loadModel");
+    bool success = initialize(modelPath);
+    requestHistory();
+    emit modelLoadFinished(success, modelPath);
+}
+
+bool LlamaWorker::createContext(int nCtx)
+{
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = nCtx;
+    ctx_params.n_batch = 8192;
+    ctx_params.n_ubatch = 2048;
+    ctx_params.n_threads = m_decodeThreads;
+    ctx_params.n_threads_batch = m_batchThreads;
+    ctx_params.offload_kqv = true;
+    ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    ctx_params.rope_scaling_type = LLAMA_ROPE_SCALING_TYPE_LINEAR;
+    ctx_params.yarn_ext_factor = -1.0f;
+    ctx_params.yarn_attn_factor = 1.0f;
+    ctx_params.yarn_beta_fast = 32.0f;
+    ctx_params.yarn_beta_slow = 1.0f;
+
+    qDebug() << "=== Context Configuration ===";
+    qDebug() << "Context size:" << ctx_params.n_ctx;
+    qDebug() << "KQV offload:" << ctx_params.offload_kqv;
+    qDebug() << "Flash attention:" << (ctx_params.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_ENABLED ? "enabled" : "disabled");
+
+    ctx = llama_init_from_model(model, ctx_params);
+    if (!ctx) {
+        return false;
+    }
+
+    llama_set_abort_callback(ctx, &LlamaWorker::abortCallback, this);
+    m_contextSize = nCtx;
+    m_metrics.contextSize->set(nCtx);
+    m_threadpoolCtx = nullptr;
+    applyLoraAdapter();
+    return true;
+}
+
+bool LlamaWorker::initialize(const QString &modelPath)
+{
+    if (model && ctx && modelPath == m_modelPath) {
+        qDebug() << "Model already active:" << modelPath;
+        emit modelLoadedSuccessfully();
+        return true;
+    }
+
+    int resident = -1;
+    for (int i = 0; i < m_residentModels.size(); ++i) {
+        if (m_residentModels[i].path == modelPath) {
+            resident = i;
+            break;
+        }
+    }
+
+    if (resident < 0 && !QFile::exists(modelPath)) {
+        emit errorOccurred("Model file not found: " + modelPath);
+        return false;
+    }
+
+    // The current model stays active until the new one has a context, so a
+    // bad pick in the model list leaves the working model in place
+    ResidentModel next;
+    if (resident >= 0) {
+        next = m_residentModels.takeAt(resident);
+        qDebug() << "Activating resident model:" << modelPath;
+    } else {
+        // Make room for the new model, and for the current one once parked
+        trimResidentModels(m_maxResidentModels - 2);
+        emitResidentModels();
+
+        next.path = modelPath;
+        next.model = loadModelFile(modelPath);
+        if (!next.model) {
+            return false;
+        }
+    }
+
+    // Hands the candidate back unchanged after a failure
+    auto discardNext = [this, &next, resident]() {
+        if (resident >= 0) {
+            m_residentModels.insert(resident, next);
+        } else {
+            llama_model_free(next.model);
+        }
+        emitResidentModels();
+    };
+
+    const llama_vocab *nextVocab = llama_model_get_vocab(next.model);
+    if (!nextVocab) {
+        emit errorOccurred("Failed to get vocabulary");
+        discardNext();
+        return false;
+    }
+
+    // The open chat's KV state is parked in its model's cache, so the old
+    // context can be recreated if the new one can't be created
+    const int previousContextSize = m_contextSize;
+    ResidentModel previous = detachActiveModel();
+
+    model = next.model;
+    vocab = nextVocab;
+    m_adapters = next.adapters;
+
+    // Before the context exists, so createContext attaches the chat's adapter
+    auto selection = m_chatLora.value(m_activeChatId, qMakePair(QString(), 1.0f));
+    m_loraPath = selection.first;
+    m_loraScale = selection.second;
+
+    if (!createContext(DEFAULT_CONTEXT_SIZE)) {
+        emit errorOccurred("Failed to create context");
+        model = nullptr;
+        vocab = nullptr;
+        m_adapters.clear();
+        discardNext();
+        if (previous.model) {
+            reattachModel(previous, previousContextSize);
+        }
+        return false;
+    }
+
+    // Cached states are only valid for the model they came from
+    if (next.states) {
+        m_stateCache = next.states;
+    } else {
+        QString key = QCryptographicHash::hash(modelPath.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+        m_stateCache = new SequenceStateCache(m_kvDir + "/" + key);
+    }
+
+    // Now the previous model is parked, or freed when only one may be loaded
+    if (previous.model) {
+        keepResident(previous);
+    }
+    trimResidentModels(m_maxResidentModels - 1);
+
+    activateContext(modelPath);
+    return true;
+}
+
+void LlamaWorker::activateContext(const QString &modelPath)
+{
+    resetSampler(LLAMA_DEFAULT_SEED, m_temperature, m_topP);
+    m_modelPath = modelPath;
+    m_modelFingerprint.clear();
+
+    m_n_past = 0;
+    m_session_tokens.clear();
+    m_vocabKey = vocabularyKey();
+    emit vocabularyChanged(m_vocabKey);
+
+    // Bring back the open chat if it was parked on this model, otherwise
+    // rebuild it from the stored messages
+    if (!m_activeChatId.isEmpty() &&
+        m_stateCache->restore(m_activeChatId, ctx, 0, m_session_tokens, m_n_past)) {
+        qDebug() << "Restored context for chat" << m_activeChatId << "-" << m_n_past << "tokens";
+    }
+
+    emit contextChanged(m_contextSize);
+    emit stateCacheChanged(m_stateCache->memoryBytes(), m_stateCache->diskBytes());
+    emitResidentModels();
+    emitLoraAdapters();
+    emit modelLoadedSuccessfully();
+}
+
+llama_model *LlamaWorker::loadModelFile(const QString &modelPath)
+{
+    llama_model_params model_params = llama_model_default_params();
+
+    qDebug() << "=== Model Loading Configuration ===";
+    qDebug() << "GPU offload support:" << llama_supports_gpu_offload();
+
+    if (llama_supports_gpu_offload()) {
+        model_params.n_gpu_layers = 999;
+        model_params.main_gpu = 0;
+        model_params.split_mode = LLAMA_SPLIT_MODE_NONE;
+        qDebug() << "GPU offload ENABLED, requesting" << model_params.n_gpu_layers << "layers";
+    } else {
+        qDebug() << "WARNING: GPU offload NOT supported!";
+        model_params.n_gpu_layers = 0;
+    }
+
+    model_params.use_mmap = true;
+    model_params.use_mlock = false;
+
+    qDebug() << "Loading model from:" << modelPath;
+    llama_model *loaded = llama_model_load_from_file(modelPath.toUtf8().constData(), model_params);
+
+    if (!loaded) {
+        emit errorOccurred("Failed to load model");
+        return nullptr;
+    }
+
+    qDebug() << "=== Model Loaded ===";
+    qDebug() << "Requested GPU layers:" << model_params.n_gpu_layers;
+    qDebug() << "Model total layers:" << llama_model_n_layer(loaded);
+    qDebug() << "Model size:" << (llama_model_size(loaded) / (1024.0 * 1024.0 * 1024.0)) << "GB";
+    qDebug() << "GPU layers offloaded:" << model_params.n_gpu_layers;
+
+    return loaded;
+}
+
+ResidentModel LlamaWorker::detachActiveModel()
+{
+    ResidentModel entry;
+    if (!model) {
+        return entry;
+    }
+
+    if (ctx && !m_activeChatId.isEmpty() && m_n_past > 0) {
+        m_stateCache->store(m_activeChatId, ctx, 0, m_session_tokens, m_n_past);
+    }
+
+    // The context (KV cache, compute buffers) is rebuilt on activation;
+    // only the weights and the parked states stay
+    if (sampler) {
+        llama_sampler_free(sampler);
+        sampler = nullptr;
+    }
+    if (ctx) {
+        llama_free(ctx);
+        ctx = nullptr;
+        m_threadpoolCtx = nullptr;
+    }
+
+    entry.path = m_modelPath;
+    entry.model = model;
+    entry.states = m_stateCache;
+    entry.adapters = m_adapters;
+    entry.sizeBytes = static_cast<qint64>(llama_model_size(model));
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+    model = nullptr;
+    vocab = nullptr;
+    m_stateCache = nullptr;
+    m_adapters.clear();
+    m_n_past = 0;
+    m_session_tokens.clear();
+    m_modelPath.clear();
+    m_modelFingerprint.clear();
+    return entry;
+}
+
+void LlamaWorker::keepResident(const ResidentModel &entry)
+{
+    if (m_maxResidentModels > 1) {
+        m_residentModels.prepend(entry);
+        qDebug() << "Model kept resident:" << entry.path;
+    } else {
+        llama_model_free(entry.model);
+        delete entry.states;
+    }
+}
+
+void LlamaWorker::reattachModel(const ResidentModel &entry, int nCtx)
+{
+    model = entry.model;
+    vocab = llama_model_get_vocab(model);
+    m_stateCache = entry.states;
+    m_adapters = entry.adapters;
+
+    auto selection = m_chatLora.value(m_activeChatId, qMakePair(QString(), 1.0f));
+    m_loraPath = selection.first;
+    m_loraScale = selection.second;
+
+    if (!createContext(nCtx) && !createContext(DEFAULT_CONTEXT_SIZE)) {
+        // Parked instead, so it can be picked again from the model list
+        qDebug() << "Failed to recreate the context of" << entry.path;
+        model = nullptr;
+        vocab = nullptr;
+        m_stateCache = nullptr;
+        m_adapters.clear();
+        m_residentModels.prepend(entry);
+        emitResidentModels();
+        return;
+    }
+
+    qDebug() << "Previous model kept active:" << entry.path;
+    activateContext(entry.path);
+}
+
+void LlamaWorker::trimResidentModels(int keep)
+{
+    while (m_residentModels.size() > std::max(keep, 0)) {
+        ResidentModel entry = m_residentModels.takeLast();
+        qDebug() << "Unloading resident model:" << entry.path;
+        llama_model_free(entry.model);
+        delete entry.states;
+    }
+}
+
+void LlamaWorker::emitResidentModels()
+{
+    QVariantList models;
+
+    auto describe = [](const QString &path, qint64 weights, const SequenceStateCache *states, bool active,
+                       qint64 lastUsed) {
+        QVariantMap entry;
+        entry["fileName"] = QFileInfo(path).fileName();
+        entry["fullPath"] = path;
+        entry["weightBytes"] = weights;
+        entry["stateBytes"] = states ? states->memoryBytes() : 0;
+        entry["footprintBytes"] = weights + (states ? states->memoryBytes() : 0);
+        entry["active"] = active;
+        entry["lastUsed"] = lastUsed;
+        return entry;
+    };
+
+    if (model) {
+        models.append(describe(m_modelPath, static_cast<qint64>(llama_model_size(model)), m_stateCache, true,
+                               QDateTime::currentMSecsSinceEpoch()));
+    }
+    qint64 weightBytes = model ? static_cast<qint64>(llama_model_size(model)) : 0;
+    for (const ResidentModel &entry : std::as_const(m_residentModels)) {
+        models.append(describe(entry.path, entry.sizeBytes, entry.states, false, entry.lastUsed));
+        weightBytes += entry.sizeBytes;
+    }
+
+    emit residentModelsChanged(models);
+    emit modelWeightsChanged(weightBytes);
+}
+
+void LlamaWorker::setActiveChat(const QString &chatId)
+{
+    TRACE_ZONE("llm", "setActiveChat");
+    if (chatId == m_activeChatId) {
+        emit contextReady();
+        return;
+    }
+
+    if (ctx) {
+        // Park the current conversation and bring back the new one if cached
+        if (!m_activeChatId.isEmpty() && m_n_past > 0) {
+            m_stateCache->store(m_activeChatId, ctx, 0, m_session_tokens, m_n_past);
+        }
+
+        llama_memory_clear(llama_get_memory(ctx), false);
+        m_n_past = 0;
+        m_session_tokens.clear();
+
+        if (m_stateCache->restore(chatId, ctx, 0, m_session_tokens, m_n_past)) {
+            qDebug() << "Restored context for chat" << chatId << "-" << m_n_past << "tokens";
+        }
+
+        emit stateCacheChanged(m_stateCache->memoryBytes(), m_stateCache->diskBytes());
+    }
+
+    m_activeChatId = chatId;
+    applyChatLora();
+    requestHistory();
+}
+
+void LlamaWorker::requestHistory()
+{
+    if (ctx && !m_activeChatId.isEmpty() && m_n_past == 0) {
+        emit historyNeeded(m_activeChatId, m_vocabKey);
+    } else {
+        emit contextReady();
+    }
+}
+
+void LlamaWorker::rebuildContext(const QString &chatId, const QList<HistoryTurn> &turns)
+{
+    TRACE_ZONE("llm", "rebuildContext");
+    // Stale, or the chat has moved on (a message went through) meanwhile
+    if (!ctx || !vocab || chatId != m_activeChatId || m_n_past > 0 || turns.isEmpty()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The live context holds each user turn with the assistant prompt after
+    // it, then the raw reply tokens; a rebuilt one is laid out the same way
+    QList<HistoryTurn> tokenized;
+    std::vector<std::vector<llama_token>> pieces(turns.size());
+    for (int i = 0; i < turns.size(); ++i) {
+        const HistoryTurn &turn = turns[i];
+        if (!turn.tokens.isEmpty()) {
+            pieces[i] = blobToTokens(turn.tokens);
+            continue;
+        }
+        pieces[i] = tokenize(turn.isUser ? userTurn(turn.text) : turn.text, false);
+        HistoryTurn cached;
+        cached.messageId = turn.messageId;
+        cached.isUser = turn.isUser;
+        cached.tokens = tokensToBlob(pieces[i]);
+        tokenized.append(cached);
+    }
+    if (!tokenized.isEmpty()) {
+        emit historyTokenized(m_vocabKey, tokenized);
+    }
+
+    // The newest complete exchanges within half the context; a trailing user
+    // message is unanswered or the one about to be sent
+    const std::vector<llama_token> system = tokenize(SYSTEM_PROMPT, true);
+    const int budget = m_contextSize / 2 - static_cast<int>(system.size());
+    int end = turns.size();
+    while (end > 0 && turns[end - 1].isUser) {
+        --end;
+    }
+    int begin = end;
+    int used = 0;
+    while (begin > 0 && used + static_cast<int>(pieces[begin - 1].size()) <= budget) {
+        used += static_cast<int>(pieces[begin - 1].size());
+        --begin;
+    }
+    while (begin < end && !turns[begin].isUser) {
+        ++begin;
+    }
+    if (begin >= end) {
+        return;
+    }
+
+    std::vector<llama_token> history = system;
+    for (int i = begin; i < end; ++i) {
+        history.insert(history.end(), pieces[i].begin(), pieces[i].end());
+    }
+
+    ensureThreadpools();
+    m_shouldStop.storeRelaxed(0);
+    if (!decodeTokens(history, 0, false)) {
+        llama_memory_clear(llama_get_memory(ctx), false);
+        return;
+    }
+
+    m_session_tokens = history;
+    m_n_past = static_cast<int>(history.size());
+    m_metrics.kvTokens->set(m_n_past);
+
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    qDebug() << "Rebuilt context for chat" << chatId << "from" << (end - begin) << "messages -"
+             << m_n_past << "tokens," << tokenized.size() << "tokenized, in" << elapsed << "ms";
+}
+
+bool LlamaWorker::attachLoraAdapter(const QString &path)
+{
+    for (const LoraAdapter &entry : std::as_const(m_adapters)) {
+        if (entry.path == path) {
+            return true;
+        }
+    }
+
+    // Only the adapter tensors are read; the base weights are shared
+    llama_adapter_lora *adapter = llama_adapter_lora_init(model, path.toUtf8().constData());
+    if (!adapter) {
+        emit errorOccurred("Failed to load LoRA adapter (does it match the loaded model?): "
+                           + QFileInfo(path).fileName());
+        return false;
+    }
+
+    LoraAdapter entry;
+    entry.path = path;
+    entry.name = QFileInfo(path).completeBaseName();
+    entry.adapter = adapter;
+    m_adapters.append(entry);
+    qDebug() << "LoRA adapter loaded:" << path;
+    return true;
+}
+
+void LlamaWorker::loadLoraAdapter(const QString &path)
+{
+    if (!model) {
+        emit errorOccurred("Load a base model before adding an adapter");
+        return;
+    }
+
+    if (attachLoraAdapter(path)) {
+        emitLoraAdapters();
+    }
+}
+
+void LlamaWorker::unloadLoraAdapter(const QString &path)
+{
+    for (int i = 0; i < m_adapters.size(); ++i) {
+        if (m_adapters[i].path != path) continue;
+
+        if (ctx) {
+            llama_rm_adapter_lora(ctx, m_adapters[i].adapter);
+        }
+        llama_adapter_lora_free(m_adapters[i].adapter);
+        m_adapters.removeAt(i);
+        qDebug() << "LoRA adapter unloaded:" << path;
+        break;
+    }
+
+    // Chats that used it fall back to the base model
+    for (auto it = m_chatLora.begin(); it != m_chatLora.end();) {
+        it = (it->first == path) ? m_chatLora.erase(it) : std::next(it);
+    }
+    if (m_loraPath == path) {
+        m_loraPath.clear();
+    }
+    emitLoraAdapters();
+}
+
+void LlamaWorker::selectLoraAdapter(const QString &path, float scale)
+{
+    if (!path.isEmpty() && (!model || !attachLoraAdapter(path))) {
+        return;
+    }
+
+    if (path.isEmpty()) {
+        m_chatLora.remove(m_activeChatId);
+    } else {
+        m_chatLora.insert(m_activeChatId, qMakePair(path, scale));
+    }
+    m_loraPath = path;
+    m_loraScale = scale;
+    applyLoraAdapter();
+    emitLoraAdapters();
+}
+
+void LlamaWorker::applyChatLora()
+{
+    auto selection = m_chatLora.value(m_activeChatId, qMakePair(QString(), 1.0f));
+    if (selection.first == m_loraPath && selection.second == m_loraScale) {
+        return;
+    }
+    m_loraPath = selection.first;
+    m_loraScale = selection.second;
+    applyLoraAdapter();
+    emitLoraAdapters();
+}
+
+void LlamaWorker::applyLoraAdapter()
+{
+    if (!ctx) {
+        return;
+    }
+
+    // Setting an adapter only swaps pointers in the graph; nothing is reloaded
+    llama_clear_adapter_lora(ctx);
+    for (const LoraAdapter &entry : std::as_const(m_adapters)) {
+        if (entry.path == m_loraPath && m_loraScale != 0.0f) {
+            llama_set_adapter_lora(ctx, entry.adapter, m_loraScale);
+            qDebug() << "LoRA adapter active:" << entry.name << "scale" << m_loraScale;
+            return;
+        }
+    }
+}
+
+void LlamaWorker::emitLoraAdapters()
+{
+    QVariantList adapters;
+    QString active;
+    for (const LoraAdapter &entry : std::as_const(m_adapters)) {
+        QVariantMap map;
+        map["name"] = entry.name;
+        map["fullPath"] = entry.path;
+        adapters.append(map);
+        if (entry.path == m_loraPath) {
+            active = entry.path;
+        }
+    }
+    emit loraAdaptersChanged(adapters, active, m_loraScale);
+}
+
+void LlamaWorker::relieveMemoryPressure(qint64 bytesToFree)
+{
+    qint64 freed = 0;
+    QString key;
+
+    // 1. Inactive models: spill their parked states, then unload the least
+    //    recently used ones. Their weights are file-backed, but GPU copies
+    //    and parked states are not
+    for (ResidentModel &entry : m_residentModels) {
+        while (freed < bytesToFree) {
+            qint64 bytes = entry.states->spillOldest(&key);
+            if (bytes <= 0) break;
+            freed += bytes;
+            emit stateEvicted(key, "spilled", bytes);
+        }
+    }
+    while (freed < bytesToFree && !m_residentModels.isEmpty()) {
+        const ResidentModel &oldest = m_residentModels.last();
+        qint64 bytes = oldest.sizeBytes + oldest.states->memoryBytes();
+        QString name = QFileInfo(oldest.path).fileName();
+        trimResidentModels(m_residentModels.size() - 1);
+        freed += bytes;
+        emit stateEvicted(name, "model-unloaded", bytes);
+    }
+    emitResidentModels();
+
+    if (!m_stateCache) {
+        return;
+    }
+
+    // 2. Move the active model's cached sequence states out of RAM
+    while (freed < bytesToFree) {
+        qint64 bytes = m_stateCache->spillOldest(&key);
+        if (bytes <= 0) break;
+        freed += bytes;
+        emit stateEvicted(key, "spilled", bytes);
+    }
+
+    // 3. Drop cached states entirely (spilled ones too, to cap disk use)
+    while (freed < bytesToFree) {
+        qint64 bytes = m_stateCache->dropOldest(&key);
+        if (bytes <= 0) break;
+        freed += bytes;
+        emit stateEvicted(key, "dropped", bytes);
+    }
+
+    emit stateCacheChanged(m_stateCache->memoryBytes(), m_stateCache->diskBytes());
+
+    // 4. Shrink the live context, halving the KV cache
+    if (freed < bytesToFree && ctx && m_contextSize / 2 >= MIN_CONTEXT_SIZE) {
+        resizeContext(m_contextSize / 2);
+    }
+}
+
+void LlamaWorker::restoreContext(qint64 headroom)
+{
+    if (!ctx || m_contextSize >= DEFAULT_CONTEXT_SIZE) {
+        return;
+    }
 
-    qDebug() << "=== llama.cpp system info ===";
-    qDebug() << llama_print_system_info();
-    qDebug() << "=== GPU Support Check ===";
-    qDebug() << "GPU offload supported:" << llama_supports_gpu_offload();
-    qDebug() << "MMAP supported:" << llama_supports_mmap();
-    qDebug() << "MLOCK supported:" << llama_supports_mlock();
+    // Double back towards the configured size while the larger KV cache
+    // fits twice into the headroom, so the next sample doesn't shrink it again
+    int nCtx = qMin(m_contextSize * 2, DEFAULT_CONTEXT_SIZE);
+    qint64 growth = static_cast<qint64>(nCtx - m_contextSize) * kvBytesPerToken();
+    if (growth * 2 > headroom) {
+        return;
+    }
+    resizeContext(nCtx);
 }
 
-LlamaWorker::~LlamaWorker()
+qint64 LlamaWorker::kvBytesPerToken() const
 {
-    if (sampler) llama_sampler_free(sampler);
-    if (ctx) llama_free(ctx);
-    if (model) llama_model_free(model);
-    llama_backend_free();
+    // F16 K and V rows per layer; heads are shared under GQA
+    qint64 nHead = qMax(llama_model_n_head(model), 1);
+    qint64 nEmbdKv = static_cast<qint64>(llama_model_n_embd(model)) * llama_model_n_head_kv(model) / nHead;
+    return 2 * static_cast<qint64>(llama_model_n_layer(model)) * nEmbdKv * 2;
 }
 
-void LlamaWorker::unloadModel()
+void LlamaWorker::resizeContext(int nCtx)
 {
-    qDebug() << "=== LlamaWorker::unloadModel ===";
-
-    if (sampler) {
-        llama_sampler_free(sampler);
-        sampler = nullptr;
+    qint64 rssBefore = ProcFs::processRss();
+    size_t stateSize = 0;
+    QByteArray state;
+
+    // Keep the active conversation if it still fits
+    if (m_n_past > 0 && m_n_past < nCtx) {
+        state.resize(static_cast<qsizetype>(llama_state_seq_get_size(ctx, 0)));
+        stateSize = llama_state_seq_get_data(ctx, reinterpret_cast<uint8_t *>(state.data()), state.size(), 0);
     }
-    if (ctx) {
-        llama_free(ctx);
-        ctx = nullptr;
+
+    int oldSize = m_contextSize;
+    llama_free(ctx);
+    ctx = nullptr;
+    m_threadpoolCtx = nullptr;
+
+    if (!createContext(nCtx)) {
+        qDebug() << "Failed to create context of" << nCtx << "tokens, restoring" << oldSize;
+        if (!createContext(oldSize)) {
+            emit errorOccurred("Failed to recreate context");
+            return;
+        }
     }
-    if (model) {
-        llama_model_free(model);
-        model = nullptr;
+
+    if (stateSize > 0 &&
+        llama_state_seq_set_data(ctx, reinterpret_cast<const uint8_t *>(state.constData()), stateSize, 0) > 0) {
+        qDebug() << "Active conversation kept after context shrink";
+    } else {
+        m_n_past = 0;
+        m_session_tokens.clear();
     }
 
-    vocab = nullptr;
-    m_n_past = 0;
-    m_session_tokens.clear();
+    qint64 rssAfter = ProcFs::processRss();
+    qint64 freed = (rssBefore > 0 && rssAfter > 0) ? qMax<qint64>(rssBefore - rssAfter, 0) : 0;
 
-    qDebug() << "Model unloaded successfully";
+    qDebug() << "Context resized from" << oldSize << "to" << m_contextSize << "tokens";
+    emit contextChanged(m_contextSize);
+    if (m_contextSize < oldSize) {
+        emit stateEvicted(m_activeChatId, "context-shrunk", freed);
+    }
 }
 
-bool LlamaWorker::initialize(const QString &modelPath)
+void LlamaWorker::resetSampler(quint32 seed, float temperature, float topP)
 {
-    // Clean up previous resources if any
     if (sampler) {
         llama_sampler_free(sampler);
-        sampler = nullptr;
     }
-    if (ctx) {
-        llama_free(ctx);
-        ctx = nullptr;
+    sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(sampler, llama_sampler_init_temp(temperature));
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(topP, 1));
+    llama_sampler_chain_add(sampler, llama_sampler_init_dist(seed));
+    m_seed = seed;
+}
+
+void LlamaWorker::setRecording(bool enabled)
+{
+    if (enabled == (m_recorder != nullptr)) {
+        return;
     }
-    if (model) {
-        llama_model_free(model);
-        model = nullptr;
+
+    delete m_recorder;
+    m_recorder = nullptr;
+
+    if (enabled) {
+        QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                       + "/recordings/requests-" + QDateTime::currentDateTime().toString("yyyyMMdd") + ".jsonl";
+        m_recorder = new RequestRecorder(path);
+        qDebug() << "Recording requests to" << path;
     }
+}
 
-    if (!QFile::exists(modelPath)) {
-        emit errorOccurred("Model file not found: " + modelPath);
-        return false;
+void LlamaWorker::fillRecordContext(RequestRecord &record)
+{
+    if (m_modelFingerprint.isEmpty()) {
+        m_modelFingerprint = RequestRecorder::modelFingerprint(m_modelPath);
     }
 
-    llama_model_params model_params = llama_model_default_params();
+    record.timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    record.modelPath = m_modelPath;
+    record.modelSize = QFileInfo(m_modelPath).size();
+    record.modelFingerprint = m_modelFingerprint;
+    for (const LoraAdapter &entry : std::as_const(m_adapters)) {
+        if (entry.path == m_loraPath && m_loraScale != 0.0f) {
+            record.loraPath = entry.path;
+            record.loraScale = m_loraScale;
+        }
+    }
+    record.backend = m_backendName + " " + m_cpuIsa;
+    record.systemInfo = QString::fromUtf8(llama_print_system_info());
+    record.nCtx = static_cast<int>(llama_n_ctx(ctx));
+    record.nBatch = static_cast<int>(llama_n_batch(ctx));
+    record.nUbatch = static_cast<int>(llama_n_ubatch(ctx));
+    record.nThreads = llama_n_threads(ctx);
+    record.nThreadsBatch = llama_n_threads_batch(ctx);
+    record.flashAttention = true;
+    record.temperature = m_temperature;
+    record.topP = m_topP;
+    record.seed = m_seed;
+}
 
-    qDebug() << "=== Model Loading Configuration ===";
-    qDebug() << "GPU offload support:" << llama_supports_gpu_offload();
+bool LlamaWorker::decodeTokens(const std::vector<llama_token> &tokens, int startPos, bool logitsLast)
+{
+    const int nBatch = static_cast<int>(llama_n_batch(ctx));
+    const int total = static_cast<int>(tokens.size());
+
+    for (int offset = 0; offset < total; offset += nBatch) {
+        int n = std::min(nBatch, total - offset);
+        llama_batch batch = llama_batch_init(n, 0, 1);
+        for (int i = 0; i < n; i++) {
+            batch.token[i] = tokens[offset + i];
+            batch.pos[i] = startPos + offset + i;
+            batch.n_seq_id[i] = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i] = (logitsLast && offset + i == total - 1) ? 1 : 0;
+        }
+        batch.n_tokens = n;
 
-    if (llama_supports_gpu_offload()) {
-        model_params.n_gpu_layers = 999;
-        model_params.main_gpu = 0;
-        model_params.split_mode = LLAMA_SPLIT_MODE_NONE;
-        qDebug() << "GPU offload ENABLED, requesting" << model_params.n_gpu_layers << "layers";
-    } else {
-        qDebug() << "WARNING: GPU offload NOT supported!";
-        model_params.n_gpu_layers = 0;
+        int result = llama_decode(ctx, batch);
+        llama_batch_free(batch);
+        if (result != 0) {
+            qDebug() << "Batch decode failed with code" << result;
+            return false;
+        }
     }
+    return true;
+}
 
-    model_params.use_mmap = true;
-    model_params.use_mlock = false;
-
-    qDebug() << "Loading model from:" << modelPath;
-    model = llama_model_load_from_file(modelPath.toUtf8().constData(), model_params);
+std::vector<llama_token> LlamaWorker::tokenize(const QString &text, bool addSpecial)
+{
+    const std::string str = text.toStdString();
+    std::vector<llama_token> tokens(str.size() + 16);
+    int n = llama_tokenize(vocab, str.c_str(), static_cast<int32_t>(str.size()), tokens.data(),
+                           static_cast<int32_t>(tokens.size()), addSpecial, true);
+    if (n < 0) {
+        tokens.resize(-n);
+        n = llama_tokenize(vocab, str.c_str(), static_cast<int32_t>(str.size()), tokens.data(),
+                           static_cast<int32_t>(tokens.size()), addSpecial, true);
+    }
+    tokens.resize(std::max(n, 0));
+    return tokens;
+}
 
-    if (!model) {
-        emit errorOccurred("Failed to load model");
-        return false;
+// Identifies what cached token ids are valid for: every token's text and
+// attributes, the special tokens, and the turn format they were built with.
+// Models sharing a tokenizer share the key, and so the cache
+QString LlamaWorker::vocabularyKey() const
+{
+    TRACE_ZONE("llm", "vocabularyKey");
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    const int32_t nTokens = llama_vocab_n_tokens(vocab);
+    for (llama_token token = 0; token < nTokens; ++token) {
+        const char *text = llama_vocab_get_text(vocab, token);
+        hash.addData(QByteArrayView(text, qstrlen(text) + 1));
+        const int32_t attr = llama_vocab_get_attr(vocab, token);
+        hash.addData(QByteArrayView(reinterpret_cast<const char *>(&attr), sizeof(attr)));
     }
 
-    qDebug() << "=== Model Loaded ===";
-    qDebug() << "Requested GPU layers:" << model_params.n_gpu_layers;
-    qDebug() << "Model total layers:" << llama_model_n_layer(model);
-    qDebug() << "Model size:" << (llama_model_size(model) / (1024.0 * 1024.0 * 1024.0)) << "GB";
+    const int32_t special[] = {
+        llama_vocab_type(vocab), llama_vocab_bos(vocab), llama_vocab_eos(vocab),
+        llama_vocab_get_add_bos(vocab), llama_vocab_get_add_eos(vocab),
+    };
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(special), sizeof(special)));
+    hash.addData((SYSTEM_PROMPT + userTurn(QString())).toUtf8());
 
-    vocab = llama_model_get_vocab(model);
+    return QString::fromLatin1(hash.result().toHex().left(16));
+}
 
-    if (!vocab) {
-        emit errorOccurred("Failed to get vocabulary");
-        llama_model_free(model);
-        model = nullptr;
+bool LlamaWorker::replayRequest(const RequestRecord &record, RequestRecord &result)
+{
+    if (!model || !ctx || !vocab || record.promptTokens.empty()) {
         return false;
     }
 
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 4096;
-    ctx_params.n_batch = 8192;
-    ctx_params.n_ubatch = 2048;
-    ctx_params.n_threads = 8;
-    ctx_params.n_threads_batch = 8;
-    ctx_params.offload_kqv = true;
-    ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
-    ctx_params.rope_scaling_type = LLAMA_ROPE_SCALING_TYPE_LINEAR;
-    ctx_params.yarn_ext_factor = -1.0f;
-    ctx_params.yarn_attn_factor = 1.0f;
-    ctx_params.yarn_beta_fast = 32.0f;
-    ctx_params.yarn_beta_slow = 1.0f;
+    if (!record.loraPath.isEmpty() && !attachLoraAdapter(record.loraPath)) {
+        return false;
+    }
+    m_loraPath = record.loraPath;
+    m_loraScale = record.loraScale;
+    applyLoraAdapter();
 
-    qDebug() << "=== Context Configuration ===";
-    qDebug() << "Context size:" << ctx_params.n_ctx;
-    qDebug() << "KQV offload:" << ctx_params.offload_kqv;
-    qDebug() << "Flash attention:" << (ctx_params.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_ENABLED ? "enabled" : "disabled");
+    if (record.nCtx > 0 && record.nCtx != m_contextSize) {
+        llama_free(ctx);
+        ctx = nullptr;
+        if (!createContext(record.nCtx)) {
+            return false;
+        }
+    }
+    ensureThreadpools();
 
-    ctx = llama_init_from_model(model, ctx_params);
+    llama_memory_clear(llama_get_memory(ctx), true);
+    m_n_past = 0;
+    m_session_tokens.clear();
+    m_shouldStop.storeRelaxed(0);
+    resetSampler(record.seed, record.temperature, record.topP);
 
-    if (!ctx) {
-        emit errorOccurred("Failed to create context");
-        llama_model_free(model);
-        model = nullptr;
-        vocab = nullptr;
+    result = RequestRecord();
+    fillRecordContext(result);
+    result.temperature = record.temperature;
+    result.topP = record.topP;
+    result.contextTokens = record.contextTokens;
+    result.promptTokens = record.promptTokens;
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+
+    // History is prefilled in one pass; only the new prompt is timed
+    const int historySize = static_cast<int>(record.contextTokens.size());
+    if (!decodeTokens(record.contextTokens, 0, false)) {
         return false;
     }
+    auto prefillStart = clock::now();
+    if (!decodeTokens(record.promptTokens, historySize, true)) {
+        return false;
+    }
+    auto prefillEnd = clock::now();
 
-    sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
-    llama_sampler_chain_add(sampler, llama_sampler_init_temp(0.7f));
-    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(0.9f, 1));
-    llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    int pos = historySize + static_cast<int>(record.promptTokens.size());
+    const size_t maxTokens = record.outputTokens.empty() ? 4096 : record.outputTokens.size();
 
-    qDebug() << "Model loaded successfully!";
-    qDebug() << "GPU layers offloaded:" << model_params.n_gpu_layers;
-    qDebug() << "Model total layers:" << llama_model_n_layer(model);
+    llama_batch gen_batch = llama_batch_init(1, 0, 1);
+    gen_batch.n_seq_id[0] = 1;
+    gen_batch.seq_id[0][0] = 0;
+    gen_batch.logits[0] = 1;
+    gen_batch.n_tokens = 1;
 
-    m_n_past = 0;
-    m_session_tokens.clear();
+    while (result.outputTokens.size() < maxTokens && pos < m_contextSize) {
+        llama_token token = llama_sampler_sample(sampler, ctx, -1);
+        if (token < 0 || llama_vocab_is_eog(vocab, token)) {
+            break;
+        }
+        result.outputTokens.push_back(token);
+        if (result.outputTokens.size() == 1) {
+            result.ttftMs = std::chrono::duration<double, std::milli>(clock::now() - prefillStart).count();
+        }
 
-    emit modelLoadedSuccessfully();
+        gen_batch.token[0] = token;
+        gen_batch.pos[0] = pos;
+        if (llama_decode(ctx, gen_batch) != 0) {
+            break;
+        }
+        pos++;
+    }
+    llama_batch_free(gen_batch);
 
+    auto end = clock::now();
+    result.prefillMs = std::chrono::duration<double, std::milli>(prefillEnd - prefillStart).count();
+    result.decodeMs = std::chrono::duration<double, std::milli>(end - prefillEnd).count();
+    result.totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+    m_n_past = pos;
     return true;
 }
 
-void LlamaWorker::processMessage(const QString &message)
+void LlamaWorker::emitPerf()
+{
+    llama_perf_context_data perf = llama_perf_context(ctx);
+    emit perfUpdated(perf.n_p_eval, perf.n_eval, perf.t_eval_ms);
+}
+
+void LlamaWorker::processMessage(quint64 requestId, const QString &message)
 {
     qDebug() << "=== processMessage START ===";
+    TRACE_ZONE("llm", "processMessage");
+
+    m_metrics.queueDepth->add(-1);
+    m_metrics.requests->add();
+
+    // A stop flag left from an earlier request does not apply to this one.
+    // Cleared before the check: cancelRequests() raises the limit first
+    m_shouldStop.storeRelaxed(0);
+    if (requestId <= m_cancelUpTo.loadAcquire()) {
+        qDebug() << "Request" << requestId << "was stopped while queued";
+        m_metrics.requestsStopped->add();
+        emit generationStopped();
+        emit generationFinished(0, 0);
+        return;
+    }
 
     if (!model || !ctx || !vocab) {
         qDebug() << "ERROR: Model not loaded";
+        m_metrics.requestsFailed->add();
         emit errorOccurred("Model not loaded");
         return;
     }
 
-    m_shouldStop.storeRelaxed(0);
+    ensureThreadpools();
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    // Format prompt for new message
-    QString prompt;
-    if (m_n_past == 0) {
-        prompt = "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n"
-                 "<|im_start|>user\n" + message + "<|im_end|>\n"
-                             "<|im_start|>assistant\n";
-    } else {
-        prompt = "<|im_start|>user\n" + message + "<|im_end|>\n"
-                                                  "<|im_start|>assistant\n";
+    // Fresh seed per request so a recording can reproduce the sampling
+    resetSampler(QRandomGenerator::global()->generate(), m_temperature, m_topP);
+    const bool recording = m_recorder != nullptr;
+    RequestRecord record;
+    if (recording) {
+        fillRecordContext(record);
+        record.contextTokens = m_session_tokens;
     }
 
-    std::string prompt_str = prompt.toStdString();
-    qDebug() << "Prompt length:" << prompt_str.length();
     qDebug() << "Tokens in context (n_past):" << m_n_past;
 
-    // Tokenize new prompt
-    std::vector<llama_token> tokens(prompt_str.size() + 128);
-    int n_tokens = llama_tokenize(
-        vocab,
-        prompt_str.c_str(),
-        prompt_str.length(),
-        tokens.data(),
-        tokens.size(),
-        m_n_past == 0,
-        true
-        );
-
-    if (n_tokens < 0) {
-        qDebug() << "Resizing tokens buffer to" << -n_tokens;
-        tokens.resize(-n_tokens);
-        n_tokens = llama_tokenize(vocab, prompt_str.c_str(), prompt_str.length(),
-                                  tokens.data(), tokens.size(), m_n_past == 0, true);
-    }
-
-    if (n_tokens <= 0) {
-        qDebug() << "ERROR: Tokenization failed, n_tokens =" << n_tokens;
+    // Tokenize new prompt. The user turn is tokenized on its own, so its ids
+    // can be cached for the message and reused when the context is rebuilt
+    std::vector<llama_token> tokens;
+    std::vector<llama_token> turnTokens;
+    {
+        TRACE_ZONE("llm", "tokenize");
+        if (m_n_past == 0) {
+            tokens = tokenize(SYSTEM_PROMPT, true);
+        }
+        turnTokens = tokenize(userTurn(message), false);
+    }
+
+    if (turnTokens.empty()) {
+        qDebug() << "ERROR: Tokenization failed";
+        m_metrics.requestsFailed->add();
         emit errorOccurred("Failed to tokenize");
         return;
     }
 
-    tokens.resize(n_tokens);
+    tokens.insert(tokens.end(), turnTokens.begin(), turnTokens.end());
+    const int n_tokens = static_cast<int>(tokens.size());
     qDebug() << "Tokenized successfully, n_tokens:" << n_tokens;
 
     m_session_tokens.insert(m_session_tokens.end(), tokens.begin(), tokens.end());
+    if (recording) {
+        record.promptTokens = tokens;
+    }
 
     // Create batch for entire prompt
     llama_batch batch = llama_batch_init(n_tokens, 0, 1);
@@ -240,19 +1390,54 @@ void LlamaWorker::processMessage(const QString &message)
     batch.n_tokens = n_tokens;
 
     qDebug() << "Decoding prompt...";
-    int decode_result = llama_decode(ctx, batch);
+    auto prefill_start = std::chrono::high_resolution_clock::now();
+    int decode_result = 0;
+    {
+        TRACE_ZONE("llm", "prefill");
+        decode_result = llama_decode(ctx, batch);
+    }
+    auto prefill_end = std::chrono::high_resolution_clock::now();
     qDebug() << "Decode result:" << decode_result;
 
     llama_batch_free(batch);
 
+    if (decode_result == 2 || m_shouldStop.loadRelaxed() == 1) {
+        // Aborted during prefill: drop the partially decoded prompt
+        qDebug() << "Prompt decode aborted";
+        llama_memory_seq_rm(llama_get_memory(ctx), 0, m_n_past, -1);
+        m_session_tokens.resize(m_session_tokens.size() - n_tokens);
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            end_time - start_time);
+
+        m_metrics.requestsStopped->add();
+        recordRequestMetrics(0, duration.count() / 1000.0, 0.0);
+        emit generationStopped();
+        emit generationFinished(0, duration.count());
+        emit messageReceived("Generation stopped");
+        return;
+    }
+
     if (decode_result != 0) {
         qDebug() << "ERROR: Failed to decode prompt, code:" << decode_result;
+        m_metrics.requestsFailed->add();
         emit errorOccurred("Failed to decode prompt, code: " + QString::number(decode_result));
         return;
     }
 
     m_n_past += n_tokens;
     qDebug() << "Prompt decoded successfully, n_past now:" << m_n_past;
+    emit turnTokenized(m_activeChatId, true, m_vocabKey, tokensToBlob(turnTokens));
+
+    double prefillSec = std::chrono::duration<double>(prefill_end - prefill_start).count();
+    m_metrics.promptTokens->add(n_tokens);
+    m_metrics.prefillSeconds->observe(prefillSec);
+    if (prefillSec > 0.0) {
+        m_metrics.prefillRate->set(n_tokens / prefillSec);
+    }
+    m_metrics.kvTokens->set(m_n_past);
+    emitPerf();
     emit generationStarted();
 
     QString response;
@@ -288,25 +1473,49 @@ void LlamaWorker::processMessage(const QString &message)
                                     response_tokens.begin(),
                                     response_tokens.end());
             m_n_past += n_gen;
+            if (!response_tokens.empty()) {
+                emit turnTokenized(m_activeChatId, false, m_vocabKey, tokensToBlob(response_tokens));
+            }
 
             auto end_time = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
                 end_time - start_time);
 
             llama_batch_free(gen_batch);
+            m_metrics.requestsStopped->add();
+            recordRequestMetrics(n_gen, duration.count() / 1000.0,
+                                 std::chrono::duration<double>(end_time - prefill_end).count());
+            if (recording) {
+                record.outputTokens = response_tokens;
+                record.stopped = true;
+                record.prefillMs = std::chrono::duration<double, std::milli>(prefill_end - prefill_start).count();
+                record.decodeMs = std::chrono::duration<double, std::milli>(end_time - prefill_end).count();
+                record.totalMs = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+                m_recorder->append(record);
+            }
+            emitPerf();
             emit generationStopped();
             emit generationFinished(n_gen, duration.count());
             emit messageReceived(response.isEmpty() ? "Generation stopped" : response);
             return;
         }
 
-        llama_token new_token = llama_sampler_sample(sampler, ctx, -1);
+        llama_token new_token;
+        {
+            TRACE_ZONE("llm", "sample");
+            new_token = llama_sampler_sample(sampler, ctx, -1);
+        }
 
         if (new_token < 0 || llama_vocab_is_eog(vocab, new_token)) {
             break;
         }
 
         response_tokens.push_back(new_token);
+        if (response_tokens.size() == 1) {
+            auto firstTokenTime = std::chrono::high_resolution_clock::now();
+            m_metrics.timeToFirstToken->observe(std::chrono::duration<double>(firstTokenTime - start_time).count());
+            record.ttftMs = std::chrono::duration<double, std::milli>(firstTokenTime - prefill_start).count();
+        }
 
         // Track think blocks
         std::string_view currentResponse(responseStr);
@@ -363,6 +1572,8 @@ void LlamaWorker::processMessage(const QString &message)
             }
 
             if (tokensInBuffer >= EMIT_BATCH_SIZE) {
+                Tracer::instant("llm", "emitTokens");
+                emitPerf();
                 emit tokenGenerated(tokenBuffer);
                 tokenBuffer.clear();
                 tokensInBuffer = 0;
@@ -372,7 +1583,19 @@ void LlamaWorker::processMessage(const QString &message)
         gen_batch.token[0] = new_token;
         gen_batch.pos[0] = m_n_past + n_gen;
 
-        int result = llama_decode(ctx, gen_batch);
+        int result = 0;
+        {
+            TRACE_ZONE("llm", "decode");
+            result = llama_decode(ctx, gen_batch);
+        }
+
+        if (result == 2 || (result != 0 && m_shouldStop.loadRelaxed() == 1)) {
+            // Aborted mid-decode: the token is shown but never entered the KV cache
+            llama_memory_seq_rm(llama_get_memory(ctx), 0, m_n_past + n_gen, -1);
+            response_tokens.pop_back();
+            m_shouldStop.storeRelaxed(1);
+            continue;
+        }
 
         if (result != 0) {
             qDebug() << "Decode failed at token" << n_gen << "with code" << result;
@@ -393,6 +1616,9 @@ void LlamaWorker::processMessage(const QString &message)
                             response_tokens.begin(),
                             response_tokens.end());
     m_n_past += n_gen;
+    if (!response_tokens.empty()) {
+        emit turnTokenized(m_activeChatId, false, m_vocabKey, tokensToBlob(response_tokens));
+    }
 
     response = QString::fromStdString(responseStr);
     response = response.remove("<|im_end|>").trimmed();
@@ -408,6 +1634,16 @@ void LlamaWorker::processMessage(const QString &message)
 
     qDebug() << "Response length:" << response.length();
     qDebug() << "Total tokens in context:" << m_n_past;
+    recordRequestMetrics(n_gen, duration.count() / 1000.0,
+                         std::chrono::duration<double>(end_time - prefill_end).count());
+    if (recording) {
+        record.outputTokens = response_tokens;
+        record.prefillMs = std::chrono::duration<double, std::milli>(prefill_end - prefill_start).count();
+        record.decodeMs = std::chrono::duration<double, std::milli>(end_time - prefill_end).count();
+        record.totalMs = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        m_recorder->append(record);
+    }
+    emitPerf();
     emit generationFinished(n_gen, duration.count());
     emit messageReceived(response);
     qDebug() << "=== processMessage FINISHED ===";
@@ -418,6 +1654,14 @@ void LlamaWorker::stopGeneration()
     m_shouldStop.storeRelaxed(1);
 }
 
+void LlamaWorker::cancelRequests(quint64 upToId)
+{
+    quint64 current = m_cancelUpTo.loadAcquire();
+    while (current < upToId && !m_cancelUpTo.testAndSetOrdered(current, upToId, current)) {
+    }
+    m_shouldStop.storeRelaxed(1);
+}
+
 void LlamaWorker::clearContext()
 {
     if (ctx) {
@@ -437,11 +1681,47 @@ LlamaConnector::LlamaConnector(QObject *parent)
     modelInfo = new ModelInfo(this);
 
     worker = new LlamaWorker();
+    modelInfo->setBackendInfo(worker->backendName(), worker->cpuIsa(), worker->cpuFeatures());
+
+    // Must happen before any other thread is started: threads created from
+    // the GUI thread (worker, database) inherit its affinity mask
+    CpuTopology topology = CpuTopology::detect();
+    QList<int> guiCpus = worker->configureThreading(topology, modelInfo->numaStrategy(),
+                                                    modelInfo->threadPriority());
+    if (!guiCpus.isEmpty()) {
+        CpuTopology::pinCurrentThread(guiCpus);
+    }
+    modelInfo->setThreadingInfo(topology.summary(), worker->threadPinning());
+    worker->setRecording(modelInfo->recordRequests());
     worker->moveToThread(&workerThread);
 
+    // Kernel thread names (comm, max 15 chars); the system sampler finds
+    // the inference threads by this name
+    workerThread.setObjectName("LlamaWorker");
+    monitorThread.setObjectName("Monitor");
+
     connect(&workerThread, &QThread::finished, worker, &QObject::deleteLater);
     connect(this, &LlamaConnector::requestProcessing, worker, &LlamaWorker::processMessage);
-    connect(worker, &LlamaWorker::errorOccurred, this, &LlamaConnector::errorOccurred);
+    connect(this, &LlamaConnector::requestModelLoad, worker, &LlamaWorker::loadModel);
+    connect(this, &LlamaConnector::requestChatSwitch, worker, &LlamaWorker::setActiveChat);
+    connect(this, &LlamaConnector::requestContextRebuild, worker, &LlamaWorker::rebuildContext);
+    connect(this, &LlamaConnector::requestLoraLoad, worker, &LlamaWorker::loadLoraAdapter);
+    connect(this, &LlamaConnector::requestLoraUnload, worker, &LlamaWorker::unloadLoraAdapter);
+    connect(this, &LlamaConnector::requestLoraSelect, worker, &LlamaWorker::selectLoraAdapter);
+    connect(modelInfo, &ModelInfo::recordRequestsChanged, worker, &LlamaWorker::setRecording);
+    connect(worker, &LlamaWorker::perfUpdated, modelInfo, &ModelInfo::updatePerf);
+    connect(worker, &LlamaWorker::contextChanged, modelInfo, &ModelInfo::setContextLength);
+    connect(worker, &LlamaWorker::stateCacheChanged, modelInfo, &ModelInfo::setStateCache);
+    connect(worker, &LlamaWorker::stateEvicted, modelInfo, &ModelInfo::recordEviction);
+    connect(worker, &LlamaWorker::residentModelsChanged, modelInfo, &ModelInfo::setResidentModels);
+    connect(worker, &LlamaWorker::loraAdaptersChanged, modelInfo, &ModelInfo::setLoraAdapters);
+    connect(worker, &LlamaWorker::errorOccurred, this, [this](const QString &error) {
+        if (m_isGenerating) {
+            m_isGenerating = false;
+            emit generatingChanged();
+        }
+        emit errorOccurred(error);
+    });
     connect(worker, &LlamaWorker::tokenGenerated, this, &LlamaConnector::tokenGenerated);
 
     connect(worker, &LlamaWorker::messageReceived, this, [this](const QString& response) {
@@ -467,11 +1747,122 @@ LlamaConnector::LlamaConnector(QObject *parent)
         emit generatingChanged();
     });
 
+    connect(worker, &LlamaWorker::modelLoadFinished, this, [this](bool success, const QString &modelPath) {
+        // The worker is idle again, so reading its pointers is safe here
+        if (success) {
+            qDebug() << "Model initialized, updating modelInfo...";
+            modelInfo->setModel(worker->model, worker->ctx, modelPath);
+        } else {
+            qDebug() << "Failed to initialize model";
+            // The previous model is still active; show it again
+            if (worker->model && worker->ctx) {
+                modelInfo->setModel(worker->model, worker->ctx, worker->modelPath());
+            }
+        }
+        emit modelLoadingFinished(success);
+    });
+
+    connect(worker, &LlamaWorker::modelUnloaded, this, [this]() {
+        m_isUnloading = false;
+        qDebug() << "Model unloaded successfully";
+        emit modelUnloaded();
+    });
+
+    // Token id cache: ids of other vocabularies are dropped as models change,
+    // beyond the ones of the models that may still be resident
+    connect(worker, &LlamaWorker::vocabularyChanged, this, [this](const QString &vocab) {
+        if (!m_storage) {
+            return;
+        }
+        m_storage->retainTokenVocabularies(vocab, m_tokenVocabularies).then(this, [](int dropped) {
+            if (dropped > 0) {
+                qDebug() << "Dropped" << dropped << "cached token rows of unused vocabularies";
+            }
+        });
+    });
+
+    // Each chat switch or model load is answered by exactly one of these
+    connect(worker, &LlamaWorker::contextReady, this, &LlamaConnector::releaseHistoryHold);
+    connect(worker, &LlamaWorker::historyNeeded, this, [this](const QString &chatId, const QString &vocab) {
+        if (!m_storage) {
+            releaseHistoryHold();
+            return;
+        }
+        m_storage->loadHistory(chatId, vocab, m_historyMessages)
+            .then(this, [this, chatId](const QList<HistoryTurn> &turns) {
+                emit requestContextRebuild(chatId, turns);
+                releaseHistoryHold();
+            });
+    });
+
+    connect(worker, &LlamaWorker::turnTokenized, this,
+            [this](const QString &chatId, bool isUser, const QString &vocab, const QByteArray &tokens) {
+        if (m_storage && !chatId.isEmpty()) {
+            m_storage->saveLatestTokens(chatId, isUser, vocab, tokens);
+        }
+    });
+
+    connect(worker, &LlamaWorker::historyTokenized, this, [this](const QString &vocab, const QList<HistoryTurn> &turns) {
+        if (m_storage) {
+            m_storage->saveTokens(vocab, turns);
+        }
+    });
+
     workerThread.start();
+
+    m_memoryGovernor = new MemoryGovernor();
+    m_memoryGovernor->setBudgetMB(modelInfo->memoryBudgetMB());
+    m_memoryGovernor->moveToThread(&monitorThread);
+
+    connect(&monitorThread, &QThread::started, m_memoryGovernor, &MemoryGovernor::start);
+    connect(&monitorThread, &QThread::finished, m_memoryGovernor, &QObject::deleteLater);
+    connect(modelInfo, &ModelInfo::memoryBudgetMBChanged, m_memoryGovernor, &MemoryGovernor::setBudgetMB);
+    connect(m_memoryGovernor, &MemoryGovernor::sampled, modelInfo, &ModelInfo::setMemoryUsage);
+    connect(m_memoryGovernor, &MemoryGovernor::pressure, worker, &LlamaWorker::relieveMemoryPressure);
+    connect(m_memoryGovernor, &MemoryGovernor::relieved, worker, &LlamaWorker::restoreContext);
+    connect(worker, &LlamaWorker::modelWeightsChanged, m_memoryGovernor, &MemoryGovernor::setModelBytes);
+
+    // Prometheus endpoint and JSON snapshot; bind a non-loopback address
+    // in the settings to let a central server scrape this machine
+    m_queueDepth = Metrics::instance().gauge("aichat_queue_depth", "Requests queued for the worker");
+    QSettings settings("YourCompany", "AIChatGUI");
+    QHostAddress metricsAddress(settings.value("metricsAddress", "127.0.0.1").toString());
+    quint16 metricsPort = static_cast<quint16>(settings.value("metricsPort", 9464).toUInt());
+    QString snapshotPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/metrics.json";
+    m_metricsExporter = new MetricsExporter(metricsAddress, metricsPort, snapshotPath,
+                                            settings.value("metricsSnapshotMs", 15000).toInt());
+    m_metricsExporter->moveToThread(&monitorThread);
+
+    connect(&monitorThread, &QThread::started, m_metricsExporter, &MetricsExporter::start);
+    connect(&monitorThread, &QThread::finished, m_metricsExporter, &QObject::deleteLater);
+
+    // Context rebuilds from stored history and their token id cache
+    m_historyMessages = qMax(settings.value("historyRebuildMessages", 200).toInt(), 1);
+    m_tokenVocabularies = std::clamp(settings.value("maxResidentModels", 2).toInt(), 1, 8);
+
+#ifndef _WIN32
+    // ggml pool threads are spawned from the worker and inherit its name
+    m_systemSampler = new SystemSampler(workerThread.objectName());
+    m_systemSampler->moveToThread(&monitorThread);
+
+    connect(&monitorThread, &QThread::started, m_systemSampler, &SystemSampler::start);
+    connect(&monitorThread, &QThread::finished, m_systemSampler, &QObject::deleteLater);
+    connect(m_systemSampler, &SystemSampler::cpuNameDetected, modelInfo, &ModelInfo::setCpuName);
+    connect(m_systemSampler, &SystemSampler::systemSampled, modelInfo, &ModelInfo::applySystemSample);
+    connect(m_systemSampler, &SystemSampler::inferenceThreadsSampled,
+            modelInfo, &ModelInfo::applyInferenceThreadSample);
+#endif
+
+    monitorThread.start();
 }
 
 LlamaConnector::~LlamaConnector()
 {
+    QMetaObject::invokeMethod(m_metricsExporter, &MetricsExporter::stop, Qt::BlockingQueuedConnection);
+    monitorThread.quit();
+    monitorThread.wait();
+
+    worker->stopGeneration();
     workerThread.quit();
     workerThread.wait();
 }
@@ -480,72 +1871,120 @@ void LlamaConnector::unloadModel()
 {
     qDebug() << "=== unloadModel called ===";
 
-    if (m_isGenerating) {
-        qDebug() << "Stopping generation before unloading...";
-        worker->stopGeneration();
-
-        int waitCount = 0;
-        while (m_isGenerating && waitCount < 50) {
-            QThread::msleep(100);
-            QCoreApplication::processEvents();
-            waitCount++;
-        }
+    if (m_isUnloading) {
+        return;
     }
+    m_isUnloading = true;
 
-    QMetaObject::invokeMethod(worker, &LlamaWorker::unloadModel, Qt::BlockingQueuedConnection);
+    // Aborts an in-flight decode through the abort callback and skips every
+    // request queued before the unload, so it runs within milliseconds
+    worker->cancelRequests(m_lastRequestId);
+    dropHeldMessages();
+
+    // Stop polling the context from the GUI thread before the worker frees it
     modelInfo->clearModel();
 
-    qDebug() << "Model unloaded successfully";
+    QMetaObject::invokeMethod(worker, &LlamaWorker::unloadModel, Qt::QueuedConnection);
 }
 
 void LlamaConnector::stopGeneration()
 {
+    // Covers the running request and every one queued so far
     if (worker) {
-        worker->stopGeneration();
+        worker->cancelRequests(m_lastRequestId);
     }
 }
 
 bool LlamaConnector::loadModel(const QString &modelPath)
 {
     qDebug() << "=== loadModel called with:" << modelPath;
+
+    if (!QFile::exists(modelPath)) {
+        emit errorOccurred("Model file not found: " + modelPath);
+        return false;
+    }
+
     emit modelLoadingStarted();
 
-    // Proper resource cleanup
-    if (m_isGenerating) {
-        qDebug() << "Stopping generation before loading new model...";
-        worker->stopGeneration();
+    // Requests queued for the old model don't hold up the switch; held ones
+    // are cancelled too and stop as soon as the worker sees them
+    worker->cancelRequests(m_lastRequestId);
+    modelInfo->clearModel();
 
-        int waitCount = 0;
-        while (m_isGenerating && waitCount < 50) {
-            QThread::msleep(100);
-            QCoreApplication::processEvents();
-            waitCount++;
-        }
-    }
+    // Result arrives through modelLoadingFinished
+    ++m_historyLoads;
+    emit requestModelLoad(modelPath);
+
+    return true;
+}
 
-    if (worker->model || worker->ctx) {
-        qDebug() << "Cleaning up previous model...";
-        modelInfo->clearModel();
-        QThread::msleep(300);
+void LlamaConnector::sendMessage(const QString &message)
+{
+    m_queueDepth->add(1);
+    // Generating from the moment the request is queued, so prefill can be stopped too
+    m_isGenerating = true;
+    emit generatingChanged();
+    const quint64 requestId = ++m_lastRequestId;
+    // Sent once the chat's context has been rebuilt, so it comes after the history
+    if (m_historyLoads > 0) {
+        m_heldMessages.append(qMakePair(requestId, message));
+        return;
     }
+    emit requestProcessing(requestId, message);
+}
 
-    bool success = worker->initialize(modelPath);
+void LlamaConnector::setActiveChat(const QString &chatId)
+{
+    // Messages sent from now on wait until the worker has the chat's context
+    ++m_historyLoads;
+    emit requestChatSwitch(chatId);
+}
 
-    if (success) {
-        qDebug() << "Model initialized, updating modelInfo...";
-        modelInfo->setModel(worker->model, worker->ctx, modelPath);
-    } else {
-        qDebug() << "Failed to initialize model";
+void LlamaConnector::dropHeldMessages()
+{
+    // Never reach the worker, so nothing else reports them as stopped
+    if (m_heldMessages.isEmpty()) {
+        return;
     }
+    m_queueDepth->add(-m_heldMessages.size());
+    m_heldMessages.clear();
+    m_isGenerating = false;
+    emit generatingChanged();
+}
 
-    emit modelLoadingFinished(success);
+void LlamaConnector::releaseHistoryHold()
+{
+    if (m_historyLoads > 0 && --m_historyLoads == 0) {
+        const auto held = std::exchange(m_heldMessages, {});
+        for (const auto &request : held) {
+            emit requestProcessing(request.first, request.second);
+        }
+    }
+}
 
-    return success;
+void LlamaConnector::setStorage(ChatStorage *storage)
+{
+    m_storage = storage;
 }
 
-void LlamaConnector::sendMessage(const QString &message)
+void LlamaConnector::loadLoraAdapter(const QString &path)
+{
+    if (!QFile::exists(path)) {
+        emit errorOccurred("Adapter file not found: " + path);
+        return;
+    }
+    emit requestLoraLoad(path);
+}
+
+void LlamaConnector::unloadLoraAdapter(const QString &path)
+{
+    emit requestLoraUnload(path);
+}
+
+void LlamaConnector::setLoraAdapter(const QString &path, float scale)
 {
-    emit requestProcessing(message);
+    // Queued behind any running request, so it applies from the next one
+    emit requestLoraSelect(path, scale);
 }
 
 void LlamaConnector::clearContext()
@@ -3,47 +3,228 @@
 
 #include <QObject>
 #include <QThread>
+#include <QPointer>
+#include <QAtomicInteger>
+#include <QStringList>
 #include <llama.h>
+#include "message.h"
 #include "modelinfo.h"
+#include "cputopology.h"
+#include "sequencestatecache.h"
+#include "memorygovernor.h"
+#include "systemsampler.h"
+#include "metrics.h"
+#include "metricsexporter.h"
+#include "requestrecorder.h"
+
+class ChatStorage;
+
+// LoRA adapter attached to a loaded model. llama.cpp frees adapters
+// together with their model
+struct LoraAdapter {
+    QString path;
+    QString name;
+    llama_adapter_lora *adapter = nullptr;
+};
+
+// A model kept loaded while another one is active. Weights are mmap-backed,
+// so the OS can page a cold model out; its parked chats keep their KV states
+struct ResidentModel {
+    QString path;
+    llama_model *model = nullptr;
+    SequenceStateCache *states = nullptr;
+    QList<LoraAdapter> adapters;
+    qint64 sizeBytes = 0;
+    qint64 lastUsed = 0;  // msecs since epoch
+};
 
 class LlamaWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit LlamaWorker(QObject *parent = nullptr);
+    // kvDir holds spilled KV states and is emptied here; empty = the app's
+    // cache folder, which only the GUI instance may use
+    explicit LlamaWorker(const QString &kvDir = QString(), QObject *parent = nullptr);
     ~LlamaWorker();
 
+    // On failure the previous model, if any, stays active
     bool initialize(const QString &modelPath);
     llama_model *model = nullptr;
+    QString modelPath() const { return m_modelPath; }
+
+    QString backendName() const { return m_backendName; }
+    QString cpuIsa() const { return m_cpuIsa; }
+    QString cpuFeatures() const { return m_cpuFeatures; }
+
+    // Runs llama_numa_init and plans inference CPUs. Returns the CPUs left
+    // for the GUI and database threads (empty = no pinning)
+    QList<int> configureThreading(const CpuTopology &topology, const QString &numaStrategy,
+                                  const QString &priority);
+    QString threadPinning() const { return m_threadPinning; }
     llama_context *ctx = nullptr;
 
+    // Re-runs a recorded request from an empty KV cache with its seed and
+    // sampler settings; fills result with the new output and timings
+    bool replayRequest(const RequestRecord &record, RequestRecord &result);
+
+    // Thread-safe: stops the running request and makes every queued one up
+    // to upToId return as soon as it is dequeued
+    void cancelRequests(quint64 upToId);
+
 public slots:
-    void processMessage(const QString &message);
+    void loadModel(const QString &modelPath);
+    // requestId increases per queued request, see cancelRequests()
+    void processMessage(quint64 requestId, const QString &message);
     void stopGeneration();
     void clearContext();
     void unloadModel();
+    void setActiveChat(const QString &chatId);
+    // Prefills the active chat's empty context from its stored messages,
+    // using the cached token ids where there are any
+    void rebuildContext(const QString &chatId, const QList<HistoryTurn> &turns);
+    void relieveMemoryPressure(qint64 bytesToFree);
+    // Grows a context shrunk under pressure back to its configured size
+    void restoreContext(qint64 headroom);
+    void setRecording(bool enabled);
+    // Adapters for the active model; selection is remembered per chat
+    void loadLoraAdapter(const QString &path);
+    void unloadLoraAdapter(const QString &path);
+    void selectLoraAdapter(const QString &path, float scale);
 
 signals:
     void messageReceived(const QString &response);
     void errorOccurred(const QString &error);
     void modelLoadedSuccessfully();
+    void modelLoadFinished(bool success, const QString &modelPath);
+    void modelUnloaded();
     void generationFinished(int tokens, double duration_ms);
     void generationStarted();
     void tokenGenerated(const QString &token);
     void generationStopped();
+    void perfUpdated(int promptTokens, int evalTokens, double evalMs);
+    void contextChanged(int nCtx);
+    void stateCacheChanged(qint64 memoryBytes, qint64 diskBytes);
+    void stateEvicted(const QString &chatId, const QString &action, qint64 bytes);
+    void residentModelsChanged(const QVariantList &models);
+    void modelWeightsChanged(qint64 bytes);  // active and resident models
+    void loraAdaptersChanged(const QVariantList &adapters, const QString &activePath, float scale);
+    // Token id cache. vocab identifies the vocabulary and turn format the
+    // ids belong to; tokens are native int32s
+    void vocabularyChanged(const QString &vocab);
+    void historyNeeded(const QString &chatId, const QString &vocab);
+    // After a chat switch or model load that needs no rebuild
+    void contextReady();
+    void turnTokenized(const QString &chatId, bool isUser, const QString &vocab, const QByteArray &tokens);
+    void historyTokenized(const QString &vocab, const QList<HistoryTurn> &turns);
 
 private:
+    static bool abortCallback(void *data);
+    void detectBackend();
+    bool createContext(int nCtx);
+    llama_model *loadModelFile(const QString &modelPath);
+    void activateContext(const QString &modelPath);
+    void resizeContext(int nCtx);
+    qint64 kvBytesPerToken() const;
+    void emitPerf();
+    void resetSampler(quint32 seed, float temperature, float topP);
+    bool decodeTokens(const std::vector<llama_token> &tokens, int startPos, bool logitsLast);
+    std::vector<llama_token> tokenize(const QString &text, bool addSpecial);
+    QString vocabularyKey() const;
+    void requestHistory();
+    void fillRecordContext(RequestRecord &record);
+    void registerMetrics();
+    void recordRequestMetrics(int nGen, double totalSec, double decodeSec);
+    void ensureThreadpools();
+    void freeThreadpools();
+    // Frees the active context and hands out its model with the chat parked
+    ResidentModel detachActiveModel();
+    void keepResident(const ResidentModel &entry);
+    // Makes a detached model active again after a failed switch
+    void reattachModel(const ResidentModel &entry, int nCtx);
+    void trimResidentModels(int keep);
+    void emitResidentModels();
+    bool attachLoraAdapter(const QString &path);
+    void applyChatLora();
+    void applyLoraAdapter();
+    void emitLoraAdapters();
 
     llama_sampler *sampler = nullptr;
     const llama_vocab *vocab = nullptr;
     QAtomicInt m_shouldStop;
+    QAtomicInteger<quint64> m_cancelUpTo = 0;
+
+    // Sampler settings; the seed is drawn per request so it can be recorded
+    float m_temperature = 0.7f;
+    float m_topP = 0.9f;
+    quint32 m_seed = LLAMA_DEFAULT_SEED;
+
+    // Request recording for replay (null = off)
+    RequestRecorder *m_recorder = nullptr;
+    QString m_modelPath;
+    QString m_modelFingerprint;
 
     int m_n_past = 0;  // number of tokens in context
     std::vector<llama_token> m_session_tokens;  // history of tokens
+    QString m_vocabKey;  // see vocabularyKey()
+
+    // Per-chat KV states; the live context holds m_activeChatId
+    static constexpr int DEFAULT_CONTEXT_SIZE = 4096;
+    static constexpr int MIN_CONTEXT_SIZE = 1024;
+    int m_contextSize = DEFAULT_CONTEXT_SIZE;
+    QString m_activeChatId;
+    SequenceStateCache *m_stateCache = nullptr;  // states of the active model, null when none
+    QString m_kvDir;
+
+    // Inactive loaded models, most recently used first. Together with the
+    // active one at most m_maxResidentModels stay loaded
+    QList<ResidentModel> m_residentModels;
+    int m_maxResidentModels = 2;
+
+    // Adapters on the active model and the one applied to the context.
+    // Switching adapters keeps the chat's KV cache as it is
+    QList<LoraAdapter> m_adapters;
+    QString m_loraPath;
+    float m_loraScale = 1.0f;
+    QHash<QString, QPair<QString, float>> m_chatLora;  // chat id -> adapter path, scale
 
     // To track think blocks
     std::chrono::high_resolution_clock::time_point m_thinkStartTime;
     bool m_inThinkBlock = false;
+
+    // Selected ggml backends
+    QString m_backendName;
+    QString m_cpuIsa;
+    QString m_cpuFeatures;
+
+    // Explicit threadpools (decode / prefill), pinned to m_inferenceCpus
+    QList<int> m_inferenceCpus;
+    QList<int> m_decodeCpus;
+    int m_decodeThreads = 8;
+    int m_batchThreads = 8;
+    bool m_pinThreads = false;
+    ggml_sched_priority m_threadPriority = GGML_SCHED_PRIO_NORMAL;
+    ggml_threadpool *m_threadpool = nullptr;
+    ggml_threadpool *m_threadpoolBatch = nullptr;
+    llama_context *m_threadpoolCtx = nullptr;
+    QString m_threadPinning;
+
+    // Registry handles, updated lock-free from this thread
+    struct {
+        MetricCounter *requests = nullptr;
+        MetricCounter *requestsFailed = nullptr;
+        MetricCounter *requestsStopped = nullptr;
+        MetricCounter *promptTokens = nullptr;
+        MetricCounter *generatedTokens = nullptr;
+        MetricGauge *queueDepth = nullptr;
+        MetricGauge *prefillRate = nullptr;
+        MetricGauge *decodeRate = nullptr;
+        MetricGauge *kvTokens = nullptr;
+        MetricGauge *contextSize = nullptr;
+        MetricGauge *stateCacheBytes = nullptr;
+        MetricHistogram *prefillSeconds = nullptr;
+        MetricHistogram *timeToFirstToken = nullptr;
+        MetricHistogram *requestSeconds = nullptr;
+    } m_metrics;
 };
 
 class LlamaConnector : public QObject
@@ -55,9 +236,12 @@ public:
     ~LlamaConnector();
 
     Q_INVOKABLE void sendMessage(const QString &message);
+    // Asynchronous: returns false only if the request was rejected,
+    // the result is reported through modelLoadingFinished
     Q_INVOKABLE bool loadModel(const QString &modelPath);
     Q_INVOKABLE void clearContext();
     Q_INVOKABLE QString getLastRawResponse() const { return m_lastRawResponse; }
+    // Asynchronous: completion is reported through modelUnloaded
     Q_INVOKABLE void unloadModel();
 
     ModelInfo* getModelInfo() const { return modelInfo; }
@@ -65,6 +249,18 @@ public:
     Q_INVOKABLE void stopGeneration();
     bool isGenerating() const { return m_isGenerating; }
 
+    // Parks the current conversation's KV state and restores the chat's own
+    Q_INVOKABLE void setActiveChat(const QString &chatId);
+
+    // Where chats without a cached KV state get their history from, and
+    // where the token ids of their messages are cached
+    void setStorage(ChatStorage *storage);
+
+    // LoRA adapters on the loaded model; an empty path selects the base model
+    Q_INVOKABLE void loadLoraAdapter(const QString &path);
+    Q_INVOKABLE void unloadLoraAdapter(const QString &path);
+    Q_INVOKABLE void setLoraAdapter(const QString &path, float scale);
+
 signals:
     void modelLoadingStarted();
     void modelLoadingFinished(bool success);
@@ -73,17 +269,44 @@ signals:
     void tokenGenerated(const QString &token);
     void generationFinished(int tokens, double duration_ms);
     void generatingChanged();
+    void modelUnloaded();
 
 private:
+    void releaseHistoryHold();
+    void dropHeldMessages();
+
     QThread workerThread;
     LlamaWorker *worker;
 
+    // Background sampling (memory governor, system metrics)
+    QThread monitorThread;
+    MemoryGovernor *m_memoryGovernor;
+    SystemSampler *m_systemSampler = nullptr;
+    MetricsExporter *m_metricsExporter = nullptr;
+    MetricGauge *m_queueDepth = nullptr;
+
     ModelInfo *modelInfo;
     bool m_isGenerating = false;
+    bool m_isUnloading = false;
     QString m_lastRawResponse;
+    quint64 m_lastRequestId = 0;
+
+    // Messages sent after a chat switch or model load wait until the worker
+    // has acknowledged it, and for the history rebuild if one was needed
+    QPointer<ChatStorage> m_storage;
+    int m_historyLoads = 0;  // switches and loads not yet acknowledged
+    QList<QPair<quint64, QString>> m_heldMessages;  // request id, message
+    int m_historyMessages = 200;   // newest messages read for a rebuild
+    int m_tokenVocabularies = 2;   // vocabularies whose token ids are kept
 
 signals:
-    void requestProcessing(const QString &message);
+    void requestProcessing(quint64 requestId, const QString &message);
+    void requestModelLoad(const QString &modelPath);
+    void requestChatSwitch(const QString &chatId);
+    void requestContextRebuild(const QString &chatId, const QList<HistoryTurn> &turns);
+    void requestLoraLoad(const QString &path);
+    void requestLoraUnload(const QString &path);
+    void requestLoraSelect(const QString &path, float scale);
 };
 
 #endif // LLAMACONNECTOR_H
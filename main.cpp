@@ -5,15 +5,27 @@
 #include <QIcon>
 #include <QtCore/QString>
 #include <QClipboard>
+#include <QQuickWindow>
+#include <memory>
 #include "llamaconnector.h"
 #include "chatmanager.h"
 #include "clipboardhelper.h"
 #include "syntaxhighlighter.h"
+#include "tracer.h"
+#include "replayrunner.h"
 
 using namespace Qt::StringLiterals;
 
 int main(int argc, char *argv[])
 {
+    // Headless regression replay: no window, no QML
+    if (ReplayRunner::isReplayInvocation(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("AI Chat Assistant");
+        app.setOrganizationName("DmytroVision");
+        return ReplayRunner::runFromCommandLine(app);
+    }
+
     QGuiApplication app(argc, argv);
 
     // Enable dark mode
@@ -29,6 +41,12 @@ int main(int argc, char *argv[])
     app.setApplicationName("AI Chat Assistant");
     app.setOrganizationName("DmytroVision");
 
+    // AICHAT_TRACE=1 records from startup; otherwise toggle in the settings
+    if (qEnvironmentVariableIntValue("AICHAT_TRACE") > 0) {
+        Tracer::setEnabled(true);
+    }
+    TraceController traceController;
+
     QQmlApplicationEngine engine;
 
     LlamaConnector connector;
@@ -41,7 +59,7 @@ int main(int argc, char *argv[])
     if (!autoLoadPath.isEmpty() && QFile::exists(autoLoadPath)) {
         qDebug() << "Auto-loading model from:" << autoLoadPath;
         if (connector.loadModel(autoLoadPath)) {
-            qDebug() << "Model auto-loaded successfully!";
+            qDebug() << "Model auto-load started";
         } else {
             qWarning() << "Failed to auto-load model";
         }
@@ -50,6 +68,8 @@ int main(int argc, char *argv[])
     }
 
     ChatManager chatManager;
+    // Chats without a cached KV state are rebuilt from their stored messages
+    connector.setStorage(chatManager.storage());
     ClipboardHelper clipboardHelper;
 
     // Register context properties
@@ -58,6 +78,7 @@ int main(int argc, char *argv[])
     engine.rootContext()->setContextProperty("chatManager", &chatManager);
     engine.rootContext()->setContextProperty("clipboardHelper", &clipboardHelper);
     engine.rootContext()->setContextProperty("clipboard", QGuiApplication::clipboard());
+    engine.rootContext()->setContextProperty("tracer", &traceController);
 
     qmlRegisterType<SyntaxHighlighter>("SyntaxHighlighter", 1, 0, "SyntaxHighlighter");
 
@@ -69,5 +90,36 @@ int main(int argc, char *argv[])
                      }, Qt::QueuedConnection);
 
     engine.load(url);
+
+    // Frame phases: the GUI thread polishes (layout) between animating and
+    // synchronizing, then the render thread syncs and renders
+    if (auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().value(0))) {
+        auto animatedAt = std::make_shared<std::atomic<qint64>>(0);
+        auto syncStart = std::make_shared<qint64>(0);
+        auto renderStart = std::make_shared<qint64>(0);
+
+        QObject::connect(window, &QQuickWindow::afterAnimating, window, [animatedAt]() {
+            animatedAt->store(Tracer::isEnabled() ? Tracer::nowNs() : 0);
+        }, Qt::DirectConnection);
+        QObject::connect(window, &QQuickWindow::beforeSynchronizing, window, [animatedAt, syncStart]() {
+            if (!Tracer::isEnabled()) return;
+            *syncStart = Tracer::nowNs();
+            qint64 animated = animatedAt->exchange(0);
+            if (animated > 0) {
+                Tracer::record("ui", "polish", animated, *syncStart);
+            }
+        }, Qt::DirectConnection);
+        QObject::connect(window, &QQuickWindow::afterSynchronizing, window, [syncStart]() {
+            if (*syncStart > 0) Tracer::record("ui", "sync", *syncStart, Tracer::nowNs());
+            *syncStart = 0;
+        }, Qt::DirectConnection);
+        QObject::connect(window, &QQuickWindow::beforeRendering, window, [renderStart]() {
+            *renderStart = Tracer::isEnabled() ? Tracer::nowNs() : 0;
+        }, Qt::DirectConnection);
+        QObject::connect(window, &QQuickWindow::afterRendering, window, [renderStart]() {
+            if (*renderStart > 0) Tracer::record("ui", "render", *renderStart, Tracer::nowNs());
+        }, Qt::DirectConnection);
+    }
+
     return app.exec();
 }
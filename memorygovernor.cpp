@@ -0,0 +1,102 @@
+#include "memorygovernor.h"
+#include "procfs.h"
+#include <QDebug>
+
+// Give the worker time to act on a request before asking again
+static const int PRESSURE_COOLDOWN_TICKS = 3;
+// Keep this much of the machine free even when under our own budget
+static const double MIN_AVAILABLE_FRACTION = 0.05;
+// Samples under budget before memory given up under pressure is taken back
+static const int RELIEVED_TICKS = 15;
+
+MemoryGovernor::MemoryGovernor(QObject *parent)
+    : QObject(parent)
+{
+    Metrics &registry = Metrics::instance();
+    m_usageGauge = registry.gauge("aichat_memory_usage_bytes", "Process RSS or cgroup charge");
+    m_budgetGauge = registry.gauge("aichat_memory_budget_bytes", "Memory budget enforced by the governor");
+    m_availableGauge = registry.gauge("aichat_memory_available_bytes", "System memory available");
+    m_modelGauge = registry.gauge("aichat_memory_model_bytes", "Loaded model weights, excluded from the budget");
+    m_pressureEvents = registry.counter("aichat_memory_pressure_events_total", "Times the governor asked to free memory");
+}
+
+void MemoryGovernor::start()
+{
+    // Created here so the timer lives on the monitor thread
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        m_timer->setInterval(2000);
+        connect(m_timer, &QTimer::timeout, this, &MemoryGovernor::sample);
+    }
+    m_timer->start();
+    sample();
+}
+
+void MemoryGovernor::stop()
+{
+    if (m_timer) {
+        m_timer->stop();
+    }
+}
+
+void MemoryGovernor::sample()
+{
+    ProcFs::MemInfo mem;
+    if (!ProcFs::readMemInfo(mem)) {
+        return;
+    }
+
+    qint64 cgroupLimit = ProcFs::cgroupMemoryLimit();
+    qint64 usage = cgroupLimit > 0 ? ProcFs::cgroupMemoryUsage() : ProcFs::processRss();
+    if (usage < 0) {
+        usage = ProcFs::processRss();
+    }
+
+    qint64 budget = m_budgetMB * 1024 * 1024;
+    if (budget <= 0) {
+        qint64 ceiling = mem.totalBytes;
+        if (cgroupLimit > 0 && cgroupLimit < ceiling) {
+            ceiling = cgroupLimit;
+        }
+        budget = static_cast<qint64>(ceiling * 0.85);
+    }
+
+    m_usageGauge->set(usage);
+    m_budgetGauge->set(budget);
+    m_availableGauge->set(mem.availableBytes);
+    m_modelGauge->set(m_modelBytes);
+    emit sampled(budget, usage, mem.availableBytes);
+
+    if (m_cooldown > 0) {
+        --m_cooldown;
+        return;
+    }
+
+    // Only what the worker can free (KV caches, parked states) is governed;
+    // real shortage of the machine still shows in the available memory
+    qint64 governed = qMax<qint64>(usage - m_modelBytes, 0);
+    qint64 over = governed - budget;
+    qint64 minAvailable = static_cast<qint64>(mem.totalBytes * MIN_AVAILABLE_FRACTION);
+    if (mem.availableBytes >= 0 && mem.availableBytes < minAvailable) {
+        over = qMax(over, minAvailable - mem.availableBytes);
+    }
+
+    if (over <= 0) {
+        if (++m_calmTicks >= RELIEVED_TICKS) {
+            m_calmTicks = 0;
+            qint64 headroom = -over;
+            if (mem.availableBytes >= 0) {
+                headroom = qMin(headroom, mem.availableBytes - minAvailable);
+            }
+            emit relieved(headroom);
+        }
+        return;
+    }
+    m_calmTicks = 0;
+
+    qDebug() << "Memory pressure: usage" << governed / (1024 * 1024) << "MB without model weights, budget"
+             << budget / (1024 * 1024) << "MB, need to free" << over / (1024 * 1024) << "MB";
+    m_cooldown = PRESSURE_COOLDOWN_TICKS;
+    m_pressureEvents->add();
+    emit pressure(over);
+}
@@ -0,0 +1,47 @@
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <QObject>
+#include <QTimer>
+#include "metrics.h"
+
+// Samples system/cgroup memory and process RSS on the monitor thread and
+// asks the worker to free cached inference state when over budget
+class MemoryGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MemoryGovernor(QObject *parent = nullptr);
+
+public slots:
+    // 0 = automatic (85% of the cgroup limit or physical RAM)
+    void setBudgetMB(int budgetMB) { m_budgetMB = budgetMB; }
+    // Loaded model weights; mmap'd and freed only by unloading, so they
+    // are not counted against the budget
+    void setModelBytes(qint64 bytes) { m_modelBytes = bytes; }
+    void start();
+    void stop();
+    void sample();
+
+signals:
+    // Budget, current usage (cgroup charge or RSS) and system available, bytes
+    void sampled(qint64 budget, qint64 usage, qint64 available);
+    void pressure(qint64 bytesToFree);
+    // Under budget for a while; headroom is what can be used before pressure
+    void relieved(qint64 headroom);
+
+private:
+    QTimer *m_timer = nullptr;
+    qint64 m_budgetMB = 0;
+    qint64 m_modelBytes = 0;
+    int m_cooldown = 0;
+    int m_calmTicks = 0;
+
+    MetricGauge *m_usageGauge;
+    MetricGauge *m_budgetGauge;
+    MetricGauge *m_availableGauge;
+    MetricGauge *m_modelGauge;
+    MetricCounter *m_pressureEvents;
+};
+
+#endif // MEMORYGOVERNOR_H
@@ -1,7 +1,9 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <QtGlobal>
 #include <QString>
+#include <QByteArray>
 #include <QList>
 
 enum class ContentType {
@@ -11,11 +13,11 @@ enum class ContentType {
 };
 
 struct ContentBlock {
-    ContentType type;
+    ContentType type = ContentType::Text;
     QString content;
-    QString language;  // For code blocks
-    bool isClosed;     // For code and think blocks
-    int lineCount;     // For code blocks
+    QString language;       // For code blocks
+    bool isClosed = false;  // For code and think blocks
+    int lineCount = 0;      // For code blocks
 };
 
 struct ParsedContent {
@@ -23,9 +25,11 @@ struct ParsedContent {
 };
 
 struct Message {
+    qint64 id = -1;         // messages.id; -1 until the insert has run
     QString text;           // Original text (for history/storage)
     bool isUser;
-    QString timestamp;
+    QString timestamp;      // local time, "yyyy-MM-dd hh:mm:ss", for display
+    qint64 timestampMs = 0; // the same instant in epoch milliseconds
     ParsedContent parsed;   // Parsed content ready for display
 };
 
@@ -34,7 +38,18 @@ struct Chat {
     QString title;
     QString lastMessage;
     QString lastTimestamp;
-    QList<Message> messages;
+    qint64 lastTimestampMs = 0;  // sort key; lastTimestamp is for display
+    QString modelPath;  // model last used in this chat
+};
+
+// A stored message as needed to rebuild a model context. tokens are the
+// cached ids (native int32) for the requested vocabulary; when there are
+// none, text is set instead and has to be tokenized
+struct HistoryTurn {
+    qint64 messageId = -1;
+    bool isUser = false;
+    QString text;
+    QByteArray tokens;
 };
 
 #endif // MESSAGE_H
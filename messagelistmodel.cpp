@@ -1,12 +1,15 @@
 #include "messagelistmodel.h"
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
-#include <climits>
+#include <QSettings>
+#include "chatstorage.h"
+#include "tracer.h"
 
 MessageListModel::MessageListModel(QObject *parent)
     : QAbstractListModel(parent)
 {
+    QSettings settings("YourCompany", "AIChatGUI");
+    m_cacheBudgetBytes = settings.value("messageCacheMB", 32).toLongLong() * 1024 * 1024;
+    m_pageSize = qBound(10, settings.value("messagePageSize", 50).toInt(), 1000);
+    m_windowRows = qMax(3 * m_pageSize, settings.value("messageWindowRows", 300).toInt());
 }
 
 int MessageListModel::rowCount(const QModelIndex &parent) const
@@ -59,181 +62,271 @@ QHash<int, QByteArray> MessageListModel::roleNames() const
     return roles;
 }
 
-void MessageListModel::setDatabase(QSqlDatabase *db)
+void MessageListModel::setStorage(ChatStorage *storage)
 {
-    m_db = db;
+    m_storage = storage;
 }
 
-ParsedContent MessageListModel::deserializeBlocks(const QString &json)
+qint64 MessageListModel::oldestLoadedId() const
 {
-    ParsedContent result;
-
-    if (json.isEmpty()) {
-        return result;
+    for (const Message &msg : m_messages) {
+        if (msg.id >= 0) return msg.id;
     }
+    return -1;
+}
 
-    QJsonDocument doc = QJsonDocument::fromJson(json.toUtf8());
-    if (!doc.isArray()) {
-        qDebug() << "ERROR: blocks_json is not an array";
-        return result;
+qint64 MessageListModel::newestLoadedId() const
+{
+    for (auto it = m_messages.crbegin(); it != m_messages.crend(); ++it) {
+        if (it->id >= 0) return it->id;
     }
+    return -1;
+}
 
-    QJsonArray blocksArray = doc.array();
+void MessageListModel::resetWindow(const QString &chatId)
+{
+    ++m_loadGeneration;
+    beginResetModel();
+    m_messages.clear();
+    m_currentChatId = chatId;
+    m_hasMoreMessages = false;
+    m_hasNewerMessages = false;
+    m_loadingChat = !chatId.isEmpty();
+    m_loadingOlder = false;
+    m_loadingNewer = false;
+    endResetModel();
+    emit countChanged();
+}
 
-    for (const QJsonValue &value : blocksArray) {
-        if (!value.isObject())
-            continue;
+void MessageListModel::insertPage(const MessagePage &page, bool atTop)
+{
+    // A row appended while the read ran may already be in the page
+    QList<Message> rows;
+    rows.reserve(page.messages.size());
+    for (const Message &msg : page.messages) {
+        bool present = false;
+        for (const Message &existing : std::as_const(m_messages)) {
+            if (existing.id >= 0 && existing.id == msg.id) {
+                present = true;
+                break;
+            }
+        }
+        if (!present) rows.append(msg);
+    }
+    if (rows.isEmpty()) {
+        return;
+    }
 
-        QJsonObject blockObj = value.toObject();
+    int first = atTop ? 0 : m_messages.size();
+    beginInsertRows(QModelIndex(), first, first + rows.size() - 1);
+    m_messages = atTop ? rows + m_messages : m_messages + rows;
+    endInsertRows();
+    emit countChanged();
+}
 
-        ContentBlock block;
-        block.type = static_cast<ContentType>(blockObj["type"].toInt());
-        block.content = blockObj["content"].toString();
-        block.language = blockObj["language"].toString();
-        block.isClosed = blockObj["isClosed"].toBool();
-        block.lineCount = blockObj["lineCount"].toInt();
+void MessageListModel::trimWindow(bool keepTop)
+{
+    int excess = m_messages.size() - m_windowRows;
+    if (excess <= 0) {
+        return;
+    }
 
-        result.blocks.append(block);
+    if (keepTop) {
+        // Rows still waiting for their id sit at the end; they stay
+        for (int i = m_messages.size() - excess; i < m_messages.size(); ++i) {
+            if (m_messages[i].id < 0) return;
+        }
+        beginRemoveRows(QModelIndex(), m_messages.size() - excess, m_messages.size() - 1);
+        m_messages.remove(m_messages.size() - excess, excess);
+        endRemoveRows();
+        m_hasNewerMessages = true;
+    } else {
+        beginRemoveRows(QModelIndex(), 0, excess - 1);
+        m_messages.remove(0, excess);
+        endRemoveRows();
+        m_hasMoreMessages = true;
     }
 
-    return result;
+    emit countChanged();
+    emit hasMoreMessagesChanged();
 }
 
 void MessageListModel::loadMessages(const QString &chatId, int limit)
 {
-    Q_UNUSED(limit);
+    TRACE_ZONE("model", "MessageListModel::loadMessages");
 
     QElapsedTimer timer;
     timer.start();
 
-    if (!m_db || !m_db->isOpen()) {
-        qDebug() << "Database not available";
+    if (!m_storage) {
+        qDebug() << "Storage not available";
         return;
     }
 
     qDebug() << "=== Loading messages for chat:" << chatId;
 
-    beginResetModel();
-    m_messages.clear();
-    m_currentChatId = chatId;
-    m_oldestLoadedId = INT_MAX;
-    m_hasMoreMessages = false;
-    endResetModel();
-
-    // Load all messages without LIMIT
-    QSqlQuery query(*m_db);
-    query.prepare("SELECT id, text, isUser, timestamp, blocks_json "
-                  "FROM messages WHERE chat_id = ? "
-                  "ORDER BY id ASC");
-    query.addBindValue(chatId);
-
-    if (!query.exec()) {
-        qDebug() << "Failed to load messages:" << query.lastError().text();
+    stashCurrentChat();
+
+    auto cached = m_cache.find(chatId);
+    if (cached != m_cache.end()) {
+        ++m_loadGeneration;
+        beginResetModel();
+        m_messages = cached->messages;
+        m_currentChatId = chatId;
+        m_hasMoreMessages = cached->hasMoreMessages;
+        m_hasNewerMessages = cached->hasNewerMessages;
+        m_loadingChat = false;
+        m_loadingOlder = false;
+        m_loadingNewer = false;
+        m_cache.erase(cached);
+        endResetModel();
+
+        qDebug() << "Loaded" << m_messages.size() << "messages from cache in" << timer.elapsed() << "ms";
+        emit countChanged();
+        emit hasMoreMessagesChanged();
         return;
     }
 
-    QList<Message> loadedMessages;
-
-    while (query.next()) {
-        Message msg;
-        int msgId = query.value(0).toInt();
-        msg.text = query.value(1).toString();
-        msg.isUser = query.value(2).toBool();
-        msg.timestamp = query.value(3).toString();
-        QString blocksJson = query.value(4).toString();
-
-        if (!msg.isUser && !blocksJson.isEmpty()) {
-            msg.parsed = deserializeBlocks(blocksJson);
-        }
-
-        loadedMessages.append(msg);
-
-        if (msgId < m_oldestLoadedId) {
-            m_oldestLoadedId = msgId;
-        }
-    }
-
-    qDebug() << "SQL query finished in:" << timer.elapsed() << "ms";
+    resetWindow(chatId);
 
-    if (!loadedMessages.isEmpty()) {
-        qDebug() << "Inserting" << loadedMessages.size() << "rows into model...";
+    // Only the newest page, however long the chat; older pages follow the view
+    const int generation = m_loadGeneration;
+    m_storage->loadMessages(chatId, -1, limit > 0 ? limit : m_pageSize)
+        .then(this, [this, generation, timer](const MessagePage &page) {
+            if (generation != m_loadGeneration) {
+                return;  // another chat was opened meanwhile
+            }
+            m_loadingChat = false;
 
-        beginInsertRows(QModelIndex(), 0, loadedMessages.size() - 1);
-        m_messages = loadedMessages;
-        endInsertRows();
-
-        qDebug() << "Model update finished. Total time:" << timer.elapsed() << "ms";
-        emit countChanged();
-    }
+            qDebug() << "Messages arrived after:" << timer.elapsed() << "ms";
 
-    emit hasMoreMessagesChanged();
+            // Anything already here was appended after the read was issued
+            insertPage(page, true);
+            m_hasMoreMessages = page.hasMore;
+            emit hasMoreMessagesChanged();
+        });
 }
 
 void MessageListModel::loadOlderMessages(int count)
 {
-    if (!m_db || !m_db->isOpen() || !m_hasMoreMessages) {
+    TRACE_ZONE("model", "MessageListModel::loadOlderMessages");
+    if (!m_storage || !m_hasMoreMessages || m_loadingChat || m_loadingOlder) {
         return;
     }
 
-    QSqlQuery query(*m_db);
-    query.prepare("SELECT id, text, isUser, timestamp, blocks_json "
-                  "FROM messages WHERE chat_id = ? AND id < ? "
-                  "ORDER BY id DESC LIMIT ?");
-    query.addBindValue(m_currentChatId);
-    query.addBindValue(m_oldestLoadedId);
-    query.addBindValue(count);
+    m_loadingOlder = true;
+    const int generation = m_loadGeneration;
+    m_storage->loadMessages(m_currentChatId, oldestLoadedId(), count > 0 ? count : m_pageSize)
+        .then(this, [this, generation](const MessagePage &page) {
+            if (generation != m_loadGeneration) {
+                return;
+            }
+            m_loadingOlder = false;
+
+            insertPage(page, true);
+            m_hasMoreMessages = page.hasMore;
+            qDebug() << "Loaded" << page.messages.size() << "older messages";
+
+            // Rows far below the viewport go; fetchMore brings them back
+            trimWindow(true);
+            emit hasMoreMessagesChanged();
+        });
+}
+
+bool MessageListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_hasNewerMessages && !m_loadingChat && !m_loadingNewer;
+}
 
-    if (!query.exec()) {
-        qDebug() << "Failed to load older messages:" << query.lastError().text();
+void MessageListModel::fetchMore(const QModelIndex &parent)
+{
+    TRACE_ZONE("model", "MessageListModel::fetchMore");
+    if (!m_storage || !canFetchMore(parent)) {
         return;
     }
 
-    QList<Message> olderMessages;
-
-    while (query.next()) {
-        Message msg;
-        int msgId = query.value(0).toInt();
-        msg.text = query.value(1).toString();
-        msg.isUser = query.value(2).toBool();
-        msg.timestamp = query.value(3).toString();
-        QString blocksJson = query.value(4).toString();
-
-        if (!msg.isUser && !blocksJson.isEmpty()) {
-            msg.parsed = deserializeBlocks(blocksJson);
-        }
-
-        olderMessages.prepend(msg);
+    m_loadingNewer = true;
+    const int generation = m_loadGeneration;
+    m_storage->loadNewerMessages(m_currentChatId, newestLoadedId(), m_pageSize)
+        .then(this, [this, generation](const MessagePage &page) {
+            if (generation != m_loadGeneration) {
+                return;
+            }
+            m_loadingNewer = false;
+
+            insertPage(page, false);
+            m_hasNewerMessages = page.hasNewer;
+            trimWindow(false);
+            emit hasMoreMessagesChanged();
+        });
+}
 
-        if (msgId < m_oldestLoadedId) {
-            m_oldestLoadedId = msgId;
-        }
+void MessageListModel::loadAround(const QString &chatId, qint64 messageId)
+{
+    TRACE_ZONE("model", "MessageListModel::loadAround");
+    if (!m_storage) {
+        return;
     }
 
-    if (!olderMessages.isEmpty()) {
-        beginInsertRows(QModelIndex(), 0, olderMessages.size() - 1);
-        for (int i = olderMessages.size() - 1; i >= 0; --i) {
-            m_messages.prepend(olderMessages.at(i));
+    // Already in the window: no reload
+    if (chatId == m_currentChatId && !m_loadingChat) {
+        for (int row = 0; row < m_messages.size(); ++row) {
+            if (m_messages[row].id == messageId) {
+                emit messageRevealed(row);
+                return;
+            }
         }
-        endInsertRows();
-
-        qDebug() << "Loaded" << olderMessages.size() << "older messages";
-        emit countChanged();
     }
 
-    // Update hasMoreMessages flag
-    QSqlQuery countQuery(*m_db);
-    countQuery.prepare("SELECT COUNT(*) FROM messages WHERE chat_id = ? AND id < ?");
-    countQuery.addBindValue(m_currentChatId);
-    countQuery.addBindValue(m_oldestLoadedId);
-
-    if (countQuery.exec() && countQuery.next()) {
-        m_hasMoreMessages = countQuery.value(0).toInt() > 0;
-        emit hasMoreMessagesChanged();
+    if (chatId != m_currentChatId) {
+        stashCurrentChat();
+        m_cache.remove(chatId);
     }
+    resetWindow(chatId);
+
+    const int generation = m_loadGeneration;
+    m_storage->loadMessagesAround(chatId, messageId, 2 * m_pageSize)
+        .then(this, [this, generation, messageId](const MessagePage &page) {
+            if (generation != m_loadGeneration) {
+                return;
+            }
+            m_loadingChat = false;
+
+            insertPage(page, true);
+            m_hasMoreMessages = page.hasMore;
+            m_hasNewerMessages = page.hasNewer;
+            emit hasMoreMessagesChanged();
+
+            for (int row = 0; row < m_messages.size(); ++row) {
+                if (m_messages[row].id == messageId) {
+                    emit messageRevealed(row);
+                    break;
+                }
+            }
+        });
 }
 
 void MessageListModel::appendMessage(const Message &msg)
 {
+    TRACE_ZONE("model", "MessageListModel::appendMessage");
+    // The window is scrolled away from the end; jump back to the newest rows,
+    // which include this message since its insert is queued before the read
+    if (m_hasNewerMessages) {
+        QString chatId = m_currentChatId;
+        resetWindow(chatId);
+        const int generation = m_loadGeneration;
+        m_storage->loadMessages(chatId, -1, m_pageSize).then(this, [this, generation](const MessagePage &page) {
+            if (generation != m_loadGeneration) {
+                return;
+            }
+            m_loadingChat = false;
+            insertPage(page, true);
+            m_hasMoreMessages = page.hasMore;
+            emit hasMoreMessagesChanged();
+        });
+        return;
+    }
+
     beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size());
     m_messages.append(msg);
     endInsertRows();
@@ -242,6 +335,7 @@ void MessageListModel::appendMessage(const Message &msg)
 
 void MessageListModel::updateLastMessage(const Message &msg)
 {
+    TRACE_ZONE("model", "MessageListModel::updateLastMessage");
     if (m_messages.isEmpty()) {
         return;
     }
@@ -253,13 +347,99 @@ void MessageListModel::updateLastMessage(const Message &msg)
     emit dataChanged(index, index);
 }
 
+void MessageListModel::forgetChat(const QString &chatId)
+{
+    m_cache.remove(chatId);
+}
+
+void MessageListModel::setMessageId(const QString &chatId, qint64 id)
+{
+    QList<Message> *messages = nullptr;
+    if (chatId == m_currentChatId) {
+        messages = &m_messages;
+    } else if (m_cache.contains(chatId)) {
+        messages = &m_cache[chatId].messages;
+    }
+    if (!messages) {
+        return;
+    }
+
+    // Inserts complete in the order the rows were appended
+    int pending = -1;
+    int loaded = -1;
+    for (int row = 0; row < messages->size(); ++row) {
+        if (pending < 0 && messages->at(row).id < 0) pending = row;
+        if (messages->at(row).id == id) loaded = row;
+    }
+    if (pending < 0) {
+        return;
+    }
+    (*messages)[pending].id = id;
+
+    // A page read that raced the insert already brought this row in
+    if (loaded >= 0) {
+        if (messages == &m_messages) {
+            beginRemoveRows(QModelIndex(), loaded, loaded);
+            m_messages.removeAt(loaded);
+            endRemoveRows();
+            emit countChanged();
+        } else {
+            messages->removeAt(loaded);
+        }
+    }
+}
+
+void MessageListModel::stashCurrentChat()
+{
+    // A chat whose first page is still loading would be cached incomplete
+    if (m_currentChatId.isEmpty() || m_messages.isEmpty() || m_loadingChat) {
+        return;
+    }
+
+    CachedChat entry;
+    entry.messages = m_messages;
+    entry.hasMoreMessages = m_hasMoreMessages;
+    entry.hasNewerMessages = m_hasNewerMessages;
+    entry.bytes = estimateBytes(m_messages);
+    entry.lastUsed = ++m_cacheClock;
+    m_cache.insert(m_currentChatId, entry);
+    trimCache();
+}
+
+void MessageListModel::trimCache()
+{
+    qint64 total = 0;
+    for (const CachedChat &entry : std::as_const(m_cache)) {
+        total += entry.bytes;
+    }
+
+    // Least recently viewed chats go first; they reload from SQLite
+    while (total > m_cacheBudgetBytes && !m_cache.isEmpty()) {
+        auto oldest = m_cache.begin();
+        for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+            if (it->lastUsed < oldest->lastUsed) {
+                oldest = it;
+            }
+        }
+        total -= oldest->bytes;
+        m_cache.erase(oldest);
+    }
+}
+
+qint64 MessageListModel::estimateBytes(const QList<Message> &messages)
+{
+    qint64 bytes = 0;
+    for (const Message &msg : messages) {
+        bytes += (msg.text.size() + msg.timestamp.size()) * sizeof(QChar) + 64;
+        for (const ContentBlock &block : msg.parsed.blocks) {
+            bytes += (block.content.size() + block.language.size()) * sizeof(QChar) + 48;
+        }
+    }
+    return bytes;
+}
+
 void MessageListModel::clear()
 {
-    beginResetModel();
-    m_messages.clear();
-    m_currentChatId.clear();
-    m_oldestLoadedId = INT_MAX;
-    m_hasMoreMessages = true;
-    endResetModel();
-    emit countChanged();
+    stashCurrentChat();
+    resetWindow(QString());
 }
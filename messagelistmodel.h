@@ -2,18 +2,18 @@
 #define MESSAGELISTMODEL_H
 
 #include <QAbstractListModel>
-#include <QSqlQuery>
-#include <QSqlError>
 #include <QDebug>
-#include <QSqlDatabase>
 #include "message.h"
+#include "chatstorage.h"
 #include <QElapsedTimer>
+#include <QHash>
 
 class MessageListModel : public QAbstractListModel
 {
     Q_OBJECT
     Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
     Q_PROPERTY(bool hasMoreMessages READ hasMoreMessages NOTIFY hasMoreMessagesChanged)
+    Q_PROPERTY(bool hasNewerMessages READ hasNewerMessages NOTIFY hasMoreMessagesChanged)
 
 public:
     enum MessageRoles {
@@ -29,30 +29,74 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    // Newer rows, after the window was scrolled away from the end of the chat
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
-    // Data Management
-    Q_INVOKABLE void loadMessages(const QString &chatId, int limit = 30);
-    Q_INVOKABLE void loadOlderMessages(int count = 20);
+    // Data Management. The model holds a bounded window of a chat's rows,
+    // paged in keyset-style on (chat_id, id); limit/count 0 means one page
+    Q_INVOKABLE void loadMessages(const QString &chatId, int limit = 0);
+    // Called by the view as it nears the top of the window
+    Q_INVOKABLE void loadOlderMessages(int count = 0);
+    // Opens the window on messageId; messageRevealed gives its row
+    Q_INVOKABLE void loadAround(const QString &chatId, qint64 messageId);
     Q_INVOKABLE void appendMessage(const Message &msg);
     Q_INVOKABLE void updateLastMessage(const Message &msg);
     Q_INVOKABLE void clear();
 
     bool hasMoreMessages() const { return m_hasMoreMessages; }
+    bool hasNewerMessages() const { return m_hasNewerMessages; }
 
     // C++ specific methods
-    void setDatabase(QSqlDatabase *db);
-    ParsedContent deserializeBlocks(const QString &json);
+    void setStorage(ChatStorage *storage);
+    QString chatId() const { return m_currentChatId; }
+    const QList<Message> &messages() const { return m_messages; }
+    Message lastMessage() const { return m_messages.isEmpty() ? Message() : m_messages.last(); }
+    // Drops a deleted chat from the cache of recently viewed chats
+    void forgetChat(const QString &chatId);
+    // Gives the oldest row still waiting for its insert its database id
+    void setMessageId(const QString &chatId, qint64 id);
 
 signals:
     void countChanged();
     void hasMoreMessagesChanged();
+    void messageRevealed(int row);
 
 private:
+    // Messages of a chat that was open recently, so switching back skips SQLite
+    struct CachedChat {
+        QList<Message> messages;
+        bool hasMoreMessages = false;
+        bool hasNewerMessages = false;
+        qint64 bytes = 0;
+        qint64 lastUsed = 0;
+    };
+
+    void resetWindow(const QString &chatId);
+    void insertPage(const MessagePage &page, bool atTop);
+    void trimWindow(bool keepTop);
+    qint64 oldestLoadedId() const;
+    qint64 newestLoadedId() const;
+    void stashCurrentChat();
+    void trimCache();
+    static qint64 estimateBytes(const QList<Message> &messages);
+
     QList<Message> m_messages;
     QString m_currentChatId;
-    int m_oldestLoadedId = INT_MAX;
     bool m_hasMoreMessages = true;
-    QSqlDatabase *m_db = nullptr;
+    bool m_hasNewerMessages = false;
+    ChatStorage *m_storage = nullptr;
+    // Bumped whenever the window is replaced so late pages for it are dropped
+    int m_loadGeneration = 0;
+    bool m_loadingChat = false;
+    bool m_loadingOlder = false;
+    bool m_loadingNewer = false;
+    int m_pageSize = 50;
+    int m_windowRows = 300;
+
+    QHash<QString, CachedChat> m_cache;
+    qint64 m_cacheBudgetBytes = 32LL * 1024 * 1024;
+    qint64 m_cacheClock = 0;
 };
 
 #endif // MESSAGELISTMODEL_H
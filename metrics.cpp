@@ -0,0 +1,200 @@
+#include "metrics.h"
+#include <QJsonArray>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+static void atomicAdd(std::atomic<double> &target, double delta)
+{
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+static QByteArray formatValue(double value)
+{
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    return QByteArray::number(value, 'g', 12);
+}
+
+void MetricGauge::add(double delta)
+{
+    atomicAdd(m_value, delta);
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double> &bounds)
+    : m_bounds(bounds)
+    , m_buckets(new std::atomic<quint64>[bounds.size() + 1])
+{
+    std::sort(m_bounds.begin(), m_bounds.end());
+    for (size_t i = 0; i <= m_bounds.size(); ++i) {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value)
+{
+    size_t index = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+    m_buckets[index].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(m_sum, value);
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+std::vector<double> Metrics::latencyBuckets()
+{
+    return {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0};
+}
+
+Metrics::Family *Metrics::find(const QString &name) const
+{
+    for (const auto &family : m_families) {
+        if (family->name == name) {
+            return family.get();
+        }
+    }
+    return nullptr;
+}
+
+MetricCounter *Metrics::counter(const QString &name, const QString &help)
+{
+    QMutexLocker locker(&m_mutex);
+    if (Family *existing = find(name)) {
+        Q_ASSERT(existing->type == Type::Counter);
+        return existing->counter.get();
+    }
+
+    auto family = std::make_unique<Family>();
+    family->name = name;
+    family->help = help;
+    family->type = Type::Counter;
+    family->counter = std::make_unique<MetricCounter>();
+    MetricCounter *result = family->counter.get();
+    m_families.push_back(std::move(family));
+    return result;
+}
+
+MetricGauge *Metrics::gauge(const QString &name, const QString &help)
+{
+    QMutexLocker locker(&m_mutex);
+    if (Family *existing = find(name)) {
+        Q_ASSERT(existing->type == Type::Gauge);
+        return existing->gauge.get();
+    }
+
+    auto family = std::make_unique<Family>();
+    family->name = name;
+    family->help = help;
+    family->type = Type::Gauge;
+    family->gauge = std::make_unique<MetricGauge>();
+    MetricGauge *result = family->gauge.get();
+    m_families.push_back(std::move(family));
+    return result;
+}
+
+MetricHistogram *Metrics::histogram(const QString &name, const QString &help,
+                                    const std::vector<double> &bounds)
+{
+    QMutexLocker locker(&m_mutex);
+    if (Family *existing = find(name)) {
+        Q_ASSERT(existing->type == Type::Histogram);
+        return existing->histogram.get();
+    }
+
+    auto family = std::make_unique<Family>();
+    family->name = name;
+    family->help = help;
+    family->type = Type::Histogram;
+    family->histogram = std::make_unique<MetricHistogram>(bounds);
+    MetricHistogram *result = family->histogram.get();
+    m_families.push_back(std::move(family));
+    return result;
+}
+
+QByteArray Metrics::prometheusText() const
+{
+    QMutexLocker locker(&m_mutex);
+    QByteArray out;
+    out.reserve(4096);
+
+    for (const auto &family : m_families) {
+        const QByteArray name = family->name.toUtf8();
+        out += "# HELP " + name + " " + family->help.toUtf8() + "\n";
+
+        switch (family->type) {
+        case Type::Counter:
+            out += "# TYPE " + name + " counter\n";
+            out += name + " " + QByteArray::number(family->counter->value()) + "\n";
+            break;
+        case Type::Gauge:
+            out += "# TYPE " + name + " gauge\n";
+            out += name + " " + formatValue(family->gauge->value()) + "\n";
+            break;
+        case Type::Histogram: {
+            const MetricHistogram *h = family->histogram.get();
+            out += "# TYPE " + name + " histogram\n";
+            quint64 cumulative = 0;
+            for (size_t i = 0; i < h->bounds().size(); ++i) {
+                cumulative += h->bucketCount(i);
+                out += name + "_bucket{le=\"" + formatValue(h->bounds()[i]) + "\"} "
+                       + QByteArray::number(cumulative) + "\n";
+            }
+            cumulative += h->bucketCount(h->bounds().size());
+            out += name + "_bucket{le=\"+Inf\"} " + QByteArray::number(cumulative) + "\n";
+            out += name + "_sum " + formatValue(h->sum()) + "\n";
+            out += name + "_count " + QByteArray::number(cumulative) + "\n";
+            break;
+        }
+        }
+    }
+
+    return out;
+}
+
+QJsonObject Metrics::snapshot() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject metrics;
+
+    for (const auto &family : m_families) {
+        switch (family->type) {
+        case Type::Counter:
+            metrics[family->name] = double(family->counter->value());
+            break;
+        case Type::Gauge:
+            metrics[family->name] = family->gauge->value();
+            break;
+        case Type::Histogram: {
+            const MetricHistogram *h = family->histogram.get();
+            QJsonArray buckets;
+            for (size_t i = 0; i <= h->bounds().size(); ++i) {
+                buckets.append(double(h->bucketCount(i)));
+            }
+            QJsonArray bounds;
+            for (double bound : h->bounds()) {
+                bounds.append(bound);
+            }
+            QJsonObject histogram;
+            histogram["count"] = double(h->count());
+            histogram["sum"] = h->sum();
+            histogram["bounds"] = bounds;
+            histogram["buckets"] = buckets;
+            metrics[family->name] = histogram;
+            break;
+        }
+        }
+    }
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    root["metrics"] = metrics;
+    return root;
+}
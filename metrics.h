@@ -0,0 +1,94 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Process-wide metrics registry. Registration takes a lock and happens at
+// startup; callers keep the returned pointers, and updating them afterwards
+// is a relaxed atomic operation that is safe from any thread.
+
+class MetricCounter
+{
+public:
+    void add(quint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+class MetricGauge
+{
+public:
+    void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(double delta);
+    double value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> m_value{0.0};
+};
+
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(const std::vector<double> &bounds);
+
+    void observe(double value);
+
+    const std::vector<double> &bounds() const { return m_bounds; }
+    // Non-cumulative count of the bucket; index bounds().size() is +Inf
+    quint64 bucketCount(size_t index) const { return m_buckets[index].load(std::memory_order_relaxed); }
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    double sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<quint64>[]> m_buckets;
+    std::atomic<quint64> m_count{0};
+    std::atomic<double> m_sum{0.0};
+};
+
+class Metrics
+{
+public:
+    static Metrics &instance();
+
+    // Returns the existing metric when the name is already registered
+    MetricCounter *counter(const QString &name, const QString &help);
+    MetricGauge *gauge(const QString &name, const QString &help);
+    MetricHistogram *histogram(const QString &name, const QString &help,
+                               const std::vector<double> &bounds);
+
+    // Bucket bounds in seconds, from 1 ms to 60 s
+    static std::vector<double> latencyBuckets();
+
+    QByteArray prometheusText() const;
+    QJsonObject snapshot() const;
+
+private:
+    Metrics() = default;
+
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Family {
+        QString name;
+        QString help;
+        Type type;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    Family *find(const QString &name) const;
+
+    mutable QMutex m_mutex;
+    std::vector<std::unique_ptr<Family>> m_families;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,130 @@
+#include "metricsexporter.h"
+#include "metrics.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+// Scrape requests are a single GET line plus headers
+static const int MAX_REQUEST_BYTES = 8192;
+
+MetricsExporter::MetricsExporter(const QHostAddress &address, quint16 port,
+                                 const QString &snapshotPath, int snapshotIntervalMs,
+                                 QObject *parent)
+    : QObject(parent)
+    , m_address(address)
+    , m_port(port)
+    , m_snapshotPath(snapshotPath)
+    , m_snapshotIntervalMs(snapshotIntervalMs)
+{
+}
+
+void MetricsExporter::start()
+{
+    // Created here so server and timer live on the monitor thread
+    if (m_port > 0 && !m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &MetricsExporter::acceptConnections);
+        if (m_server->listen(m_address, m_port)) {
+            qDebug() << "Metrics endpoint: http://" + m_address.toString() + ":" + QString::number(m_port) + "/metrics";
+        } else {
+            qDebug() << "Failed to start metrics endpoint:" << m_server->errorString();
+        }
+    }
+
+    if (m_snapshotIntervalMs > 0 && !m_snapshotPath.isEmpty() && !m_snapshotTimer) {
+        QDir().mkpath(QFileInfo(m_snapshotPath).absolutePath());
+        m_snapshotTimer = new QTimer(this);
+        m_snapshotTimer->setInterval(m_snapshotIntervalMs);
+        connect(m_snapshotTimer, &QTimer::timeout, this, &MetricsExporter::writeSnapshot);
+        m_snapshotTimer->start();
+    }
+}
+
+void MetricsExporter::stop()
+{
+    if (m_snapshotTimer) {
+        m_snapshotTimer->stop();
+        writeSnapshot();
+    }
+    if (m_server) {
+        m_server->close();
+    }
+}
+
+void MetricsExporter::writeSnapshot()
+{
+    QSaveFile file(m_snapshotPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Failed to write metrics snapshot:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(Metrics::instance().snapshot()).toJson(QJsonDocument::Indented));
+    file.commit();
+}
+
+void MetricsExporter::acceptConnections()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            handleRequest(socket);
+        });
+    }
+}
+
+void MetricsExporter::handleRequest(QTcpSocket *socket)
+{
+    // Wait for the end of the headers; the body (if any) is ignored
+    QByteArray pending = socket->peek(MAX_REQUEST_BYTES);
+    if (!pending.contains("\r\n\r\n") && !pending.contains("\n\n")) {
+        if (pending.size() >= MAX_REQUEST_BYTES) {
+            socket->abort();
+        }
+        return;
+    }
+    QByteArray requestLine = socket->readLine().trimmed();
+    socket->readAll();
+
+    QList<QByteArray> parts = requestLine.split(' ');
+    QByteArray method = parts.value(0);
+    QByteArray path = parts.value(1);
+    int query = path.indexOf('?');
+    if (query >= 0) {
+        path.truncate(query);
+    }
+
+    QByteArray status = "200 OK";
+    QByteArray contentType;
+    QByteArray body;
+
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+        contentType = "text/plain";
+        body = "Method not allowed\n";
+    } else if (path == "/metrics") {
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+        body = Metrics::instance().prometheusText();
+    } else if (path == "/metrics.json") {
+        contentType = "application/json";
+        body = QJsonDocument(Metrics::instance().snapshot()).toJson(QJsonDocument::Compact);
+    } else {
+        status = "404 Not Found";
+        contentType = "text/plain";
+        body = "Not found\n";
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: " + contentType + "\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n";
+    if (method != "HEAD") {
+        response += body;
+    }
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
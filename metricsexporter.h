@@ -0,0 +1,42 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QTimer>
+
+class QTcpServer;
+class QTcpSocket;
+
+// Serves the metrics registry as Prometheus text on GET /metrics (and JSON
+// on /metrics.json) and writes a JSON snapshot file periodically. Runs on
+// the monitor thread so a slow scraper never touches the GUI.
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    // port 0 disables the endpoint, interval 0 disables the snapshot file
+    MetricsExporter(const QHostAddress &address, quint16 port,
+                    const QString &snapshotPath, int snapshotIntervalMs,
+                    QObject *parent = nullptr);
+
+public slots:
+    void start();
+    void stop();
+    void writeSnapshot();
+
+private slots:
+    void acceptConnections();
+
+private:
+    void handleRequest(QTcpSocket *socket);
+
+    QHostAddress m_address;
+    quint16 m_port;
+    QString m_snapshotPath;
+    int m_snapshotIntervalMs;
+    QTcpServer *m_server = nullptr;
+    QTimer *m_snapshotTimer = nullptr;
+};
+
+#endif // METRICSEXPORTER_H
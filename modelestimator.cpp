@@ -0,0 +1,102 @@
+#include "modelestimator.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Share of peak read bandwidth a decode step reaches in practice
+static const double DECODE_BANDWIDTH_EFFICIENCY = 0.7;
+// Compute and output buffers at the worker's batch sizes
+static const qint64 COMPUTE_OVERHEAD_BYTES = 512LL * 1024 * 1024;
+// Large enough to defeat the last-level cache on desktop and most server parts
+static const size_t PROBE_BUFFER_BYTES = 512ULL * 1024 * 1024;
+
+namespace ModelEstimator {
+
+ModelEstimate estimate(const GgufInfo &info, int nCtx, double bandwidthBytesPerSec)
+{
+    ModelEstimate result;
+    if (!info.valid) {
+        return result;
+    }
+
+    if (info.contextLength > 0) {
+        nCtx = std::min(nCtx, info.contextLength);
+    }
+
+    int headDim = info.headCount > 0 ? info.embeddingLength / info.headCount : 0;
+    int keyLength = info.keyLength > 0 ? info.keyLength : headDim;
+    int valueLength = info.valueLength > 0 ? info.valueLength : headDim;
+    qint64 kvBytesPerToken = qint64(info.blockCount) * info.headCountKv * (keyLength + valueLength) * 2;
+
+    result.weightBytes = info.tensorBytes;
+    result.kvBytes = kvBytesPerToken * nCtx;
+    result.overheadBytes = COMPUTE_OVERHEAD_BYTES;
+    result.residentBytes = result.weightBytes + result.kvBytes + result.overheadBytes;
+
+    // MoE: only the routed experts' share of the expert tensors is read
+    double activeWeights = info.tensorBytes;
+    if (info.expertCount > 0 && info.expertUsedCount > 0 && info.expertTensorBytes > 0) {
+        activeWeights = (info.tensorBytes - info.expertTensorBytes)
+                        + double(info.expertTensorBytes) * info.expertUsedCount / info.expertCount;
+    }
+
+    // Attention reads the filled part of the cache; assume it is half full on average
+    result.bytesPerToken = activeWeights + kvBytesPerToken * (nCtx / 2.0);
+    if (bandwidthBytesPerSec > 0 && result.bytesPerToken > 0) {
+        result.decodeTokensPerSec = bandwidthBytesPerSec * DECODE_BANDWIDTH_EFFICIENCY / result.bytesPerToken;
+    }
+
+    return result;
+}
+
+double measureMemoryBandwidth(int threads)
+{
+    threads = std::max(1, threads);
+    const size_t words = PROBE_BUFFER_BYTES / sizeof(quint64);
+    std::unique_ptr<quint64[]> buffer(new (std::nothrow) quint64[words]);
+    if (!buffer) {
+        return 0.0;
+    }
+
+    // Touch every page first so the reads below measure DRAM, not page faults
+    for (size_t i = 0; i < words; ++i) {
+        buffer[i] = i;
+    }
+
+    std::atomic<quint64> sink{0};
+    double best = 0.0;
+
+    for (int run = 0; run < 3; ++run) {
+        std::vector<std::thread> readers;
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int t = 0; t < threads; ++t) {
+            readers.emplace_back([&, t]() {
+                size_t begin = words * t / threads;
+                size_t end = words * (t + 1) / threads;
+                quint64 sum = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    sum += buffer[i];
+                }
+                sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+        }
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+
+        double seconds = timer.nsecsElapsed() / 1e9;
+        if (seconds > 0) {
+            best = std::max(best, PROBE_BUFFER_BYTES / seconds);
+        }
+    }
+
+    // The sums land in `sink` so the reads cannot be optimised away
+    return best;
+}
+
+}
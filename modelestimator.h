@@ -0,0 +1,29 @@
+#ifndef MODELESTIMATOR_H
+#define MODELESTIMATOR_H
+
+#include <QtGlobal>
+#include "ggufinfo.h"
+
+// Pre-load estimates from GGUF header data. Decode on CPU is memory bound:
+// every token streams the active weights plus the KV cache once, so
+// tokens/s ~ effective bandwidth / bytes read per token.
+struct ModelEstimate {
+    qint64 weightBytes = 0;
+    qint64 kvBytes = 0;        // F16 K and V at the planned context
+    qint64 overheadBytes = 0;  // compute buffers, rough
+    qint64 residentBytes = 0;
+    double bytesPerToken = 0.0;
+    double decodeTokensPerSec = 0.0;  // 0 when bandwidth is unknown
+};
+
+namespace ModelEstimator {
+
+ModelEstimate estimate(const GgufInfo &info, int nCtx, double bandwidthBytesPerSec);
+
+// Best-of-three streaming read over a buffer larger than the LLC, with
+// `threads` readers. Bytes per second; takes about a second.
+double measureMemoryBandwidth(int threads);
+
+}
+
+#endif // MODELESTIMATOR_H
@@ -0,0 +1,249 @@
+#include "modelindex.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+
+// Bump when GgufInfo gains fields
+static const int INDEX_VERSION = 3;
+
+ModelIndex::ModelIndex(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName("model_index")
+{
+}
+
+ModelIndex::~ModelIndex()
+{
+    // Runs on the index thread (deleteLater), which owns the connection
+    if (QSqlDatabase::contains(m_connectionName)) {
+        {
+            QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+void ModelIndex::start()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_databasePath);
+    if (!db.open()) {
+        qDebug() << "Failed to open model index:" << db.lastError().text();
+    } else {
+        QSqlQuery query(db);
+        query.exec("CREATE TABLE IF NOT EXISTS model_index ("
+                   "path TEXT PRIMARY KEY, "
+                   "size INTEGER NOT NULL, "
+                   "mtime INTEGER NOT NULL, "
+                   "metadata TEXT NOT NULL)");
+
+        // Entries written by an older reader lack fields; re-read everything
+        query.exec("PRAGMA user_version");
+        int version = query.next() ? query.value(0).toInt() : 0;
+        if (version != INDEX_VERSION) {
+            query.exec("DELETE FROM model_index");
+            query.exec(QString("PRAGMA user_version = %1").arg(INDEX_VERSION));
+        }
+    }
+
+    // Created here so they live on the index thread
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &ModelIndex::scheduleRescan);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &ModelIndex::scheduleRescan);
+
+    // Copies of multi-GB files fire many change events; coalesce them
+    m_rescanTimer = new QTimer(this);
+    m_rescanTimer->setSingleShot(true);
+    m_rescanTimer->setInterval(500);
+    connect(m_rescanTimer, &QTimer::timeout, this, &ModelIndex::rescan);
+}
+
+void ModelIndex::setFolder(const QString &folder)
+{
+    if (!m_watcher) {
+        start();
+    }
+
+    const QStringList watched = m_watcher->directories() + m_watcher->files();
+    if (!watched.isEmpty()) {
+        m_watcher->removePaths(watched);
+    }
+
+    m_folder = folder.isEmpty() ? QString() : QDir(folder).absolutePath();
+    m_entries.clear();
+
+    if (m_folder.isEmpty()) {
+        publish();
+        return;
+    }
+
+    m_watcher->addPath(m_folder);
+
+    // Show the cached view immediately, then bring it up to date
+    loadCache();
+    publish();
+    rescan();
+}
+
+void ModelIndex::scheduleRescan()
+{
+    m_rescanTimer->start();
+}
+
+void ModelIndex::rescan()
+{
+    if (m_folder.isEmpty()) {
+        return;
+    }
+
+    QDir dir(m_folder);
+    if (!dir.exists()) {
+        qWarning() << "Models folder does not exist:" << m_folder;
+        if (!m_entries.isEmpty()) {
+            m_entries.clear();
+            publish();
+        }
+        return;
+    }
+
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.gguf", QDir::Files, QDir::Name);
+    QSet<QString> seen;
+    int parsed = 0;
+    bool changed = false;
+
+    for (const QFileInfo &fileInfo : files) {
+        const QString path = fileInfo.absoluteFilePath();
+        seen.insert(path);
+
+        Entry entry;
+        entry.size = fileInfo.size();
+        entry.mtime = fileInfo.lastModified().toMSecsSinceEpoch();
+
+        auto it = m_entries.constFind(path);
+        if (it != m_entries.cend() && it->size == entry.size && it->mtime == entry.mtime) {
+            continue;
+        }
+
+        entry.info = readGgufInfo(path);
+        parsed++;
+
+        // A file still being copied has no valid header yet; watch it until it does
+        if (!entry.info.valid) {
+            m_watcher->addPath(path);
+        } else if (m_watcher->files().contains(path)) {
+            m_watcher->removePath(path);
+        }
+
+        m_entries.insert(path, entry);
+        storeEntry(path, entry);
+        changed = true;
+    }
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (!seen.contains(it.key())) {
+            removeEntry(it.key());
+            it = m_entries.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    qDebug() << "Model index:" << m_entries.size() << "models," << parsed << "headers read";
+    if (changed) {
+        publish();
+    }
+}
+
+void ModelIndex::loadCache()
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    QSqlQuery query(db);
+    query.prepare("SELECT path, size, mtime, metadata FROM model_index WHERE path LIKE ?");
+    query.addBindValue(m_folder + "/%");
+    if (!query.exec()) {
+        return;
+    }
+
+    while (query.next()) {
+        const QString path = query.value(0).toString();
+        // LIKE also matches subfolders
+        if (QFileInfo(path).absolutePath() != m_folder) continue;
+
+        Entry entry;
+        entry.size = query.value(1).toLongLong();
+        entry.mtime = query.value(2).toLongLong();
+        QJsonObject metadata = QJsonDocument::fromJson(query.value(3).toByteArray()).object();
+        entry.info = GgufInfo::fromVariantMap(metadata.toVariantMap());
+        m_entries.insert(path, entry);
+    }
+}
+
+void ModelIndex::storeEntry(const QString &path, const Entry &entry)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO model_index (path, size, mtime, metadata) VALUES (?, ?, ?, ?)");
+    query.addBindValue(path);
+    query.addBindValue(entry.size);
+    query.addBindValue(entry.mtime);
+    query.addBindValue(QString::fromUtf8(QJsonDocument(QJsonObject::fromVariantMap(entry.info.toVariantMap()))
+                                             .toJson(QJsonDocument::Compact)));
+    if (!query.exec()) {
+        qDebug() << "Failed to cache model metadata:" << query.lastError().text();
+    }
+}
+
+void ModelIndex::removeEntry(const QString &path)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM model_index WHERE path = ?");
+    query.addBindValue(path);
+    query.exec();
+}
+
+void ModelIndex::publish()
+{
+    QStringList paths = m_entries.keys();
+    std::sort(paths.begin(), paths.end(), [](const QString &a, const QString &b) {
+        return QFileInfo(a).fileName().compare(QFileInfo(b).fileName(), Qt::CaseInsensitive) < 0;
+    });
+
+    QVariantList models;
+    for (const QString &path : std::as_const(paths)) {
+        const Entry &entry = m_entries[path];
+
+        double sizeGB = entry.size / (1024.0 * 1024.0 * 1024.0);
+        QString sizeString = sizeGB >= 1.0 ? QString::number(sizeGB, 'f', 1) + " GB"
+                                           : QString::number(entry.size / (1024.0 * 1024.0), 'f', 0) + " MB";
+
+        QVariantMap model;
+        model["fileName"] = QFileInfo(path).fileName();
+        model["fullPath"] = path;
+        model["size"] = sizeString;
+        model["sizeBytes"] = entry.size;
+        model["valid"] = entry.info.valid;
+        model["parameters"] = entry.info.valid ? entry.info.parameterString() : QString("Unknown");
+        model["quantization"] = entry.info.quantization;
+        model["architecture"] = entry.info.architecture;
+        model["isAdapter"] = entry.info.isAdapter();
+        model["contextLength"] = entry.info.contextLength;
+        model["layers"] = entry.info.blockCount;
+        model["gguf"] = entry.info.toVariantMap();
+        models.append(model);
+    }
+
+    emit modelsIndexed(models);
+}
@@ -0,0 +1,54 @@
+#ifndef MODELINDEX_H
+#define MODELINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QVariantList>
+#include <QTimer>
+#include "ggufinfo.h"
+
+class QFileSystemWatcher;
+
+// Indexes *.gguf files in the models folder on its own thread. Header
+// metadata is cached in SQLite keyed by path + size + mtime, so a rescan
+// only opens new or changed files; the folder is watched for changes.
+class ModelIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ModelIndex(const QString &databasePath, QObject *parent = nullptr);
+    ~ModelIndex();
+
+public slots:
+    void start();
+    void setFolder(const QString &folder);
+    void rescan();
+
+signals:
+    // One QVariantMap per model, sorted by file name
+    void modelsIndexed(const QVariantList &models);
+
+private slots:
+    void scheduleRescan();
+
+private:
+    struct Entry {
+        qint64 size = 0;
+        qint64 mtime = 0;
+        GgufInfo info;
+    };
+
+    void loadCache();
+    void storeEntry(const QString &path, const Entry &entry);
+    void removeEntry(const QString &path);
+    void publish();
+
+    QString m_databasePath;
+    QString m_connectionName;
+    QString m_folder;
+    QHash<QString, Entry> m_entries;  // current folder only
+    QFileSystemWatcher *m_watcher = nullptr;
+    QTimer *m_rescanTimer = nullptr;
+};
+
+#endif // MODELINDEX_H
@@ -4,7 +4,12 @@
 #include <cmath>
 #include <QDir>
 #include <QSettings>
-#include <QRegularExpression>
+#include <QStandardPaths>
+#include "modelindex.h"
+#include "ggufinfo.h"
+#include "modelestimator.h"
+#include "cputopology.h"
+#include <QSysInfo>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -103,10 +108,21 @@ void RequestLogModel::clear()
 
 ModelInfo::ModelInfo(QObject *parent)
     : QObject(parent)
-    , m_ctx(nullptr)
     , m_lastTokensIn(0)
 {
     m_requestLog = new RequestLogModel(this);
+
+    // Model list comes from the header index; it reads files off the GUI thread
+    ModelIndex *modelIndex = new ModelIndex(
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model_index.db");
+    modelIndex->moveToThread(&m_indexThread);
+    m_indexThread.setObjectName("ModelIndex");
+    connect(&m_indexThread, &QThread::started, modelIndex, &ModelIndex::start);
+    connect(&m_indexThread, &QThread::finished, modelIndex, &QObject::deleteLater);
+    connect(this, &ModelInfo::requestIndexFolder, modelIndex, &ModelIndex::setFolder);
+    connect(this, &ModelInfo::requestIndexRescan, modelIndex, &ModelIndex::rescan);
+    connect(modelIndex, &ModelIndex::modelsIndexed, this, &ModelInfo::applyModelIndex);
+    m_indexThread.start();
     m_statsTimer = new QTimer(this);
     connect(m_statsTimer, &QTimer::timeout, this, &ModelInfo::updateCurrentStats);
     m_statsTimer->setInterval(1000);
@@ -157,10 +173,17 @@ ModelInfo::ModelInfo(QObject *parent)
 
     loadSettings();
     updateGPUMetrics();
+    startBandwidthProbe();
 }
 
 ModelInfo::~ModelInfo()
 {
+    m_indexThread.quit();
+    m_indexThread.wait();
+    if (m_bandwidthThread) {
+        m_bandwidthThread->wait();
+    }
+
 #ifdef _WIN32
     if (m_nvmlLib) {
         auto nvmlShutdown = (nvmlShutdown_t)GetProcAddress((HMODULE)m_nvmlLib, "nvmlShutdown");
@@ -179,8 +202,6 @@ void ModelInfo::setModel(llama_model *model, llama_context *ctx, const QString &
     if (!model || !ctx)
         return;
 
-    m_ctx = ctx;
-
     // Get model size from llama.cpp API
     size_t model_size = llama_model_size(model);
     if (model_size > 0) {
@@ -220,16 +241,16 @@ void ModelInfo::setModel(llama_model *model, llama_context *ctx, const QString &
         m_vocabSize = QString::number(llama_vocab_n_tokens(vocab));
     }
 
-    // Detect quantization type from filename
-    QString fileName = m_modelName.toLower();
-    if (fileName.contains("q4_0")) m_quantization = "Q4_0";
-    else if (fileName.contains("q4_1")) m_quantization = "Q4_1";
-    else if (fileName.contains("q5_0")) m_quantization = "Q5_0";
-    else if (fileName.contains("q5_1")) m_quantization = "Q5_1";
-    else if (fileName.contains("q8_0")) m_quantization = "Q8_0";
-    else if (fileName.contains("f16")) m_quantization = "F16";
-    else if (fileName.contains("f32")) m_quantization = "F32";
-    else m_quantization = "Unknown";
+    // Real file type from the GGUF metadata
+    char fileType[32] = {0};
+    if (llama_model_meta_val_str(model, "general.file_type", fileType, sizeof(fileType)) > 0) {
+        m_quantization = ggufFileTypeName(QByteArray(fileType).toInt());
+    } else {
+        m_quantization.clear();
+    }
+    if (m_quantization.isEmpty()) {
+        m_quantization = "Unknown";
+    }
 
     char model_desc[128];
     llama_model_desc(model, model_desc, sizeof(model_desc));
@@ -238,6 +259,12 @@ void ModelInfo::setModel(llama_model *model, llama_context *ctx, const QString &
     m_loadedTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
 
     m_threads = llama_n_threads(ctx);
+    m_contextLength = llama_n_ctx(ctx);
+
+    m_perfPromptTokens = 0;
+    m_perfEvalTokens = 0;
+    m_perfEvalMs = 0.0;
+    m_lastTokensIn = 0;
 
     m_statsTimer->start();
     if (m_gpuTimer && !m_gpuTimer->isActive()) {
@@ -249,7 +276,11 @@ void ModelInfo::setModel(llama_model *model, llama_context *ctx, const QString &
 
 void ModelInfo::clearModel()
 {
-    m_ctx = nullptr;
+    m_perfPromptTokens = 0;
+    m_perfEvalTokens = 0;
+    m_perfEvalMs = 0.0;
+    m_lastTokensIn = 0;
+    m_contextLength = 0;
 
     m_isLoaded = false;
     m_modelName = "No Model Loaded";
@@ -297,10 +328,6 @@ void ModelInfo::updateStats(llama_context *ctx)
         m_memoryUsed = (memInfo.ullTotalPhys - memInfo.ullAvailPhys) / (1024.0f * 1024.0f * 1024.0f);
         m_memoryPercent = memInfo.dwMemoryLoad;
     }
-#else
-    m_memoryTotal = 8.0f;
-    m_memoryUsed = 2.5f;
-    m_memoryPercent = static_cast<int>((m_memoryUsed / m_memoryTotal) * 100);
 #endif
 
     m_status = (perf.n_eval > 0) ? "Generating" : "Idle";
@@ -315,12 +342,13 @@ void ModelInfo::recordGeneration(int n_tokens, double duration_ms)
         m_speed = speed;
         emit speedDataPoint(speed);
 
-        int currentTokensIn = 0;
-        if (m_ctx) {
-            struct llama_perf_context_data perf = llama_perf_context(m_ctx);
-            m_tokensIn = perf.n_p_eval;
-            m_tokensOut = perf.n_eval;
-            currentTokensIn = perf.n_p_eval;
+        m_tokensIn = m_perfPromptTokens;
+        m_tokensOut = m_perfEvalTokens;
+        int currentTokensIn = m_perfPromptTokens;
+
+        // Counters restart when the context is recreated
+        if (currentTokensIn < m_lastTokensIn) {
+            m_lastTokensIn = 0;
         }
 
         QString currentTime = QDateTime::currentDateTime().toString("HH:mm:ss");
@@ -340,9 +368,145 @@ void ModelInfo::setGenerating(bool generating)
     emit statsChanged();
 }
 
+void ModelInfo::setBackendInfo(const QString &backend, const QString &isa, const QString &features)
+{
+    m_cpuBackend = backend;
+    m_cpuIsa = isa;
+    m_cpuFeatures = features;
+    emit backendInfoChanged();
+}
+
+void ModelInfo::updatePerf(int promptTokens, int evalTokens, double evalMs)
+{
+    m_perfPromptTokens = promptTokens;
+    m_perfEvalTokens = evalTokens;
+    m_perfEvalMs = evalMs;
+}
+
+void ModelInfo::setMemoryBudgetMB(int budgetMB)
+{
+    if (m_memoryBudgetMB != budgetMB) {
+        m_memoryBudgetMB = budgetMB;
+        emit memoryBudgetMBChanged(budgetMB);
+        saveSettings();
+    }
+}
+
+void ModelInfo::setRecordRequests(bool enabled)
+{
+    if (m_recordRequests != enabled) {
+        m_recordRequests = enabled;
+        emit recordRequestsChanged(enabled);
+        saveSettings();
+    }
+}
+
+void ModelInfo::setMemoryUsage(qint64 budget, qint64 usage, qint64 available)
+{
+    Q_UNUSED(available);
+    m_memoryBudget = budget / (1024.0f * 1024.0f * 1024.0f);
+    m_processMemory = usage / (1024.0f * 1024.0f * 1024.0f);
+    emit memoryGovernorChanged();
+}
+
+void ModelInfo::setStateCache(qint64 memoryBytes, qint64 diskBytes)
+{
+    m_stateCacheMemory = memoryBytes / (1024.0f * 1024.0f);
+    m_stateCacheDisk = diskBytes / (1024.0f * 1024.0f);
+    emit memoryGovernorChanged();
+}
+
+void ModelInfo::setContextLength(int nCtx)
+{
+    m_contextLength = nCtx;
+    emit memoryGovernorChanged();
+}
+
+void ModelInfo::recordEviction(const QString &chatId, const QString &action, qint64 bytes)
+{
+    m_evictionCount++;
+    m_lastEviction = QDateTime::currentDateTime().toString("HH:mm:ss") + " " + action + " "
+                     + QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+    qDebug() << "State eviction:" << action << chatId << bytes << "bytes";
+    emit memoryGovernorChanged();
+    emit stateEvicted(chatId, action, bytes);
+}
+
+void ModelInfo::setCpuName(const QString &name)
+{
+    m_cpuName = name;
+    emit cpuMetricsChanged();
+}
+
+void ModelInfo::applySystemSample(qint64 totalBytes, qint64 availableBytes, int cpuUsage,
+                                  int clockMHz, int temperature)
+{
+    const float gb = 1024.0f * 1024.0f * 1024.0f;
+    if (totalBytes > 0) {
+        m_memoryTotal = totalBytes / gb;
+        m_memoryUsed = availableBytes >= 0 ? (totalBytes - availableBytes) / gb : 0.0f;
+        m_memoryPercent = static_cast<int>((m_memoryUsed / m_memoryTotal) * 100);
+        refreshModelEstimates(false);
+    }
+
+    m_cpuUsage = cpuUsage;
+    m_cpuClock = clockMHz;
+    m_cpuCurrentFreq = clockMHz;
+    m_cpuTemp = temperature;
+
+    emit cpuMetricsChanged();
+    emit statsChanged();
+}
+
+void ModelInfo::applyInferenceThreadSample(int threadCount, int averageUsage, int minUsage,
+                                           int preemptionsPerSec)
+{
+    m_inferenceThreadCount = threadCount;
+    m_inferenceCpuUsage = averageUsage;
+    m_inferencePreemptions = preemptionsPerSec;
+
+    // Polling decode threads sit near 100% while generating; a thread that
+    // gets much less is being descheduled and holds up the whole batch
+    bool generating = (m_status == "Generating");
+    bool starved = generating && threadCount > 0 && (averageUsage < 70 || minUsage < 40);
+    if (starved && !m_decodeStarved) {
+        qDebug() << "Decode threads starved: avg" << averageUsage << "% min" << minUsage
+                 << "%," << preemptionsPerSec << "preemptions/s";
+    }
+    m_decodeStarved = starved;
+
+    emit cpuMetricsChanged();
+}
+
+void ModelInfo::setThreadingInfo(const QString &topology, const QString &pinning)
+{
+    m_numaTopology = topology;
+    m_threadPinning = pinning;
+    emit threadingChanged();
+}
+
+void ModelInfo::setNumaStrategy(const QString &strategy)
+{
+    if (m_numaStrategy != strategy) {
+        m_numaStrategy = strategy;
+        emit threadingChanged();
+        saveSettings();
+    }
+}
+
+void ModelInfo::setThreadPriority(const QString &priority)
+{
+    if (m_threadPriority != priority) {
+        m_threadPriority = priority;
+        emit threadingChanged();
+        saveSettings();
+    }
+}
+
 void ModelInfo::updateCurrentStats()
 {
-    // Update RAM info (always works, independent of model)
+    // Update RAM info (always works, independent of model). Elsewhere the
+    // SystemSampler pushes it from the monitor thread.
 #ifdef _WIN32
     MEMORYSTATUSEX memInfo;
     memInfo.dwLength = sizeof(MEMORYSTATUSEX);
@@ -350,14 +514,11 @@ void ModelInfo::updateCurrentStats()
         m_memoryTotal = memInfo.ullTotalPhys / (1024.0f * 1024.0f * 1024.0f);
         m_memoryUsed = (memInfo.ullTotalPhys - memInfo.ullAvailPhys) / (1024.0f * 1024.0f * 1024.0f);
         m_memoryPercent = memInfo.dwMemoryLoad;
+        refreshModelEstimates(false);
     }
-#else
-    m_memoryTotal = 8.0f;
-    m_memoryUsed = 2.5f;
-    m_memoryPercent = static_cast<int>((m_memoryUsed / m_memoryTotal) * 100);
 #endif
 
-    if (!m_ctx || !m_isLoaded) {
+    if (!m_isLoaded) {
         m_status = "Idle";
         m_speed = 0.0f;
         m_tokensIn = 0;
@@ -366,21 +527,19 @@ void ModelInfo::updateCurrentStats()
         return;
     }
 
-    struct llama_perf_context_data perf = llama_perf_context(m_ctx);
-
-    bool isGenerating = (perf.n_eval > m_tokensOut);
+    bool isGenerating = (m_perfEvalTokens > m_tokensOut);
     m_status = isGenerating ? "Generating" : "Idle";
 
-    if (perf.n_eval > 0 && perf.t_eval_ms > 0) {
-        m_speed = (perf.n_eval * 1000.0) / perf.t_eval_ms;
+    if (m_perfEvalTokens > 0 && m_perfEvalMs > 0) {
+        m_speed = (m_perfEvalTokens * 1000.0) / m_perfEvalMs;
 
         if (isGenerating) {
             emit speedDataPoint(m_speed);
         }
     }
 
-    m_tokensIn = perf.n_p_eval;
-    m_tokensOut = perf.n_eval;
+    m_tokensIn = m_perfPromptTokens;
+    m_tokensOut = m_perfEvalTokens;
 
     emit statsChanged();
 }
@@ -545,76 +704,154 @@ void ModelInfo::setAutoLoadModelPath(const QString &path)
 
 void ModelInfo::scanModelsFolder()
 {
+    if (m_modelsFolder != m_indexedFolder) {
+        m_indexedFolder = m_modelsFolder;
+        m_indexedModels.clear();
+        applyModelIndex(m_indexedModels);
+        emit requestIndexFolder(m_modelsFolder);
+    } else {
+        // Refresh flags right away; the index reports any file changes itself
+        applyModelIndex(m_indexedModels);
+        emit requestIndexRescan();
+    }
+}
+
+void ModelInfo::applyModelIndex(const QVariantList &models)
+{
+    m_indexedModels = models;
     m_availableModels.clear();
 
-    if (m_modelsFolder.isEmpty()) {
-        emit availableModelsChanged();
-        return;
+    for (const QVariant &entry : models) {
+        QVariantMap modelData = entry.toMap();
+        modelData["isAutoLoad"] = (modelData.value("fullPath").toString() == m_autoLoadModelPath);
+        modelData["isResident"] = false;
+        for (const QVariant &resident : std::as_const(m_residentModels)) {
+            if (resident.toMap().value("fullPath") == modelData.value("fullPath")) {
+                modelData["isResident"] = true;
+            }
+        }
+        m_availableModels.append(modelData);
     }
 
-    QDir dir(m_modelsFolder);
-    if (!dir.exists()) {
-        qWarning() << "Models folder does not exist:" << m_modelsFolder;
-        emit availableModelsChanged();
-        return;
+    refreshModelEstimates(true);
+}
+
+void ModelInfo::setResidentModels(const QVariantList &models)
+{
+    const double gb = 1024.0 * 1024.0 * 1024.0;
+    m_residentModels.clear();
+    qint64 total = 0;
+
+    for (const QVariant &entry : models) {
+        QVariantMap model = entry.toMap();
+        qint64 footprint = model.value("footprintBytes").toLongLong();
+        model["footprint"] = QString::number(footprint / gb, 'f', 1) + " GB";
+        total += footprint;
+        m_residentModels.append(model);
     }
 
-    QStringList filters;
-    filters << "*.gguf";
-    QFileInfoList fileList = dir.entryInfoList(filters, QDir::Files, QDir::Name);
+    m_residentMemory = total / gb;
+    emit residentModelsChanged();
 
-    for (const QFileInfo &fileInfo : fileList) {
-        ModelFileInfo modelInfo = parseModelFile(fileInfo.absoluteFilePath());
+    // Refresh the RESIDENT badges in the model list
+    applyModelIndex(m_indexedModels);
+}
+
+void ModelInfo::setLoraAdapters(const QVariantList &adapters, const QString &activePath, float scale)
+{
+    m_loraAdapters = adapters;
+    m_activeLora = activePath;
+    m_loraScale = scale;
+    emit loraAdaptersChanged();
+}
 
-        QVariantMap modelData;
-        modelData["fileName"] = modelInfo.fileName;
-        modelData["fullPath"] = modelInfo.fullPath;
-        modelData["size"] = modelInfo.sizeString;
-        modelData["parameters"] = modelInfo.parameters;
-        modelData["isAutoLoad"] = (modelInfo.fullPath == m_autoLoadModelPath);
+void ModelInfo::startBandwidthProbe()
+{
+    // Decode uses one thread per physical core; measure with the same count
+    const CpuTopology topology = CpuTopology::detect();
+    const int threads = qMax(1, static_cast<int>(topology.physicalCpus(topology.allowedCpus()).size()));
+    const QString host = QString::fromLatin1(QSysInfo::machineUniqueId()) + "/" + QString::number(threads);
 
-        m_availableModels.append(modelData);
+    QSettings settings("YourCompany", "AIChatGUI");
+    double cached = settings.value("memoryBandwidth", 0.0).toDouble();
+    if (cached > 0 && settings.value("memoryBandwidthHost").toString() == host) {
+        setMemoryBandwidth(cached);
+        return;
     }
 
-    qDebug() << "Found" << m_availableModels.count() << "models in" << m_modelsFolder;
-    emit availableModelsChanged();
+    m_bandwidthThread = QThread::create([this, threads, host]() {
+        double bandwidth = ModelEstimator::measureMemoryBandwidth(threads);
+        QMetaObject::invokeMethod(this, [this, bandwidth, host]() {
+            if (bandwidth > 0) {
+                QSettings settings("YourCompany", "AIChatGUI");
+                settings.setValue("memoryBandwidth", bandwidth);
+                settings.setValue("memoryBandwidthHost", host);
+            }
+            setMemoryBandwidth(bandwidth);
+        }, Qt::QueuedConnection);
+    });
+    m_bandwidthThread->setParent(this);
+    m_bandwidthThread->setObjectName("BandwidthProbe");
+    m_bandwidthThread->start(QThread::LowPriority);
 }
 
-ModelInfo::ModelFileInfo ModelInfo::parseModelFile(const QString &filePath)
+void ModelInfo::setMemoryBandwidth(double bytesPerSec)
 {
-    ModelFileInfo info;
-    QFileInfo fileInfo(filePath);
-
-    info.fileName = fileInfo.fileName();
-    info.fullPath = fileInfo.absoluteFilePath();
-    info.sizeBytes = fileInfo.size();
+    m_memoryBandwidth = bytesPerSec / 1e9;
+    qDebug() << "Memory bandwidth:" << m_memoryBandwidth << "GB/s";
+    emit memoryBandwidthChanged();
+    refreshModelEstimates(true);
+}
 
-    double sizeGB = info.sizeBytes / (1024.0 * 1024.0 * 1024.0);
-    if (sizeGB >= 1.0) {
-        info.sizeString = QString::number(sizeGB, 'f', 1) + " GB";
-    } else {
-        double sizeMB = info.sizeBytes / (1024.0 * 1024.0);
-        info.sizeString = QString::number(sizeMB, 'f', 0) + " MB";
+void ModelInfo::refreshModelEstimates(bool force)
+{
+    // The worker starts every model at this context
+    static const int PLANNED_CONTEXT = 4096;
+    const double gb = 1024.0 * 1024.0 * 1024.0;
+
+    // Loading a model replaces the current one, so its memory counts as free
+    qint64 availableBytes = 0;
+    if (m_memoryTotal > 0) {
+        float reclaimable = m_isLoaded ? m_modelMemoryUsed : 0.0f;
+        availableBytes = static_cast<qint64>((m_memoryTotal - m_memoryUsed + reclaimable) * gb);
     }
 
-    // Extract parameters from filename (e.g., "7b", "13b", "70b")
-    QString fileName = info.fileName.toLower();
-    QRegularExpression paramRegex("(\\d+\\.?\\d*)b");
-    QRegularExpressionMatch match = paramRegex.match(fileName);
+    bool changed = force;
+    for (QVariant &entry : m_availableModels) {
+        QVariantMap model = entry.toMap();
+        GgufInfo info = GgufInfo::fromVariantMap(model.value("gguf").toMap());
+        if (!info.valid || info.isAdapter()) {
+            continue;
+        }
 
-    if (match.hasMatch()) {
-        QString paramValue = match.captured(1);
-        double params = paramValue.toDouble();
-        if (params >= 1.0) {
-            info.parameters = QString::number(params, 'f', (params < 10 ? 1 : 0)) + "B";
-        } else {
-            info.parameters = QString::number(params * 1000, 'f', 0) + "M";
+        ModelEstimate estimate = ModelEstimator::estimate(info, PLANNED_CONTEXT, m_memoryBandwidth * 1e9);
+
+        QString fit = "unknown";
+        if (availableBytes > 0) {
+            if (estimate.residentBytes <= availableBytes * 0.8) {
+                fit = "fits";
+            } else if (estimate.residentBytes <= availableBytes) {
+                fit = "tight";
+            } else {
+                fit = "swap";
+            }
         }
-    } else {
-        info.parameters = "Unknown";
+
+        if (!force && model.value("fit").toString() == fit) {
+            continue;
+        }
+
+        model["estimatedMemoryBytes"] = estimate.residentBytes;
+        model["estimatedMemory"] = QString::number(estimate.residentBytes / gb, 'f', 1) + " GB";
+        model["estimatedSpeed"] = estimate.decodeTokensPerSec;
+        model["fit"] = fit;
+        entry = model;
+        changed = true;
     }
 
-    return info;
+    if (changed) {
+        emit availableModelsChanged();
+    }
 }
 
 void ModelInfo::saveSettings()
@@ -622,6 +859,10 @@ void ModelInfo::saveSettings()
     QSettings settings("YourCompany", "AIChatGUI");
     settings.setValue("modelsFolder", m_modelsFolder);
     settings.setValue("autoLoadModelPath", m_autoLoadModelPath);
+    settings.setValue("numaStrategy", m_numaStrategy);
+    settings.setValue("threadPriority", m_threadPriority);
+    settings.setValue("memoryBudgetMB", m_memoryBudgetMB);
+    settings.setValue("recordRequests", m_recordRequests);
     qDebug() << "Settings saved - Folder:" << m_modelsFolder << "AutoLoad:" << m_autoLoadModelPath;
 }
 
@@ -630,6 +871,10 @@ void ModelInfo::loadSettings()
     QSettings settings("YourCompany", "AIChatGUI");
     m_modelsFolder = settings.value("modelsFolder", "").toString();
     m_autoLoadModelPath = settings.value("autoLoadModelPath", "").toString();
+    m_numaStrategy = settings.value("numaStrategy", "disabled").toString();
+    m_threadPriority = settings.value("threadPriority", "normal").toString();
+    m_memoryBudgetMB = settings.value("memoryBudgetMB", 0).toInt();
+    m_recordRequests = settings.value("recordRequests", false).toBool();
 
     if (!m_modelsFolder.isEmpty()) {
         scanModelsFolder();
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QString>
 #include <QTimer>
+#include <QThread>
 #include <llama.h>
 #include <QAbstractListModel>
 
@@ -91,13 +92,43 @@ class ModelInfo : public QObject
     Q_PROPERTY(int cpuTemp READ cpuTemp NOTIFY cpuMetricsChanged)
     Q_PROPERTY(int cpuUsage READ cpuUsage NOTIFY cpuMetricsChanged)
     Q_PROPERTY(int cpuClock READ cpuClock NOTIFY cpuMetricsChanged)
+    Q_PROPERTY(int inferenceThreadCount READ inferenceThreadCount NOTIFY cpuMetricsChanged)
+    Q_PROPERTY(int inferenceCpuUsage READ inferenceCpuUsage NOTIFY cpuMetricsChanged)
+    Q_PROPERTY(int inferencePreemptions READ inferencePreemptions NOTIFY cpuMetricsChanged)
+    Q_PROPERTY(bool decodeStarved READ decodeStarved NOTIFY cpuMetricsChanged)
+    // Backend
+    Q_PROPERTY(QString cpuBackend READ cpuBackend NOTIFY backendInfoChanged)
+    Q_PROPERTY(QString cpuIsa READ cpuIsa NOTIFY backendInfoChanged)
+    Q_PROPERTY(QString cpuFeatures READ cpuFeatures NOTIFY backendInfoChanged)
+    // Threading (NUMA strategy and priority apply on next start)
+    Q_PROPERTY(QString numaStrategy READ numaStrategy WRITE setNumaStrategy NOTIFY threadingChanged)
+    Q_PROPERTY(QString threadPriority READ threadPriority WRITE setThreadPriority NOTIFY threadingChanged)
+    Q_PROPERTY(QString numaTopology READ numaTopology NOTIFY threadingChanged)
+    Q_PROPERTY(QString threadPinning READ threadPinning NOTIFY threadingChanged)
+    Q_PROPERTY(bool recordRequests READ recordRequests WRITE setRecordRequests NOTIFY recordRequestsChanged)
     // RAM
     Q_PROPERTY(float modelMemoryUsed READ modelMemoryUsed NOTIFY statsChanged)
 
+    // Memory governor
+    Q_PROPERTY(int memoryBudgetMB READ memoryBudgetMB WRITE setMemoryBudgetMB NOTIFY memoryBudgetMBChanged)
+    Q_PROPERTY(float memoryBudget READ memoryBudget NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(float processMemory READ processMemory NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(float stateCacheMemory READ stateCacheMemory NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(float stateCacheDisk READ stateCacheDisk NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(int contextLength READ contextLength NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(int evictionCount READ evictionCount NOTIFY memoryGovernorChanged)
+    Q_PROPERTY(QString lastEviction READ lastEviction NOTIFY memoryGovernorChanged)
+
     // Model list properties
     Q_PROPERTY(QString modelsFolder READ modelsFolder WRITE setModelsFolder NOTIFY modelsFolderChanged)
     Q_PROPERTY(QVariantList availableModels READ availableModels NOTIFY availableModelsChanged)
     Q_PROPERTY(QString autoLoadModelPath READ autoLoadModelPath WRITE setAutoLoadModelPath NOTIFY autoLoadModelPathChanged)
+    Q_PROPERTY(float memoryBandwidth READ memoryBandwidth NOTIFY memoryBandwidthChanged)
+    Q_PROPERTY(QVariantList residentModels READ residentModels NOTIFY residentModelsChanged)
+    Q_PROPERTY(float residentMemory READ residentMemory NOTIFY residentModelsChanged)
+    Q_PROPERTY(QVariantList loraAdapters READ loraAdapters NOTIFY loraAdaptersChanged)
+    Q_PROPERTY(QString activeLora READ activeLora NOTIFY loraAdaptersChanged)
+    Q_PROPERTY(float loraScale READ loraScale NOTIFY loraAdaptersChanged)
 
 public:
     explicit ModelInfo(QObject *parent = nullptr);
@@ -108,6 +139,8 @@ public:
     void updateStats(llama_context *ctx);
     void recordGeneration(int n_tokens, double duration_ms);
     void setGenerating(bool generating);
+    void setBackendInfo(const QString &backend, const QString &isa, const QString &features);
+    void setThreadingInfo(const QString &topology, const QString &pinning);
 
     QObject* requestLog() const { return m_requestLog; }
 
@@ -149,16 +182,52 @@ public:
     int cpuTemp() const { return m_cpuTemp; }
     int cpuUsage() const { return m_cpuUsage; }
     int cpuClock() const { return m_cpuClock; }
+    int inferenceThreadCount() const { return m_inferenceThreadCount; }
+    int inferenceCpuUsage() const { return m_inferenceCpuUsage; }
+    int inferencePreemptions() const { return m_inferencePreemptions; }
+    bool decodeStarved() const { return m_decodeStarved; }
+
+    // Backend getters
+    QString cpuBackend() const { return m_cpuBackend; }
+    QString cpuIsa() const { return m_cpuIsa; }
+    QString cpuFeatures() const { return m_cpuFeatures; }
+
+    // Threading getters
+    QString numaStrategy() const { return m_numaStrategy; }
+    void setNumaStrategy(const QString &strategy);
+    QString threadPriority() const { return m_threadPriority; }
+    void setThreadPriority(const QString &priority);
+    QString numaTopology() const { return m_numaTopology; }
+    QString threadPinning() const { return m_threadPinning; }
 
     // RAM getters
     float modelMemoryUsed() const { return m_modelMemoryUsed; }
 
+    // Memory governor getters
+    int memoryBudgetMB() const { return m_memoryBudgetMB; }
+    bool recordRequests() const { return m_recordRequests; }
+    void setRecordRequests(bool enabled);
+    void setMemoryBudgetMB(int budgetMB);
+    float memoryBudget() const { return m_memoryBudget; }
+    float processMemory() const { return m_processMemory; }
+    float stateCacheMemory() const { return m_stateCacheMemory; }
+    float stateCacheDisk() const { return m_stateCacheDisk; }
+    int contextLength() const { return m_contextLength; }
+    int evictionCount() const { return m_evictionCount; }
+    QString lastEviction() const { return m_lastEviction; }
+
     // Model list
     QString modelsFolder() const { return m_modelsFolder; }
     void setModelsFolder(const QString &folder);
     QVariantList availableModels() const { return m_availableModels; }
     QString autoLoadModelPath() const { return m_autoLoadModelPath; }
     void setAutoLoadModelPath(const QString &path);
+    float memoryBandwidth() const { return m_memoryBandwidth; }
+    QVariantList residentModels() const { return m_residentModels; }
+    float residentMemory() const { return m_residentMemory; }
+    QVariantList loraAdapters() const { return m_loraAdapters; }
+    QString activeLora() const { return m_activeLora; }
+    float loraScale() const { return m_loraScale; }
 
     Q_INVOKABLE void scanModelsFolder();
     Q_INVOKABLE void saveSettings();
@@ -170,12 +239,34 @@ signals:
     void speedDataPoint(float speed);
     void gpuMetricsChanged();
     void cpuMetricsChanged();
+    void backendInfoChanged();
+    void threadingChanged();
+    void memoryGovernorChanged();
+    void memoryBudgetMBChanged(int budgetMB);
+    void recordRequestsChanged(bool enabled);
+    void stateEvicted(const QString &chatId, const QString &action, qint64 bytes);
     void modelsFolderChanged();
     void availableModelsChanged();
     void autoLoadModelPathChanged();
+    void memoryBandwidthChanged();
+    void residentModelsChanged();
+    void loraAdaptersChanged();
+    void requestIndexFolder(const QString &folder);
+    void requestIndexRescan();
 
 public slots:
     void updateCurrentStats();
+    void updatePerf(int promptTokens, int evalTokens, double evalMs);
+    void setMemoryUsage(qint64 budget, qint64 usage, qint64 available);
+    void setStateCache(qint64 memoryBytes, qint64 diskBytes);
+    void setContextLength(int nCtx);
+    void recordEviction(const QString &chatId, const QString &action, qint64 bytes);
+    void setCpuName(const QString &name);
+    void applyModelIndex(const QVariantList &models);
+    void setResidentModels(const QVariantList &models);
+    void setLoraAdapters(const QVariantList &adapters, const QString &activePath, float scale);
+    void applySystemSample(qint64 totalBytes, qint64 availableBytes, int cpuUsage, int clockMHz, int temperature);
+    void applyInferenceThreadSample(int threadCount, int averageUsage, int minUsage, int preemptionsPerSec);
 
 private:
     bool m_isLoaded = false;
@@ -201,7 +292,11 @@ private:
     int m_tokensOut = 0;
 
     QTimer *m_statsTimer;
-    llama_context *m_ctx = nullptr;
+
+    // Last perf counters pushed by the worker; the GUI never touches the context
+    int m_perfPromptTokens = 0;
+    int m_perfEvalTokens = 0;
+    double m_perfEvalMs = 0.0;
 
     RequestLogModel *m_requestLog;
 
@@ -231,26 +326,67 @@ private:
     int m_cpuUsage = 0;
     int m_cpuClock = 0; // MHz
 
+    // Inference threads (Linux sampler)
+    int m_inferenceThreadCount = 0;
+    int m_inferenceCpuUsage = 0;     // average %, per thread
+    int m_inferencePreemptions = 0;  // involuntary switches/s
+    bool m_decodeStarved = false;
+
     void updateCPUMetrics();
     int m_cpuBaseFreq = 0;  // MHz
     int m_cpuCurrentFreq = 0;  // MHz
 
+    // Backend selected at startup
+    QString m_cpuBackend = "N/A";
+    QString m_cpuIsa = "N/A";
+    QString m_cpuFeatures;
+
+    // Threading
+    QString m_numaStrategy = "disabled";  // disabled, distribute, isolate, numactl
+    QString m_threadPriority = "normal";  // normal, medium, high
+    QString m_numaTopology = "N/A";
+    QString m_threadPinning = "N/A";
+
+    // Record every request for the replay harness
+    bool m_recordRequests = false;
+
     float m_modelMemoryUsed = 0.0f;
 
+    // Memory governor
+    int m_memoryBudgetMB = 0;  // 0 = automatic
+    float m_memoryBudget = 0.0f;
+    float m_processMemory = 0.0f;
+    float m_stateCacheMemory = 0.0f;  // MB
+    float m_stateCacheDisk = 0.0f;    // MB
+    int m_contextLength = 0;
+    int m_evictionCount = 0;
+    QString m_lastEviction = "-";
+
     // Model list
     QString m_modelsFolder;
     QVariantList m_availableModels;
     QString m_autoLoadModelPath;
 
-    struct ModelFileInfo {
-        QString fileName;
-        QString fullPath;
-        qint64 sizeBytes;
-        QString sizeString;
-        QString parameters; // Extracted from file name
-    };
-
-    ModelFileInfo parseModelFile(const QString &filePath);
+    // GGUF header index, maintained on its own thread
+    QThread m_indexThread;
+    QVariantList m_indexedModels;
+    QString m_indexedFolder;
+
+    // Pre-load estimates (fit and decode speed) for m_availableModels
+    void startBandwidthProbe();
+    void setMemoryBandwidth(double bytesPerSec);
+    void refreshModelEstimates(bool force);
+    float m_memoryBandwidth = 0.0f;  // GB/s, 0 until measured
+    QThread *m_bandwidthThread = nullptr;
+
+    // Models the worker keeps loaded, active one first
+    QVariantList m_residentModels;
+    float m_residentMemory = 0.0f;  // GB
+
+    // LoRA adapters attached to the loaded model
+    QVariantList m_loraAdapters;
+    QString m_activeLora;  // empty = base model
+    float m_loraScale = 1.0f;
 };
 
 #endif // MODELINFO_H
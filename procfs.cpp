@@ -0,0 +1,384 @@
+#include "procfs.h"
+#include <QFile>
+#include <QByteArray>
+#include <QDir>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ProcFs {
+
+static QByteArray readFile(const char *path)
+{
+    QFile file(QString::fromLatin1(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    // procfs files report size 0, so read until EOF
+    return file.readAll();
+}
+
+// Value of "Key:   1234" lines (optionally with a "kB" unit)
+static qint64 numberField(const QByteArray &data, const QByteArray &key)
+{
+    int pos = data.indexOf(key);
+    if (pos < 0) {
+        return -1;
+    }
+    pos += key.size();
+    int end = data.indexOf('\n', pos);
+    QByteArray value = data.mid(pos, end < 0 ? -1 : end - pos).trimmed();
+    if (value.endsWith("kB")) {
+        value.chop(2);
+    }
+    bool ok = false;
+    qint64 number = value.trimmed().toLongLong(&ok);
+    return ok ? number : -1;
+}
+
+// Value of "Key:   1234 kB" lines, in bytes
+static qint64 kbField(const QByteArray &data, const QByteArray &key)
+{
+    qint64 kb = numberField(data, key);
+    return kb >= 0 ? kb * 1024 : -1;
+}
+
+static qint64 readNumber(const char *path)
+{
+    QByteArray data = readFile(path).trimmed();
+    if (data.isEmpty() || data == "max") {
+        return -1;
+    }
+    bool ok = false;
+    qint64 value = data.toLongLong(&ok);
+    return ok ? value : -1;
+}
+
+bool readMemInfo(MemInfo &info)
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX memInfo;
+    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+    if (!GlobalMemoryStatusEx(&memInfo)) {
+        return false;
+    }
+    info.totalBytes = memInfo.ullTotalPhys;
+    info.availableBytes = memInfo.ullAvailPhys;
+    return true;
+#else
+    QByteArray data = readFile("/proc/meminfo");
+    if (data.isEmpty()) {
+        return false;
+    }
+    info.totalBytes = kbField(data, "MemTotal:");
+    info.availableBytes = kbField(data, "MemAvailable:");
+    return info.totalBytes > 0;
+#endif
+}
+
+qint64 processRss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return -1;
+#else
+    return kbField(readFile("/proc/self/status"), "VmRSS:");
+#endif
+}
+
+#ifndef _WIN32
+// The process's own memory cgroup: the directory holding its limit and
+// usage files, and the mount point above which the hierarchy isn't visible
+struct MemoryCgroup {
+    QByteArray mountPoint;
+    QByteArray dir;
+    bool v2 = true;
+};
+
+static MemoryCgroup resolveMemoryCgroup()
+{
+    // "hierarchy-id:controllers:path"; v2 is "0::/path", a v1 memory
+    // hierarchy lists "memory" among its controllers and wins on hybrid hosts
+    QByteArray v1Path;
+    QByteArray v2Path;
+    const QList<QByteArray> lines = readFile("/proc/self/cgroup").split('\n');
+    for (const QByteArray &line : lines) {
+        int first = line.indexOf(':');
+        int second = line.indexOf(':', first + 1);
+        if (first < 0 || second < 0) {
+            continue;
+        }
+        QByteArray controllers = line.mid(first + 1, second - first - 1);
+        if (line.left(first) == "0" && controllers.isEmpty()) {
+            v2Path = line.mid(second + 1);
+        } else if (controllers.split(',').contains("memory")) {
+            v1Path = line.mid(second + 1);
+        }
+    }
+
+    MemoryCgroup cgroup;
+    cgroup.v2 = v1Path.isEmpty();
+    const QByteArray path = cgroup.v2 ? v2Path : v1Path;
+
+    // "id parent major:minor root mount-point options ... - type source super-options".
+    // A container without its own cgroup namespace mounts a subtree, so the
+    // path is taken relative to the mount's root
+    const QList<QByteArray> mounts = readFile("/proc/self/mountinfo").split('\n');
+    for (const QByteArray &line : mounts) {
+        int dash = line.indexOf(" - ");
+        if (dash < 0) {
+            continue;
+        }
+        const QList<QByteArray> fields = line.left(dash).split(' ');
+        const QList<QByteArray> tail = line.mid(dash + 3).split(' ');
+        if (fields.size() < 5 || tail.size() < 3) {
+            continue;
+        }
+        bool matches = cgroup.v2 ? tail[0] == "cgroup2"
+                                 : tail[0] == "cgroup" && tail[2].split(',').contains("memory");
+        if (!matches) {
+            continue;
+        }
+
+        const QByteArray &root = fields[3];
+        cgroup.mountPoint = fields[4];
+        QByteArray relative = path;
+        if (root != "/") {
+            relative = path.startsWith(root + "/") || path == root ? path.mid(root.size()) : QByteArray();
+        }
+        while (relative.endsWith('/')) {
+            relative.chop(1);
+        }
+        cgroup.dir = cgroup.mountPoint + relative;
+        return cgroup;
+    }
+
+    // No mount information: the usual locations, as seen from a namespace root
+    cgroup.mountPoint = cgroup.v2 ? "/sys/fs/cgroup" : "/sys/fs/cgroup/memory";
+    cgroup.dir = cgroup.mountPoint;
+    return cgroup;
+}
+
+// A process doesn't change cgroups during its lifetime here, so resolved once
+static const MemoryCgroup &memoryCgroup()
+{
+    static const MemoryCgroup cgroup = resolveMemoryCgroup();
+    return cgroup;
+}
+
+// Any ancestor's limit applies too, so the tightest one up to the mount
+// point wins. v1 reports "unlimited" as a huge page-aligned number
+static qint64 tightestMemoryLimit(QByteArray *limitDir)
+{
+    const MemoryCgroup &cgroup = memoryCgroup();
+    const char *file = cgroup.v2 ? "/memory.max" : "/memory.limit_in_bytes";
+    qint64 tightest = -1;
+    QByteArray dir = cgroup.dir;
+    while (true) {
+        qint64 limit = readNumber((dir + file).constData());
+        if (limit >= (Q_INT64_C(1) << 60)) {
+            limit = -1;
+        }
+        if (limit > 0 && (tightest < 0 || limit < tightest)) {
+            tightest = limit;
+            *limitDir = dir;
+        }
+        if (dir.size() <= cgroup.mountPoint.size()) {
+            break;
+        }
+        dir.truncate(dir.lastIndexOf('/'));
+    }
+    return tightest;
+}
+#endif
+
+qint64 cgroupMemoryLimit()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    QByteArray dir;
+    return tightestMemoryLimit(&dir);
+#endif
+}
+
+qint64 cgroupMemoryUsage()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    // The charge of the cgroup whose limit applies, which includes any
+    // sibling processes sharing it
+    const MemoryCgroup &cgroup = memoryCgroup();
+    QByteArray dir = cgroup.dir;
+    tightestMemoryLimit(&dir);
+    return readNumber((dir + (cgroup.v2 ? "/memory.current" : "/memory.usage_in_bytes")).constData());
+#endif
+}
+
+bool readCpuTimes(CpuTimes &times)
+{
+#ifdef Q_OS_LINUX
+    QByteArray data = readFile("/proc/stat");
+    int end = data.indexOf('\n');
+    QList<QByteArray> fields = data.left(end).simplified().split(' ');
+    if (fields.size() < 5 || fields.first() != "cpu") {
+        return false;
+    }
+
+    times = CpuTimes();
+    for (int i = 1; i < fields.size(); ++i) {
+        quint64 value = fields[i].toULongLong();
+        times.total += value;
+        if (i == 4 || i == 5) {  // idle + iowait
+            times.idle += value;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(times);
+    return false;
+#endif
+}
+
+QString cpuModelName()
+{
+#ifdef Q_OS_LINUX
+    const QList<QByteArray> lines = readFile("/proc/cpuinfo").split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("model name") || line.startsWith("Model")) {
+            int colon = line.indexOf(':');
+            if (colon > 0) {
+                return QString::fromUtf8(line.mid(colon + 1)).trimmed();
+            }
+        }
+    }
+#endif
+    return QString();
+}
+
+int cpuFrequencyMHz()
+{
+#ifdef Q_OS_LINUX
+    // Average current frequency across online CPUs, kHz in sysfs
+    QDir cpuDir("/sys/devices/system/cpu");
+    const QStringList cpus = cpuDir.entryList(QStringList() << "cpu[0-9]*", QDir::Dirs);
+    qint64 sum = 0;
+    int count = 0;
+    for (const QString &cpu : cpus) {
+        QByteArray path = cpuDir.filePath(cpu + "/cpufreq/scaling_cur_freq").toLocal8Bit();
+        qint64 khz = readNumber(path.constData());
+        if (khz > 0) {
+            sum += khz;
+            count++;
+        }
+    }
+    if (count > 0) {
+        return static_cast<int>(sum / count / 1000);
+    }
+
+    // No cpufreq (VMs): fall back to the value the kernel printed in cpuinfo
+    const QList<QByteArray> lines = readFile("/proc/cpuinfo").split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("cpu MHz")) {
+            return static_cast<int>(line.mid(line.indexOf(':') + 1).trimmed().toDouble());
+        }
+    }
+#endif
+    return 0;
+}
+
+int cpuTemperature()
+{
+#ifdef Q_OS_LINUX
+    static const QStringList cpuSensors = {"coretemp", "k10temp", "zenpower", "cpu_thermal", "x86_pkg_temp"};
+
+    QDir hwmonDir("/sys/class/hwmon");
+    const QStringList entries = hwmonDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        QByteArray namePath = hwmonDir.filePath(entry + "/name").toLocal8Bit();
+        QString name = QString::fromLatin1(readFile(namePath.constData())).trimmed();
+        if (!cpuSensors.contains(name)) continue;
+
+        // temp1 is the package / Tctl sensor on the common drivers
+        QByteArray tempPath = hwmonDir.filePath(entry + "/temp1_input").toLocal8Bit();
+        qint64 milliC = readNumber(tempPath.constData());
+        if (milliC > 0) {
+            return static_cast<int>(milliC / 1000);
+        }
+    }
+
+    QDir thermalDir("/sys/class/thermal");
+    const QStringList zones = thermalDir.entryList(QStringList() << "thermal_zone*", QDir::Dirs);
+    for (const QString &zone : zones) {
+        QByteArray typePath = thermalDir.filePath(zone + "/type").toLocal8Bit();
+        QString type = QString::fromLatin1(readFile(typePath.constData())).trimmed();
+        if (type == "x86_pkg_temp" || type.startsWith("cpu")) {
+            QByteArray tempPath = thermalDir.filePath(zone + "/temp").toLocal8Bit();
+            qint64 milliC = readNumber(tempPath.constData());
+            if (milliC > 0) {
+                return static_cast<int>(milliC / 1000);
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+QList<ThreadStat> threadStats(const QString &nameFilter)
+{
+    QList<ThreadStat> result;
+
+#ifdef Q_OS_LINUX
+    QDir taskDir("/proc/self/task");
+    const QStringList tids = taskDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &tid : tids) {
+        QByteArray stat = readFile(taskDir.filePath(tid + "/stat").toLocal8Bit().constData());
+
+        // "tid (comm) state ..." - comm may contain spaces, so split on the parens
+        int open = stat.indexOf('(');
+        int close = stat.lastIndexOf(')');
+        if (open < 0 || close < open) continue;
+
+        QString name = QString::fromUtf8(stat.mid(open + 1, close - open - 1));
+        if (!nameFilter.isEmpty() && name != nameFilter) continue;
+
+        // Fields after comm start at "state" (field 3); utime/stime are 14/15
+        QList<QByteArray> fields = stat.mid(close + 2).split(' ');
+        if (fields.size() < 13) continue;
+
+        ThreadStat ts;
+        ts.tid = tid.toInt();
+        ts.name = name;
+        ts.cpuTicks = fields[11].toULongLong() + fields[12].toULongLong();
+
+        QByteArray status = readFile(taskDir.filePath(tid + "/status").toLocal8Bit().constData());
+        qint64 switches = numberField(status, "nonvoluntary_ctxt_switches:");
+        ts.involuntarySwitches = switches > 0 ? quint64(switches) : 0;
+
+        result.append(ts);
+    }
+#else
+    Q_UNUSED(nameFilter);
+#endif
+
+    return result;
+}
+
+qint64 clockTicksPerSecond()
+{
+#ifdef _WIN32
+    return 100;
+#else
+    return sysconf(_SC_CLK_TCK);
+#endif
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+
+// Lightweight readers for kernel memory and CPU accounting. On Linux these
+// parse /proc, sysfs and the cgroup filesystem; elsewhere they fall back to
+// the OS API where one exists. Byte values, -1 when unknown/unlimited.
+namespace ProcFs {
+
+struct MemInfo {
+    qint64 totalBytes = -1;
+    qint64 availableBytes = -1;
+};
+
+struct CpuTimes {
+    quint64 idle = 0;
+    quint64 total = 0;
+};
+
+struct ThreadStat {
+    int tid = 0;
+    QString name;
+    quint64 cpuTicks = 0;           // utime + stime
+    quint64 involuntarySwitches = 0;
+};
+
+bool readMemInfo(MemInfo &info);
+qint64 processRss();
+// The process's own memory cgroup (from /proc/self/cgroup, v1 or v2): the
+// tightest limit up its hierarchy, and the charge of the cgroup holding it
+qint64 cgroupMemoryLimit();
+qint64 cgroupMemoryUsage();
+
+// CPU (Linux only, empty/zero elsewhere)
+bool readCpuTimes(CpuTimes &times);
+QString cpuModelName();
+int cpuFrequencyMHz();
+int cpuTemperature();
+QList<ThreadStat> threadStats(const QString &nameFilter);
+qint64 clockTicksPerSecond();
+
+}
+
+#endif // PROCFS_H
@@ -0,0 +1,242 @@
+#include "replayrunner.h"
+#include "llamaconnector.h"
+#include "cputopology.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+#include <algorithm>
+
+static double median(QList<double> values)
+{
+    if (values.isEmpty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    int mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+bool ReplayRunner::isReplayInvocation(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--replay") == 0 || qstrncmp(argv[i], "--replay=", 9) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ReplayRunner::runFromCommandLine(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay recorded requests and check for regressions");
+    parser.addHelpOption();
+    parser.addOption({"replay", "Recorded corpus (JSON lines) to replay.", "corpus"});
+    parser.addOption({"model", "Model to load instead of the recorded path.", "file"});
+    parser.addOption({"baseline", "Replay report to compare timings against.", "report"});
+    parser.addOption({"report", "Where to write the replay report.", "file"});
+    parser.addOption({"tolerance", "Allowed relative slowdown (default 0.10).", "fraction", "0.10"});
+    parser.addOption({"allow-model-mismatch", "Replay requests recorded with a different model."});
+    parser.process(app);
+
+    Options options;
+    options.corpusPath = parser.value("replay");
+    options.modelPath = parser.value("model");
+    options.baselinePath = parser.value("baseline");
+    options.reportPath = parser.value("report");
+    options.tolerance = parser.value("tolerance").toDouble();
+    options.allowModelMismatch = parser.isSet("allow-model-mismatch");
+    if (options.reportPath.isEmpty()) {
+        options.reportPath = QFileInfo(options.corpusPath).completeBaseName() + "-replay.json";
+    }
+    return run(options);
+}
+
+int ReplayRunner::run(const Options &options)
+{
+    QString error;
+    const QList<RequestRecord> corpus = RequestRecorder::load(options.corpusPath, &error);
+    if (corpus.isEmpty()) {
+        qWarning() << "No recorded requests in" << options.corpusPath << error;
+        return 2;
+    }
+
+    QString modelPath = options.modelPath.isEmpty() ? corpus.first().modelPath : options.modelPath;
+
+    // Tokens from another model can't match, so that is an error, not a mismatch
+    QString fingerprint = RequestRecorder::modelFingerprint(modelPath);
+    for (int i = 0; i < corpus.size(); ++i) {
+        if (corpus[i].modelFingerprint != fingerprint) {
+            qWarning() << "Request" << i << "was recorded with a different model than" << modelPath;
+            if (!options.allowModelMismatch) {
+                qWarning() << "Pass --allow-model-mismatch to replay it anyway";
+                return 2;
+            }
+        }
+    }
+
+    // Spilled states go to a private folder: a running GUI owns the shared one
+    QTemporaryDir kvDir;
+    if (!kvDir.isValid()) {
+        qWarning() << "Cannot create a folder for KV states:" << kvDir.errorString();
+        return 2;
+    }
+
+    // Same threading setup as the GUI so timings are comparable
+    QSettings settings("YourCompany", "AIChatGUI");
+    LlamaWorker worker(kvDir.path());
+    worker.configureThreading(CpuTopology::detect(),
+                              settings.value("numaStrategy", "disabled").toString(),
+                              settings.value("threadPriority", "normal").toString());
+    if (!worker.initialize(modelPath)) {
+        qWarning() << "Failed to load model" << modelPath;
+        return 2;
+    }
+
+    QList<RequestRecord> replayed;
+    QJsonArray requests;
+    int mismatches = 0;
+
+    for (int i = 0; i < corpus.size(); ++i) {
+        const RequestRecord &recorded = corpus[i];
+        RequestRecord result;
+        if (!worker.replayRequest(recorded, result)) {
+            qWarning() << "Replay failed for request" << i;
+            return 2;
+        }
+        replayed.append(result);
+
+        // First index where the outputs diverge, -1 when identical
+        int divergence = -1;
+        size_t common = std::min(recorded.outputTokens.size(), result.outputTokens.size());
+        for (size_t t = 0; t < common; ++t) {
+            if (recorded.outputTokens[t] != result.outputTokens[t]) {
+                divergence = static_cast<int>(t);
+                break;
+            }
+        }
+        if (divergence < 0 && recorded.outputTokens.size() != result.outputTokens.size()) {
+            divergence = static_cast<int>(common);
+        }
+        if (divergence >= 0) {
+            mismatches++;
+        }
+
+        QJsonObject entry;
+        entry["index"] = i;
+        entry["tokensMatch"] = divergence < 0;
+        entry["firstMismatch"] = divergence;
+        entry["expectedTokens"] = static_cast<int>(recorded.outputTokens.size());
+        entry["actualTokens"] = static_cast<int>(result.outputTokens.size());
+        entry["ttftMs"] = result.ttftMs;
+        entry["prefillTokensPerSec"] = result.prefillTokensPerSec();
+        entry["decodeTokensPerSec"] = result.decodeTokensPerSec();
+        requests.append(entry);
+
+        qDebug().noquote() << QString("[%1/%2] %3 tokens, TTFT %4 ms, decode %5 tok/s%6")
+                                  .arg(i + 1).arg(corpus.size())
+                                  .arg(result.outputTokens.size())
+                                  .arg(result.ttftMs, 0, 'f', 1)
+                                  .arg(result.decodeTokensPerSec(), 0, 'f', 1)
+                                  .arg(divergence < 0 ? "" : QString(", diverged at token %1").arg(divergence));
+    }
+
+    Summary current = summarize(replayed);
+    Summary baseline = summarize(corpus);
+    if (!options.baselinePath.isEmpty()) {
+        QFile baselineFile(options.baselinePath);
+        if (!baselineFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot read baseline" << options.baselinePath;
+            return 2;
+        }
+        QJsonObject report = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        baseline = summaryFromJson(report["summary"].toObject());
+    }
+
+    const double tol = options.tolerance;
+    QStringList regressions;
+    if (baseline.ttftMs > 0 && current.ttftMs > baseline.ttftMs * (1.0 + tol)) {
+        regressions << QString("TTFT %1 ms vs %2 ms").arg(current.ttftMs, 0, 'f', 1).arg(baseline.ttftMs, 0, 'f', 1);
+    }
+    if (current.prefillTokensPerSec < baseline.prefillTokensPerSec * (1.0 - tol)) {
+        regressions << QString("prefill %1 tok/s vs %2 tok/s")
+                           .arg(current.prefillTokensPerSec, 0, 'f', 1).arg(baseline.prefillTokensPerSec, 0, 'f', 1);
+    }
+    if (current.decodeTokensPerSec < baseline.decodeTokensPerSec * (1.0 - tol)) {
+        regressions << QString("decode %1 tok/s vs %2 tok/s")
+                           .arg(current.decodeTokensPerSec, 0, 'f', 1).arg(baseline.decodeTokensPerSec, 0, 'f', 1);
+    }
+
+    QJsonObject report;
+    report["corpus"] = options.corpusPath;
+    report["model"] = modelPath;
+    report["modelFingerprint"] = fingerprint;
+    report["backend"] = worker.backendName() + " " + worker.cpuIsa();
+    report["tolerance"] = tol;
+    report["summary"] = summaryToJson(current);
+    report["baseline"] = summaryToJson(baseline);
+    report["mismatches"] = mismatches;
+    report["regressions"] = QJsonArray::fromStringList(regressions);
+    report["requests"] = requests;
+
+    QFile reportFile(options.reportPath);
+    if (reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        reportFile.write(QJsonDocument(report).toJson(QJsonDocument::Indented));
+        qDebug() << "Replay report written to" << options.reportPath;
+    } else {
+        qWarning() << "Cannot write report" << options.reportPath;
+    }
+
+    qDebug().noquote() << QString("Median TTFT %1 ms, prefill %2 tok/s, decode %3 tok/s")
+                              .arg(current.ttftMs, 0, 'f', 1)
+                              .arg(current.prefillTokensPerSec, 0, 'f', 1)
+                              .arg(current.decodeTokensPerSec, 0, 'f', 1);
+    for (const QString &regression : regressions) {
+        qWarning().noquote() << "REGRESSION:" << regression;
+    }
+    if (mismatches > 0) {
+        qWarning() << mismatches << "of" << corpus.size() << "requests produced different tokens";
+    }
+
+    return (mismatches > 0 || !regressions.isEmpty()) ? 1 : 0;
+}
+
+ReplayRunner::Summary ReplayRunner::summarize(const QList<RequestRecord> &records)
+{
+    QList<double> ttft, prefill, decode;
+    for (const RequestRecord &record : records) {
+        if (record.ttftMs > 0) ttft.append(record.ttftMs);
+        if (record.prefillMs > 0) prefill.append(record.prefillTokensPerSec());
+        if (record.decodeMs > 0 && !record.outputTokens.empty()) decode.append(record.decodeTokensPerSec());
+    }
+
+    Summary summary;
+    summary.ttftMs = median(ttft);
+    summary.prefillTokensPerSec = median(prefill);
+    summary.decodeTokensPerSec = median(decode);
+    return summary;
+}
+
+QJsonObject ReplayRunner::summaryToJson(const Summary &summary)
+{
+    QJsonObject obj;
+    obj["ttftMs"] = summary.ttftMs;
+    obj["prefillTokensPerSec"] = summary.prefillTokensPerSec;
+    obj["decodeTokensPerSec"] = summary.decodeTokensPerSec;
+    return obj;
+}
+
+ReplayRunner::Summary ReplayRunner::summaryFromJson(const QJsonObject &obj)
+{
+    Summary summary;
+    summary.ttftMs = obj["ttftMs"].toDouble();
+    summary.prefillTokensPerSec = obj["prefillTokensPerSec"].toDouble();
+    summary.decodeTokensPerSec = obj["decodeTokensPerSec"].toDouble();
+    return summary;
+}
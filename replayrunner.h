@@ -0,0 +1,48 @@
+#ifndef REPLAYRUNNER_H
+#define REPLAYRUNNER_H
+
+#include <QString>
+#include <QJsonObject>
+#include "requestrecorder.h"
+
+class QCoreApplication;
+
+// Headless regression gate: re-runs a recorded corpus, compares output
+// tokens exactly and median TTFT / throughput against a baseline
+// (a previous replay report, or the timings stored in the corpus).
+//
+//   AIChatGUI --replay corpus.jsonl [--model file.gguf] [--baseline report.json]
+//             [--report out.json] [--tolerance 0.10] [--allow-model-mismatch]
+//
+// Exit code 0 = pass, 1 = output mismatch or regression, 2 = error
+// (including requests recorded with another model, unless allowed).
+class ReplayRunner
+{
+public:
+    static bool isReplayInvocation(int argc, char *argv[]);
+    static int runFromCommandLine(QCoreApplication &app);
+
+    struct Options {
+        QString corpusPath;
+        QString modelPath;      // empty = model path stored in the corpus
+        QString baselinePath;   // empty = timings stored in the corpus
+        QString reportPath;
+        double tolerance = 0.10;
+        bool allowModelMismatch = false;
+    };
+
+    static int run(const Options &options);
+
+private:
+    struct Summary {
+        double ttftMs = 0.0;
+        double prefillTokensPerSec = 0.0;
+        double decodeTokensPerSec = 0.0;
+    };
+
+    static Summary summarize(const QList<RequestRecord> &records);
+    static QJsonObject summaryToJson(const Summary &summary);
+    static Summary summaryFromJson(const QJsonObject &obj);
+};
+
+#endif // REPLAYRUNNER_H
@@ -0,0 +1,191 @@
+#include "requestrecorder.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+static const int RECORD_VERSION = 1;
+// Hashing a multi-GB model per load is too slow; both ends identify it well enough
+static const qint64 FINGERPRINT_CHUNK = 16 * 1024 * 1024;
+
+static QJsonArray tokensToJson(const std::vector<llama_token> &tokens)
+{
+    QJsonArray array;
+    for (llama_token token : tokens) {
+        array.append(token);
+    }
+    return array;
+}
+
+static std::vector<llama_token> tokensFromJson(const QJsonValue &value)
+{
+    const QJsonArray array = value.toArray();
+    std::vector<llama_token> tokens;
+    tokens.reserve(array.size());
+    for (const QJsonValue &token : array) {
+        tokens.push_back(static_cast<llama_token>(token.toInt()));
+    }
+    return tokens;
+}
+
+double RequestRecord::prefillTokensPerSec() const
+{
+    return prefillMs > 0 ? promptTokens.size() * 1000.0 / prefillMs : 0.0;
+}
+
+double RequestRecord::decodeTokensPerSec() const
+{
+    return decodeMs > 0 ? outputTokens.size() * 1000.0 / decodeMs : 0.0;
+}
+
+QJsonObject RequestRecord::toJson() const
+{
+    QJsonObject model;
+    model["path"] = modelPath;
+    model["size"] = double(modelSize);
+    model["fingerprint"] = modelFingerprint;
+    model["lora"] = loraPath;
+    model["loraScale"] = loraScale;
+
+    QJsonObject context;
+    context["backend"] = backend;
+    context["systemInfo"] = systemInfo;
+    context["nCtx"] = nCtx;
+    context["nBatch"] = nBatch;
+    context["nUbatch"] = nUbatch;
+    context["nThreads"] = nThreads;
+    context["nThreadsBatch"] = nThreadsBatch;
+    context["flashAttention"] = flashAttention;
+
+    QJsonObject sampler;
+    sampler["temperature"] = temperature;
+    sampler["topP"] = topP;
+    sampler["seed"] = double(seed);
+
+    QJsonObject timings;
+    timings["prefillMs"] = prefillMs;
+    timings["ttftMs"] = ttftMs;
+    timings["decodeMs"] = decodeMs;
+    timings["totalMs"] = totalMs;
+    timings["prefillTokensPerSec"] = prefillTokensPerSec();
+    timings["decodeTokensPerSec"] = decodeTokensPerSec();
+
+    QJsonObject obj;
+    obj["version"] = RECORD_VERSION;
+    obj["timestamp"] = timestamp;
+    obj["model"] = model;
+    obj["context"] = context;
+    obj["sampler"] = sampler;
+    obj["contextTokens"] = tokensToJson(contextTokens);
+    obj["promptTokens"] = tokensToJson(promptTokens);
+    obj["outputTokens"] = tokensToJson(outputTokens);
+    obj["stopped"] = stopped;
+    obj["timings"] = timings;
+    return obj;
+}
+
+RequestRecord RequestRecord::fromJson(const QJsonObject &obj)
+{
+    RequestRecord record;
+    record.timestamp = obj["timestamp"].toString();
+
+    QJsonObject model = obj["model"].toObject();
+    record.modelPath = model["path"].toString();
+    record.modelSize = static_cast<qint64>(model["size"].toDouble());
+    record.modelFingerprint = model["fingerprint"].toString();
+    record.loraPath = model["lora"].toString();
+    record.loraScale = static_cast<float>(model["loraScale"].toDouble());
+
+    QJsonObject context = obj["context"].toObject();
+    record.backend = context["backend"].toString();
+    record.systemInfo = context["systemInfo"].toString();
+    record.nCtx = context["nCtx"].toInt();
+    record.nBatch = context["nBatch"].toInt();
+    record.nUbatch = context["nUbatch"].toInt();
+    record.nThreads = context["nThreads"].toInt();
+    record.nThreadsBatch = context["nThreadsBatch"].toInt();
+    record.flashAttention = context["flashAttention"].toBool();
+
+    QJsonObject sampler = obj["sampler"].toObject();
+    record.temperature = static_cast<float>(sampler["temperature"].toDouble());
+    record.topP = static_cast<float>(sampler["topP"].toDouble());
+    record.seed = static_cast<quint32>(sampler["seed"].toDouble());
+
+    record.contextTokens = tokensFromJson(obj["contextTokens"]);
+    record.promptTokens = tokensFromJson(obj["promptTokens"]);
+    record.outputTokens = tokensFromJson(obj["outputTokens"]);
+    record.stopped = obj["stopped"].toBool();
+
+    QJsonObject timings = obj["timings"].toObject();
+    record.prefillMs = timings["prefillMs"].toDouble();
+    record.ttftMs = timings["ttftMs"].toDouble();
+    record.decodeMs = timings["decodeMs"].toDouble();
+    record.totalMs = timings["totalMs"].toDouble();
+    return record;
+}
+
+RequestRecorder::RequestRecorder(const QString &path)
+    : m_file(path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+}
+
+bool RequestRecorder::append(const RequestRecord &record)
+{
+    if (!m_file.isOpen() && !m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qDebug() << "Failed to open request recording:" << m_file.errorString();
+        return false;
+    }
+
+    m_file.write(QJsonDocument(record.toJson()).toJson(QJsonDocument::Compact));
+    m_file.write("\n");
+    return m_file.flush();
+}
+
+QList<RequestRecord> RequestRecorder::load(const QString &path, QString *error)
+{
+    QList<RequestRecord> records;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) *error = file.errorString();
+        return records;
+    }
+
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty()) continue;
+
+        QJsonParseError parseError;
+        QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+        if (!doc.isObject()) {
+            if (error) *error = QString("Line %1: %2").arg(lineNumber).arg(parseError.errorString());
+            return QList<RequestRecord>();
+        }
+        records.append(RequestRecord::fromJson(doc.object()));
+    }
+
+    return records;
+}
+
+QString RequestRecorder::modelFingerprint(const QString &modelPath)
+{
+    QFile file(modelPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    qint64 size = file.size();
+    hash.addData(QByteArray::number(size));
+    hash.addData(file.read(FINGERPRINT_CHUNK));
+    if (size > 2 * FINGERPRINT_CHUNK) {
+        file.seek(size - FINGERPRINT_CHUNK);
+        hash.addData(file.read(FINGERPRINT_CHUNK));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
@@ -0,0 +1,72 @@
+#ifndef REQUESTRECORDER_H
+#define REQUESTRECORDER_H
+
+#include <QString>
+#include <QJsonObject>
+#include <QFile>
+#include <llama.h>
+#include <vector>
+
+// Everything needed to re-run one request deterministically, plus the
+// output and timings it produced
+struct RequestRecord {
+    QString timestamp;
+
+    // Model identity: size + hash of the first and last 16 MB
+    QString modelPath;
+    qint64 modelSize = 0;
+    QString modelFingerprint;
+    QString loraPath;        // empty = base model
+    float loraScale = 0.0f;
+
+    // Build / context
+    QString backend;
+    QString systemInfo;
+    int nCtx = 0;
+    int nBatch = 0;
+    int nUbatch = 0;
+    int nThreads = 0;
+    int nThreadsBatch = 0;
+    bool flashAttention = false;
+
+    // Sampler
+    float temperature = 0.0f;
+    float topP = 0.0f;
+    quint32 seed = 0;
+
+    // KV contents before the request, then the new prompt
+    std::vector<llama_token> contextTokens;
+    std::vector<llama_token> promptTokens;
+    std::vector<llama_token> outputTokens;
+    bool stopped = false;
+
+    // Milliseconds
+    double prefillMs = 0.0;
+    double ttftMs = 0.0;
+    double decodeMs = 0.0;
+    double totalMs = 0.0;
+
+    double prefillTokensPerSec() const;
+    double decodeTokensPerSec() const;
+
+    QJsonObject toJson() const;
+    static RequestRecord fromJson(const QJsonObject &obj);
+};
+
+// Appends records as JSON lines; lives on the worker thread
+class RequestRecorder
+{
+public:
+    explicit RequestRecorder(const QString &path);
+
+    bool append(const RequestRecord &record);
+    QString path() const { return m_file.fileName(); }
+
+    static QList<RequestRecord> load(const QString &path, QString *error = nullptr);
+    static QString modelFingerprint(const QString &modelPath);
+
+private:
+    QFile m_file;
+};
+
+#endif // REQUESTRECORDER_H
@@ -0,0 +1,248 @@
+#include "sequencestatecache.h"
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QDebug>
+
+static const quint32 STATE_FILE_MAGIC = 0x4B565331; // "KVS1"
+
+SequenceStateCache::SequenceStateCache(const QString &spillDir)
+    : m_spillDir(spillDir)
+{
+    // States from a previous run belong to a context that no longer exists
+    QDir dir(m_spillDir);
+    if (dir.exists()) {
+        dir.removeRecursively();
+    }
+    dir.mkpath(m_spillDir);
+}
+
+SequenceStateCache::~SequenceStateCache()
+{
+    clear();
+}
+
+bool SequenceStateCache::store(const QString &key, llama_context *ctx, llama_seq_id seq,
+                               const std::vector<llama_token> &tokens, int nPast)
+{
+    if (!ctx || key.isEmpty() || nPast <= 0) {
+        return false;
+    }
+
+    size_t size = llama_state_seq_get_size(ctx, seq);
+    if (size == 0) {
+        return false;
+    }
+
+    remove(key);
+
+    CachedSequence entry;
+    entry.state.resize(static_cast<qsizetype>(size));
+    size_t written = llama_state_seq_get_data(ctx, reinterpret_cast<uint8_t *>(entry.state.data()),
+                                              size, seq);
+    if (written == 0) {
+        qDebug() << "Failed to snapshot sequence state for" << key;
+        return false;
+    }
+    entry.state.resize(static_cast<qsizetype>(written));
+    entry.tokens = tokens;
+    entry.nPast = nPast;
+    entry.lastUsed = ++m_clock;
+
+    m_entries.insert(key, std::move(entry));
+    qDebug() << "Cached sequence state for" << key << "-" << written / 1024 << "KB," << nPast << "tokens";
+    return true;
+}
+
+bool SequenceStateCache::restore(const QString &key, llama_context *ctx, llama_seq_id seq,
+                                 std::vector<llama_token> &tokens, int &nPast)
+{
+    auto it = m_entries.find(key);
+    if (!ctx || it == m_entries.end()) {
+        return false;
+    }
+
+    CachedSequence &entry = it.value();
+    if (entry.state.isEmpty() && !readFromDisk(entry)) {
+        // Also deletes the unreadable file and stops counting it
+        qDebug() << "Failed to read spilled sequence state for" << key;
+        remove(key);
+        return false;
+    }
+
+    size_t read = llama_state_seq_set_data(ctx, reinterpret_cast<const uint8_t *>(entry.state.constData()),
+                                           entry.state.size(), seq);
+    if (read == 0) {
+        qDebug() << "Failed to restore sequence state for" << key;
+        remove(key);
+        return false;
+    }
+
+    tokens = entry.tokens;
+    nPast = entry.nPast;
+
+    // The live context now owns this conversation
+    remove(key);
+    return true;
+}
+
+void SequenceStateCache::remove(const QString &key)
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    if (!it->diskPath.isEmpty()) {
+        QFile::remove(it->diskPath);
+    }
+    m_entries.erase(it);
+}
+
+void SequenceStateCache::clear()
+{
+    for (const CachedSequence &entry : std::as_const(m_entries)) {
+        if (!entry.diskPath.isEmpty()) {
+            QFile::remove(entry.diskPath);
+        }
+    }
+    m_entries.clear();
+}
+
+qint64 SequenceStateCache::memoryBytes() const
+{
+    qint64 total = 0;
+    for (const CachedSequence &entry : m_entries) {
+        total += entry.state.size() + qint64(entry.tokens.size() * sizeof(llama_token));
+    }
+    return total;
+}
+
+qint64 SequenceStateCache::diskBytes() const
+{
+    qint64 total = 0;
+    for (const CachedSequence &entry : m_entries) {
+        total += entry.diskBytes;
+    }
+    return total;
+}
+
+qint64 SequenceStateCache::spillOldest(QString *key)
+{
+    QString oldest = oldestKey(true);
+    if (oldest.isEmpty()) {
+        return 0;
+    }
+
+    CachedSequence &entry = m_entries[oldest];
+    qint64 freed = entry.state.size();
+
+    if (!writeToDisk(oldest, entry)) {
+        // Disk unavailable: the state cannot be kept at all
+        return dropOldest(key);
+    }
+
+    entry.state = QByteArray();
+    if (key) *key = oldest;
+    return freed;
+}
+
+qint64 SequenceStateCache::dropOldest(QString *key)
+{
+    QString oldest = oldestKey(true);
+    if (oldest.isEmpty()) {
+        oldest = oldestKey(false);
+    }
+    if (oldest.isEmpty()) {
+        return 0;
+    }
+
+    qint64 freed = m_entries[oldest].state.size();
+    remove(oldest);
+    if (key) *key = oldest;
+
+    // Dropping a spilled entry frees no RAM but still counts as progress
+    return qMax<qint64>(freed, 1);
+}
+
+QString SequenceStateCache::oldestKey(bool inMemory) const
+{
+    QString oldest;
+    qint64 oldestUse = 0;
+
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (inMemory && it->state.isEmpty()) continue;
+        if (oldest.isEmpty() || it->lastUsed < oldestUse) {
+            oldest = it.key();
+            oldestUse = it->lastUsed;
+        }
+    }
+
+    return oldest;
+}
+
+bool SequenceStateCache::writeToDisk(const QString &key, CachedSequence &entry)
+{
+    QString name = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    QString path = m_spillDir + "/" + name + ".kv";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Failed to spill sequence state:" << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << STATE_FILE_MAGIC << qint32(entry.nPast) << quint32(entry.tokens.size());
+    out.writeRawData(reinterpret_cast<const char *>(entry.tokens.data()),
+                     int(entry.tokens.size() * sizeof(llama_token)));
+    out << entry.state;
+
+    if (out.status() != QDataStream::Ok || !file.flush()) {
+        file.close();
+        QFile::remove(path);
+        return false;
+    }
+
+    entry.diskPath = path;
+    entry.diskBytes = file.size();
+    return true;
+}
+
+bool SequenceStateCache::readFromDisk(CachedSequence &entry)
+{
+    QFile file(entry.diskPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 nPast = 0;
+    quint32 nTokens = 0;
+    in >> magic >> nPast >> nTokens;
+    if (magic != STATE_FILE_MAGIC || nPast <= 0) {
+        return false;
+    }
+
+    // A truncated or corrupt file must not size the token buffer
+    const qint64 tokenBytes = qint64(nTokens) * qint64(sizeof(llama_token));
+    if (tokenBytes > file.bytesAvailable()) {
+        return false;
+    }
+
+    std::vector<llama_token> tokens(nTokens);
+    if (in.readRawData(reinterpret_cast<char *>(tokens.data()), int(tokenBytes)) != tokenBytes) {
+        return false;
+    }
+    QByteArray state;
+    in >> state;
+    if (in.status() != QDataStream::Ok || state.isEmpty() || !in.atEnd()) {
+        return false;
+    }
+
+    entry.tokens = std::move(tokens);
+    entry.nPast = nPast;
+    entry.state = std::move(state);
+    return true;
+}
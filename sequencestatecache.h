@@ -0,0 +1,55 @@
+#ifndef SEQUENCESTATECACHE_H
+#define SEQUENCESTATECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <vector>
+#include <llama.h>
+
+// Saved KV state of one conversation, in memory or spilled to disk
+struct CachedSequence {
+    std::vector<llama_token> tokens;
+    int nPast = 0;
+    QByteArray state;      // empty once spilled
+    QString diskPath;      // set once spilled
+    qint64 diskBytes = 0;
+    qint64 lastUsed = 0;
+};
+
+// Per-chat sequence states for a single model/context. Owned and used by
+// LlamaWorker only (worker thread), so no locking
+class SequenceStateCache
+{
+public:
+    explicit SequenceStateCache(const QString &spillDir);
+    ~SequenceStateCache();
+
+    bool store(const QString &key, llama_context *ctx, llama_seq_id seq,
+               const std::vector<llama_token> &tokens, int nPast);
+    bool restore(const QString &key, llama_context *ctx, llama_seq_id seq,
+                 std::vector<llama_token> &tokens, int &nPast);
+
+    void remove(const QString &key);
+    void clear();
+    bool contains(const QString &key) const { return m_entries.contains(key); }
+
+    qint64 memoryBytes() const;
+    qint64 diskBytes() const;
+
+    // Eviction steps, least recently used first. Return the bytes freed
+    // (0 when nothing is left to evict) and the affected key
+    qint64 spillOldest(QString *key);
+    qint64 dropOldest(QString *key);
+
+private:
+    QString oldestKey(bool inMemory) const;
+    bool writeToDisk(const QString &key, CachedSequence &entry);
+    bool readFromDisk(CachedSequence &entry);
+
+    QString m_spillDir;
+    QHash<QString, CachedSequence> m_entries;
+    qint64 m_clock = 0;
+};
+
+#endif // SEQUENCESTATECACHE_H
@@ -1,5 +1,6 @@
 #include "syntaxhighlighter.h"
 #include <QQuickTextDocument>
+#include "tracer.h"
 
 SyntaxHighlighter::SyntaxHighlighter(QObject *parent)
     : QSyntaxHighlighter(parent)
@@ -42,6 +43,7 @@ void SyntaxHighlighter::setLanguage(const QString &language)
 
 void SyntaxHighlighter::highlightBlock(const QString &text)
 {
+    TRACE_ZONE("ui", "highlightBlock");
     if (m_language == "cpp" || m_language == "c++" || m_language == "c") {
         highlightCpp(text);
     } else if (m_language == "python" || m_language == "py") {
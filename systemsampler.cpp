@@ -0,0 +1,102 @@
+#include "systemsampler.h"
+#include "procfs.h"
+#include <QDebug>
+
+SystemSampler::SystemSampler(const QString &threadName, QObject *parent)
+    : QObject(parent)
+    , m_threadName(threadName)
+{
+}
+
+void SystemSampler::start()
+{
+    // Created here so the timer lives on the monitor thread
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        m_timer->setInterval(1000);
+        connect(m_timer, &QTimer::timeout, this, &SystemSampler::sample);
+
+        m_ticksPerSecond = qMax<qint64>(ProcFs::clockTicksPerSecond(), 1);
+        QString name = ProcFs::cpuModelName();
+        if (!name.isEmpty()) {
+            emit cpuNameDetected(name);
+        }
+    }
+    m_timer->start();
+    sample();
+}
+
+void SystemSampler::stop()
+{
+    if (m_timer) {
+        m_timer->stop();
+    }
+}
+
+void SystemSampler::sample()
+{
+    double elapsedSec = m_elapsed.isValid() ? m_elapsed.restart() / 1000.0 : 0.0;
+    if (!m_elapsed.isValid()) {
+        m_elapsed.start();
+    }
+
+    ProcFs::MemInfo mem;
+    ProcFs::readMemInfo(mem);
+
+    // /proc/stat is cumulative, so usage is the busy share of the last interval
+    int cpuUsage = 0;
+    ProcFs::CpuTimes times;
+    if (ProcFs::readCpuTimes(times)) {
+        quint64 totalDelta = times.total - m_lastTotal;
+        quint64 idleDelta = times.idle - m_lastIdle;
+        if (m_lastTotal > 0 && totalDelta > 0) {
+            cpuUsage = static_cast<int>(100 * (totalDelta - qMin(idleDelta, totalDelta)) / totalDelta);
+        }
+        m_lastTotal = times.total;
+        m_lastIdle = times.idle;
+    }
+
+    emit systemSampled(mem.totalBytes, mem.availableBytes, cpuUsage,
+                       ProcFs::cpuFrequencyMHz(), ProcFs::cpuTemperature());
+
+    sampleInferenceThreads(elapsedSec);
+}
+
+void SystemSampler::sampleInferenceThreads(double elapsedSec)
+{
+    const QList<ProcFs::ThreadStat> threads = ProcFs::threadStats(m_threadName);
+
+    QHash<int, ThreadSample> current;
+    int measured = 0;
+    int usageSum = 0;
+    int minUsage = 0;
+    quint64 preemptions = 0;
+
+    for (const ProcFs::ThreadStat &thread : threads) {
+        ThreadSample now;
+        now.cpuTicks = thread.cpuTicks;
+        now.involuntarySwitches = thread.involuntarySwitches;
+        current.insert(thread.tid, now);
+
+        // New threads (pool recreated) have no baseline yet
+        auto last = m_lastThreads.constFind(thread.tid);
+        if (last == m_lastThreads.cend() || elapsedSec <= 0.0) continue;
+
+        double busySec = double(now.cpuTicks - qMin(last->cpuTicks, now.cpuTicks)) / m_ticksPerSecond;
+        int usage = qBound(0, static_cast<int>(100.0 * busySec / elapsedSec), 100);
+        usageSum += usage;
+        minUsage = measured == 0 ? usage : qMin(minUsage, usage);
+        preemptions += now.involuntarySwitches - qMin(last->involuntarySwitches, now.involuntarySwitches);
+        measured++;
+    }
+
+    m_lastThreads = current;
+
+    if (measured == 0) {
+        emit inferenceThreadsSampled(threads.size(), 0, 0, 0);
+        return;
+    }
+
+    emit inferenceThreadsSampled(threads.size(), usageSum / measured, minUsage,
+                                 static_cast<int>(preemptions / elapsedSec));
+}
@@ -0,0 +1,48 @@
+#ifndef SYSTEMSAMPLER_H
+#define SYSTEMSAMPLER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QElapsedTimer>
+
+// Reads system RAM, CPU load/clock/temperature and the CPU time of the
+// inference threads on the monitor thread, so the GUI only receives cached
+// values. Linux only; Windows keeps its PDH/WMI path in ModelInfo.
+class SystemSampler : public QObject
+{
+    Q_OBJECT
+public:
+    // Threads whose comm name matches are counted as inference threads
+    explicit SystemSampler(const QString &threadName, QObject *parent = nullptr);
+
+public slots:
+    void start();
+    void stop();
+    void sample();
+
+signals:
+    void cpuNameDetected(const QString &name);
+    // RAM in bytes, usage in percent, clock in MHz, temperature in C
+    void systemSampled(qint64 totalBytes, qint64 availableBytes, int cpuUsage, int clockMHz, int temperature);
+    // Average and lowest per-thread CPU %, involuntary context switches per second
+    void inferenceThreadsSampled(int threadCount, int averageUsage, int minUsage, int preemptionsPerSec);
+
+private:
+    struct ThreadSample {
+        quint64 cpuTicks = 0;
+        quint64 involuntarySwitches = 0;
+    };
+
+    void sampleInferenceThreads(double elapsedSec);
+
+    QString m_threadName;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_elapsed;
+    quint64 m_lastIdle = 0;
+    quint64 m_lastTotal = 0;
+    QHash<int, ThreadSample> m_lastThreads;
+    qint64 m_ticksPerSecond = 100;
+};
+
+#endif // SYSTEMSAMPLER_H
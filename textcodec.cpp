@@ -0,0 +1,37 @@
+#include "textcodec.h"
+
+namespace TextCodec {
+
+QByteArray compress(const QString &text)
+{
+    if (text.size() < MIN_LENGTH) {
+        return QByteArray();
+    }
+
+    const QByteArray utf8 = text.toUtf8();
+    QByteArray out;
+    out.append(char(ZLIB));
+    out.append(qCompress(utf8, 6));
+
+    // Already dense text (base64, minified output) is left alone
+    if (out.size() > utf8.size() * 9 / 10) {
+        return QByteArray();
+    }
+    return out;
+}
+
+bool decompress(const QByteArray &data, QString *text)
+{
+    if (data.isEmpty() || quint8(data.at(0)) != ZLIB) {
+        return false;
+    }
+
+    const QByteArray utf8 = qUncompress(reinterpret_cast<const uchar *>(data.constData()) + 1, data.size() - 1);
+    if (utf8.isEmpty()) {
+        return false;
+    }
+    *text = QString::fromUtf8(utf8);
+    return true;
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef TEXTCODEC_H
+#define TEXTCODEC_H
+
+#include <QByteArray>
+#include <QString>
+
+// Storage format for large message bodies (messages.text_z). Generated code
+// and think blocks compress several times over, so bodies above MIN_LENGTH
+// are kept deflated and messages.text is NULL for those rows.
+//
+//   u8 codec (1 = zlib via qCompress), then the codec's bytes
+namespace TextCodec {
+
+static constexpr quint8 ZLIB = 1;
+// Shorter bodies stay plain; the saving would not pay for the inflate
+static constexpr int MIN_LENGTH = 2048;
+
+// Empty if the text is short or does not compress well enough to bother
+QByteArray compress(const QString &text);
+// False on a malformed blob or an unknown codec
+bool decompress(const QByteArray &data, QString *text);
+
+}
+
+#endif // TEXTCODEC_H
@@ -0,0 +1,163 @@
+#include "textcompaction.h"
+#include "textcodec.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QtConcurrent>
+#include <QDebug>
+
+// Rows compressed and committed per transaction
+static const int BATCH_SIZE = 256;
+// Pages returned to the disk per incremental_vacuum step
+static const int VACUUM_PAGES = 2048;
+
+TextCompaction::TextCompaction(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName("text_compaction")
+    , m_stop(0)
+{
+}
+
+TextCompaction::~TextCompaction()
+{
+}
+
+QString TextCompaction::checkpointKey() const
+{
+    return QString("text_compaction_v%1").arg(VERSION);
+}
+
+void TextCompaction::run()
+{
+    int compressed = 0;
+    qint64 bytesBefore = 0;
+    qint64 bytesAfter = 0;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+        db.setDatabaseName(m_databasePath);
+        // The storage writer runs concurrently; wait for its locks instead of failing
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!db.open()) {
+            qDebug() << "Text compaction: failed to open database:" << db.lastError().text();
+        } else {
+            QSqlQuery query(db);
+            query.prepare("SELECT value FROM settings WHERE key = ?");
+            query.addBindValue(checkpointKey());
+            QString checkpoint = (query.exec() && query.next()) ? query.value(0).toString() : QString();
+
+            if (checkpoint != "done") {
+                qint64 lastId = checkpoint.toLongLong();
+
+                // Replies still waiting for the blocks migration are parsed from text; leave them
+                const QString candidates = "id > ? AND text_z IS NULL AND length(text) >= ? "
+                                           "AND (isUser = 1 OR blocks IS NOT NULL)";
+
+                query.prepare("SELECT COUNT(*) FROM messages WHERE " + candidates);
+                query.addBindValue(lastId);
+                query.addBindValue(TextCodec::MIN_LENGTH);
+                int total = (query.exec() && query.next()) ? query.value(0).toInt() : 0;
+                if (total > 0) {
+                    qDebug() << "Text compaction:" << total << "messages to compress, resuming after id" << lastId;
+                }
+
+                QSqlQuery select(db);
+                select.prepare("SELECT id, text FROM messages WHERE " + candidates + " ORDER BY id LIMIT ?");
+                // Only if the text is still what was compressed
+                QSqlQuery update(db);
+                update.prepare("UPDATE messages SET text = NULL, text_z = ? WHERE id = ? AND text = ?");
+                QSqlQuery saveCheckpoint(db);
+                saveCheckpoint.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?)");
+
+                int done = 0;
+                while (m_stop.loadRelaxed() == 0) {
+                    select.addBindValue(lastId);
+                    select.addBindValue(TextCodec::MIN_LENGTH);
+                    select.addBindValue(BATCH_SIZE);
+                    if (!select.exec()) {
+                        qDebug() << "Text compaction: select failed:" << select.lastError().text();
+                        break;
+                    }
+
+                    QList<qint64> ids;
+                    QStringList texts;
+                    while (select.next()) {
+                        ids.append(select.value(0).toLongLong());
+                        texts.append(select.value(1).toString());
+                    }
+                    select.finish();
+
+                    if (ids.isEmpty()) {
+                        saveCheckpoint.addBindValue(checkpointKey());
+                        saveCheckpoint.addBindValue(QString("done"));
+                        saveCheckpoint.exec();
+                        break;
+                    }
+
+                    const QList<QByteArray> blobs = QtConcurrent::blockingMapped(texts, &TextCodec::compress);
+
+                    db.transaction();
+                    bool ok = true;
+                    int batchCompressed = 0;
+                    qint64 batchBefore = 0;
+                    qint64 batchAfter = 0;
+                    for (int i = 0; i < ids.size() && ok; ++i) {
+                        if (blobs[i].isEmpty()) {
+                            continue;  // does not compress well
+                        }
+                        update.addBindValue(blobs[i]);
+                        update.addBindValue(ids[i]);
+                        update.addBindValue(texts[i]);
+                        ok = update.exec();
+                        if (ok && update.numRowsAffected() > 0) {
+                            ++batchCompressed;
+                            batchBefore += texts[i].toUtf8().size();
+                            batchAfter += blobs[i].size();
+                        }
+                    }
+                    saveCheckpoint.addBindValue(checkpointKey());
+                    saveCheckpoint.addBindValue(QString::number(ids.last()));
+                    ok = ok && saveCheckpoint.exec();
+
+                    if (!ok || !db.commit()) {
+                        qDebug() << "Text compaction: batch failed:" << db.lastError().text();
+                        db.rollback();
+                        break;
+                    }
+
+                    lastId = ids.last();
+                    compressed += batchCompressed;
+                    bytesBefore += batchBefore;
+                    bytesAfter += batchAfter;
+                    done += ids.size();
+                    emit progress(done, total);
+                }
+            }
+
+            // The pages freed by compression are reused by later writes; a
+            // database created with auto_vacuum=INCREMENTAL also shrinks the file
+            query.exec("PRAGMA auto_vacuum");
+            bool incremental = query.next() && query.value(0).toInt() == 2;
+            if (compressed > 0 && incremental) {
+                QSqlQuery vacuum(db);
+                QSqlQuery freePages(db);
+                while (m_stop.loadRelaxed() == 0 && freePages.exec("PRAGMA freelist_count")
+                       && freePages.next() && freePages.value(0).toInt() > 0) {
+                    freePages.finish();
+                    // Every step of the statement frees one page
+                    if (!vacuum.exec(QString("PRAGMA incremental_vacuum(%1)").arg(VACUUM_PAGES))) {
+                        break;
+                    }
+                    while (vacuum.next()) {}
+                }
+            }
+        }
+        db.close();
+    }
+
+    // The connection belongs to this thread
+    QSqlDatabase::removeDatabase(m_connectionName);
+    emit finished(compressed, bytesBefore, bytesAfter);
+}
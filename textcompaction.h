@@ -0,0 +1,42 @@
+#ifndef TEXTCOMPACTION_H
+#define TEXTCOMPACTION_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+
+// Compresses the large message bodies stored before TextCodec existed.
+// Works like BlocksMigration: rowid batches, compressed across all cores,
+// each committed with a checkpoint so an interrupted run resumes. Rows that
+// changed since they were read are left for the writer. Lives on its own
+// thread with its own connection
+class TextCompaction : public QObject
+{
+    Q_OBJECT
+public:
+    // Bump to re-run after a codec change
+    static constexpr int VERSION = 1;
+
+    explicit TextCompaction(const QString &databasePath, QObject *parent = nullptr);
+    ~TextCompaction();
+
+    // Thread-safe; the current batch finishes first
+    void requestStop() { m_stop.storeRelaxed(1); }
+
+public slots:
+    void run();
+
+signals:
+    void progress(int compressed, int total);
+    // bytesBefore/bytesAfter are the UTF-8 and stored sizes of the rows compressed
+    void finished(int compressed, qint64 bytesBefore, qint64 bytesAfter);
+
+private:
+    QString checkpointKey() const;
+
+    QString m_databasePath;
+    QString m_connectionName;
+    QAtomicInt m_stop;
+};
+
+#endif // TEXTCOMPACTION_H
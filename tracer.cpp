@@ -0,0 +1,217 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDebug>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Events kept per thread; older ones are overwritten
+static const quint64 BUFFER_EVENTS = 1 << 16;
+
+struct TraceEvent {
+    const char *category;
+    const char *name;
+    qint64 startNs;
+    qint64 endNs;  // == startNs for instant events
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    QString name;
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[BUFFER_EVENTS]};
+    std::atomic<quint64> written{0};
+    quint64 firstOwned = 0;  // events before this index belong to an earlier thread
+};
+
+std::atomic<bool> Tracer::s_enabled{false};
+
+// Buffers outlive their threads so a dump still shows finished threads,
+// until a new thread takes the buffer over. Pool threads come and go, so
+// without reuse every one of them would leave a buffer behind
+static QMutex s_registryMutex;
+static std::vector<ThreadBuffer *> s_buffers;
+static std::vector<ThreadBuffer *> s_freeBuffers;
+static int s_nextTid = 0;
+static std::atomic<qint64> s_clearedAtNs{0};
+
+// Hands the thread's buffer back when the thread exits
+struct BufferOwner {
+    ThreadBuffer *buffer = nullptr;
+    ~BufferOwner()
+    {
+        if (buffer) {
+            QMutexLocker locker(&s_registryMutex);
+            s_freeBuffers.push_back(buffer);
+        }
+    }
+};
+static thread_local BufferOwner t_owner;
+
+static ThreadBuffer *currentBuffer()
+{
+    if (t_owner.buffer) {
+        return t_owner.buffer;
+    }
+
+    QString name;
+    QThread *thread = QThread::currentThread();
+    if (thread && QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        name = "GUI";
+    } else if (thread) {
+        name = thread->objectName();
+    }
+
+    QMutexLocker locker(&s_registryMutex);
+    ThreadBuffer *buffer;
+    if (!s_freeBuffers.empty()) {
+        buffer = s_freeBuffers.back();
+        s_freeBuffers.pop_back();
+        buffer->firstOwned = buffer->written.load(std::memory_order_relaxed);
+    } else {
+        buffer = new ThreadBuffer;
+        s_buffers.push_back(buffer);
+    }
+    buffer->tid = ++s_nextTid;
+    buffer->name = name.isEmpty() ? "Thread " + QString::number(buffer->tid) : name;
+    t_owner.buffer = buffer;
+    return buffer;
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+    qDebug() << "Tracing" << (enabled ? "enabled" : "disabled");
+}
+
+qint64 Tracer::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char *category, const char *name, qint64 startNs, qint64 endNs)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    // Single writer per buffer: publish the slot after filling it
+    ThreadBuffer *buffer = currentBuffer();
+    quint64 index = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[index % BUFFER_EVENTS] = {category, name, startNs, endNs};
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::instant(const char *category, const char *name)
+{
+    if (isEnabled()) {
+        qint64 now = nowNs();
+        record(category, name, now, now);
+    }
+}
+
+void Tracer::setThreadName(const QString &name)
+{
+    ThreadBuffer *buffer = currentBuffer();
+    QMutexLocker locker(&s_registryMutex);
+    buffer->name = name;
+}
+
+void Tracer::clear()
+{
+    // Writers own their buffers, so hide old events instead of erasing them
+    s_clearedAtNs.store(nowNs(), std::memory_order_relaxed);
+}
+
+bool Tracer::writeChromeTrace(const QString &path)
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    const qint64 clearedAt = s_clearedAtNs.load(std::memory_order_relaxed);
+    QJsonArray events;
+
+    QMutexLocker locker(&s_registryMutex);
+    for (ThreadBuffer *buffer : s_buffers) {
+        QJsonObject meta;
+        meta["ph"] = "M";
+        meta["name"] = "thread_name";
+        meta["pid"] = pid;
+        meta["tid"] = buffer->tid;
+        meta["args"] = QJsonObject{{"name", buffer->name}};
+        events.append(meta);
+
+        // A writer may overwrite the oldest slots while we copy; a dump is
+        // best-effort and the affected events are simply the oldest ones
+        quint64 written = buffer->written.load(std::memory_order_acquire);
+        quint64 first = std::max(written > BUFFER_EVENTS ? written - BUFFER_EVENTS : 0, buffer->firstOwned);
+        for (quint64 i = first; i < written; ++i) {
+            const TraceEvent event = buffer->events[i % BUFFER_EVENTS];
+            if (event.startNs < clearedAt || !event.name) continue;
+
+            QJsonObject e;
+            e["name"] = QString::fromLatin1(event.name);
+            e["cat"] = QString::fromLatin1(event.category);
+            e["pid"] = pid;
+            e["tid"] = buffer->tid;
+            e["ts"] = event.startNs / 1000.0;
+            if (event.endNs > event.startNs) {
+                e["ph"] = "X";
+                e["dur"] = (event.endNs - event.startNs) / 1000.0;
+            } else {
+                e["ph"] = "i";
+                e["s"] = "t";
+            }
+            events.append(e);
+        }
+    }
+    locker.unlock();
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Failed to write trace:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    qDebug() << "Trace written to" << path << "-" << events.size() << "events";
+    return true;
+}
+
+TraceController::TraceController(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void TraceController::setEnabled(bool enabled)
+{
+    if (enabled == Tracer::isEnabled()) {
+        return;
+    }
+    if (enabled) {
+        Tracer::clear();
+    }
+    Tracer::setEnabled(enabled);
+    emit enabledChanged();
+}
+
+QString TraceController::saveTrace()
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                   + "/traces/trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+    return Tracer::writeChromeTrace(path) ? path : QString();
+}
@@ -0,0 +1,79 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+// Low-overhead timeline recorder. Each thread writes complete events into
+// its own fixed-size ring buffer (no locks on the hot path); a dump merges
+// the buffers into Chrome trace-event JSON that chrome://tracing and
+// ui.perfetto.dev open directly. Disabled zones cost one relaxed load.
+//
+// Names and categories must be string literals (or otherwise outlive the
+// trace): only the pointers are stored.
+class Tracer
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static qint64 nowNs();
+    static void record(const char *category, const char *name, qint64 startNs, qint64 endNs);
+    static void instant(const char *category, const char *name);
+
+    // Names the calling thread in the dump (defaults to the QThread name)
+    static void setThreadName(const QString &name);
+
+    // Writes everything currently in the ring buffers; returns false on I/O error
+    static bool writeChromeTrace(const QString &path);
+    static void clear();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class TraceZone
+{
+public:
+    TraceZone(const char *category, const char *name)
+        : m_category(category), m_name(name), m_start(Tracer::isEnabled() ? Tracer::nowNs() : -1) {}
+    ~TraceZone()
+    {
+        if (m_start >= 0) {
+            Tracer::record(m_category, m_name, m_start, Tracer::nowNs());
+        }
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(category, name) TraceZone TRACE_CONCAT(traceZone_, __LINE__)(category, name)
+
+// QML-facing toggle and dump
+class TraceController : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged)
+public:
+    explicit TraceController(QObject *parent = nullptr);
+
+    bool enabled() const { return Tracer::isEnabled(); }
+    void setEnabled(bool enabled);
+
+    // Writes traces/trace-<time>.json under the app data folder, returns the path
+    Q_INVOKABLE QString saveTrace();
+
+signals:
+    void enabledChanged();
+};
+
+#endif // TRACER_H